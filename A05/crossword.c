@@ -10,31 +10,34 @@
 #include <string.h>
 
 /**
- * Creates a dynamically allocated 2D array initialized with dots.
+ * Creates a dynamically allocated 2D array initialized with dots. The rows
+ * are one contiguous block, indexed through a table of row pointers.
  * @param width The number of columns in the grid.
  * @param height The number of rows in the grid.
- * @return Pointer to the created grid.
+ * @return Pointer to the created grid, or NULL if memory allocation fails.
  */
 char** create_grid(int width, int height) {
     char** grid = malloc(height * sizeof(char*));
+    char* cells = malloc((size_t)width * height);
+    if (!grid || !cells) {
+        free(grid);
+        free(cells);
+        return NULL;
+    }
+    memset(cells, '.', (size_t)width * height);  // Initialize the grid with dots
     for (int i = 0; i < height; i++) {
-        grid[i] = malloc(width * sizeof(char));
-        for (int j = 0; j < width; j++) {
-            grid[i][j] = '.';  // Initialize the grid with dots
-        }
+        grid[i] = cells + (size_t)i * width;
     }
     return grid;
 }
 
 /**
- * Frees a dynamically allocated 2D array.
+ * Frees a grid made by create_grid.
  * @param grid The grid to free.
  * @param height The number of rows in the grid.
  */
 void free_grid(char** grid, int height) {
-    for (int i = 0; i < height; i++) {
-        free(grid[i]);
-    }
+    free(grid[0]);
     free(grid);
 }
 
@@ -79,6 +82,10 @@ int main(int argc, char* argv[]) {
                 int width = word2_len;
                 int height = word1_len;
                 char** grid = create_grid(width, height);
+                if (!grid) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    return 1;
+                }
 
                 // Place word1 vertically
                 for (int k = 0; k < word1_len; k++) {
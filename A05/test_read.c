@@ -35,10 +35,6 @@ int main() {
   }
 
   // Free memory
-  for (int i = 0; i < h; i++) {
-    free(pixels[i]);
-  }
-
-  free(pixels);
+  free_ppm_2d(pixels);
   return 0;
 }
\ No newline at end of file
@@ -32,10 +32,7 @@ int main(int argc, char** argv) {
   write_ppm_2d("test.ppm", pixels, w, h);
 
   // Free the original pixel data
-  for (int i = 0; i < h; i++) {
-    free(pixels[i]);
-  }
-  free(pixels);
+  free_ppm_2d(pixels);
 
   // Read back the newly written file to verify content
   struct ppm_pixel** test_pixels = read_ppm_2d("test.ppm", &w, &h);
@@ -54,10 +51,7 @@ int main(int argc, char** argv) {
   }
 
   // Clean up
-  for (int i = 0; i < h; i++) {
-    free(test_pixels[i]);
-  }
-  free(test_pixels);
+  free_ppm_2d(test_pixels);
 
   return 0;
 }
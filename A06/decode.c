@@ -10,7 +10,14 @@
  ---------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "read_ppm.h"
+#include "stego.h"
+
+// The number of characters unpacked at first, and at most, at a time
+#define DECODE_BLOCK 256
+#define MAX_DECODE_BLOCK (1 << 20)
 
 /**
  * Decodes a message hidden in the least significant bits (LSBs) of the pixel data 
@@ -19,61 +26,83 @@
  * The program reads the image file, extracts the LSBs of each pixel color component,
  * assembles them into characters, and prints the decoded message.
  *
+ * With -o, a file hidden by encode -i is recovered instead, checked
+ * against its checksum and written to the given file ("-" for stdout).
+ *
  * @param argc The number of command-line arguments (must be 2).
  * @param argv The command-line arguments, where argv[1] is the input PPM file.
  * @return Returns 0 if successful, or 1 if an error occurs (such as file read failure).
  */
 int main(int argc, char** argv) {
+    const char* output = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, ":o:")) != -1) {
+        switch (opt) {
+        case 'o': output = optarg; break;
+        case '?': printf("usage: decode [-o <payload>] <file.ppm>\n"); break;
+        }
+    }
+    // From here on, argv[1] is the image
+    argv += optind - 1;
+    argc -= optind - 1;
     if (argc != 2) {
-      printf("usage: decode <file.ppm>\n");
+      printf("usage: decode [-o <payload>] <file.ppm>\n");
       return 0;
     }
 
-    int width, height;
-    struct ppm_pixel* pixels = read_ppm(argv[1], &width, &height);
-    if (!pixels) {
-        return 1; // Error already reported by read_ppm
+    // A file hidden with encode -i is streamed out to output
+    if (output) {
+        return stego_extract_file(argv[1], output) == 0 ? 0 : 1;
     }
 
-    int maxChars = (width * height * 3) / 8;
-    printf("Reading %s with width %d and height %d\n", argv[1], width, height);
-    printf("Max number of characters in the image: %d\n", maxChars);
-
-    char* message = malloc(maxChars + 1); // +1 for null terminator
-    if (!message) {
-        fprintf(stderr, "Memory allocation failed\n");
-        free(pixels);
-        return 1;
+    // Read only the header, then only the samples holding the message
+    struct stego_reader reader;
+    if (stego_reader_open(&reader, argv[1]) != 0) {
+        return 1; // Error already reported by stego_reader_open
     }
 
-    unsigned char* bytePtr = (unsigned char*) pixels;
-    int bitPos = 0;
-    unsigned char currentChar = 0;
-    int msgIndex = 0;
-
-    for (int i = 0; i < width * height * 3; ++i) {
-        unsigned char lsb = bytePtr[i] & 1;  // Extract LSB from each color component
-        currentChar |= (lsb << (7 - bitPos)); // Place the lsb in the correct position of currentChar
-        
-        // Debugging output to trace bit addition and character formation
-        //printf("Bit: %d, Current Char: %02X\n", lsb, currentChar);
-        
-        bitPos++;
+    int width = reader.header.width, height = reader.header.height;
+    size_t maxChars = reader.capacity;
+    printf("Reading %s with width %d and height %d\n", argv[1], width, height);
+    printf("Max number of characters in the image: %zu\n", maxChars);
 
-        if (bitPos == 8) {  // Once we have assembled a full byte
-            if (currentChar == '\0') {
-                break;  // Stop if we encounter the string terminator
-            }
-            message[msgIndex++] = currentChar;  // Store the character
-            currentChar = 0;  // Reset for next character
-            bitPos = 0;  // Reset bit position
+    // Unpack a block of characters at a time, stopping at the block that
+    // holds the terminator; blocks double in size, so a short message takes
+    // one small read and a long one a few large ones
+    char* message = NULL;
+    size_t msgIndex = 0;
+    size_t block = DECODE_BLOCK;
+    int status = 0;
+    while (msgIndex < maxChars) {
+        char* larger = realloc(message, msgIndex + block + 1); // +1 for null terminator
+        if (!larger) {
+            fprintf(stderr, "Memory allocation failed\n");
+            status = 1;
+            break;
+        }
+        message = larger;
+        long count = stego_read(&reader, msgIndex, message + msgIndex, block);
+        if (count < 0) {
+            status = 1;
+            break;
         }
+        char* end = memchr(message + msgIndex, '\0', count);
+        if (end) {
+            msgIndex = end - message;
+            break;
+        }
+        msgIndex += count;
+        if (block < MAX_DECODE_BLOCK) block *= 2;
+    }
+    stego_reader_close(&reader);
+    if (status != 0 || !message) {
+        free(message);
+        return 1;
     }
 
     message[msgIndex] = '\0'; // Null-terminate the string
     printf("%s\n", message);
 
-    free(pixels);
     free(message);
     return 0;
 }
@@ -2,43 +2,162 @@
  * Author: Tianyun Song
  * Date: 10.12.2024
  * Description: This program encodes a user-provided message into the least significant 
- * bits (LSBs) of a PPM image file in binary (P6) format. The program reads 
- * the image, encodes the message, and writes the modified image to a new 
+ * bits (LSBs) of PPM image files in binary (P6) format. The program reads 
+ * each image, encodes the message, and writes the modified image to a new 
  * file with "-encoded" appended to the filename.
  ---------------------------------------------*/
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "read_ppm.h"
 #include "write_ppm.h"
+#include "async_ppm.h"
+#include "stego.h"
+
+/**
+ * Encodes a message into the least significant bits (LSBs) of an image,
+ * eight bits per character, most significant bit first, followed by a
+ * null terminator.
+ *
+ * @param pixels The pixels of the image, modified in place
+ * @param message The message to encode; it must fit in the image
+ */
+static void encode_message(struct ppm_pixel* pixels, const char* message) {
+    // The terminator is embedded along with the message
+    stego_embed((unsigned char*) pixels, message, strlen(message) + 1);
+}
+
+/**
+ * Formats the output filename, appending "-encoded" before the file
+ * extension, or at the end if there is none.
+ *
+ * @param outputFilename Returns the output filename
+ * @param size The size of outputFilename
+ * @param filename The input filename
+ */
+static void encoded_name(char* outputFilename, size_t size, const char* filename) {
+    const char* dot = strrchr(filename, '.');
+    if (!dot || strchr(dot, '/')) dot = filename + strlen(filename);
+    snprintf(outputFilename, size, "%.*s-encoded%s", (int)(dot - filename), filename, dot);
+}
+
+/**
+ * Encodes the message into one image and queues it to be written.
+ *
+ * @param filename The name of the image
+ * @param image The image; it is released or handed to the saver
+ * @param message The message to encode
+ * @param saver The background writer
+ * @return 0 on success, or 1 if the message does not fit in the image
+ */
+static int encode_image(const char* filename, struct ppm_async_image* image,
+                        const char* message, struct ppm_saver* saver) {
+    // Calculate the maximum characters, subtracting 1 for the null terminator space
+    int maxChars = (image->width * image->height * 3) / 8 - 1;
+    if (strlen(message) > maxChars) {
+        fprintf(stderr, "Error: Message too long for the image %s\n", filename);
+        ppm_async_release(image);
+        return 1;
+    }
+
+    encode_message(image->pixels, message);
+
+    char outputFilename[4096];
+    encoded_name(outputFilename, sizeof(outputFilename), filename);
+    ppm_saver_submit(saver, outputFilename, image);
+    printf("Writing file %s\n", outputFilename);
+    return 0;
+}
+
+/**
+ * Hides a file in each image, streaming the image and the file through a
+ * band of rows at a time, so neither needs to fit in memory.
+ *
+ * @param payload The file to hide
+ * @param filenames The images
+ * @param count The number of images
+ * @return 0 on success, or 1 if any image could not be encoded
+ */
+static int encode_payload(const char* payload, char** filenames, int count) {
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        char outputFilename[4096];
+        encoded_name(outputFilename, sizeof(outputFilename), filenames[i]);
+        if (stego_embed_file(filenames[i], payload, outputFilename) != 0) {
+            fprintf(stderr, "Error: Cannot hide %s in %s\n", payload, filenames[i]);
+            status = 1;
+            continue;
+        }
+        printf("Writing file %s\n", outputFilename);
+    }
+    return status;
+}
 
 /**
  * The main function that encodes a message into the least significant bits
- * (LSBs) of the pixel data of a PPM image file. It reads the image, encodes
- * the user-provided message, and writes the modified image to a new file with
- * "-encoded" appended to the filename.
+ * (LSBs) of the pixel data of one or more PPM image files. It reads the first
+ * image, asks for the message, encodes it into every image, and writes each
+ * modified image to a new file with "-encoded" appended to the filename.
+ * With -i, a file of any size and content is hidden instead of a phrase,
+ * with its length and a checksum (see stego.h).
  *
- * @param argc The number of command-line arguments (must be 2).
- * @param argv The command-line arguments, where argv[1] is the input PPM file.
+ * Images are processed as a pipeline: a background thread loads the next
+ * image while the current one is encoded, and another writes the previous
+ * one out, each holding at most one image, so the CPU is not left idle
+ * during I/O and memory stays at a few images for any number of files.
+ *
+ * @param argc The number of command-line arguments (at least 2).
+ * @param argv The command-line arguments, where argv[1..] are the input PPM files.
  * @return Returns 0 on successful completion, or 1 if an error occurs (e.g., 
- *         file cannot be read, message too long, or memory allocation failure).
+ *         file cannot be read or written, or message too long).
  */
 int main(int argc, char** argv) {
-    if (argc != 2) {
-      printf("usage: encode <file.ppm>\n");
+    const char* payload = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, ":i:")) != -1) {
+        switch (opt) {
+        case 'i': payload = optarg; break;
+        case '?': printf("usage: encode [-i <payload>] <file.ppm> [more.ppm ...]\n"); break;
+        }
+    }
+    // From here on, argv[1..] are the images
+    argv += optind - 1;
+    argc -= optind - 1;
+    if (argc < 2) {
+      printf("usage: encode [-i <payload>] <file.ppm> [more.ppm ...]\n");
       return 0;
     }
 
-    int width, height;
-    struct ppm_pixel* pixels = read_ppm(argv[1], &width, &height);
-    if (pixels == NULL) {
+    if (payload) {
+        return encode_payload(payload, argv + 1, argc - 1);
+    }
+
+    // Map the images copy-on-write: the message patches only the first few
+    // hundred bytes, so only those pages are copied, never the whole image
+    struct ppm_loader loader;
+    struct ppm_saver saver;
+    if (ppm_loader_open(&loader, argv + 1, argc - 1, 1, 1) != 0) {
+        fprintf(stderr, "Error: Cannot start reading images\n");
+        return 1;
+    }
+    if (ppm_saver_open(&saver, 1) != 0) {
+        fprintf(stderr, "Error: Cannot start writing images\n");
+        ppm_loader_close(&loader);
+        return 1;
+    }
+
+    struct ppm_async_image image;
+    ppm_loader_next(&loader, &image);
+    if (image.pixels == NULL) {
         fprintf(stderr, "Error: Cannot read file %s\n", argv[1]);  // Error if file cannot be read
+        ppm_loader_close(&loader);
+        ppm_saver_close(&saver);
         return 1;
     }
 
-    // Calculate the maximum characters, subtracting 1 for the null terminator space
-    int maxChars = (width * height * 3) / 8 - 1;
-    printf("Reading %s with width %d and height %d\n", argv[1], width, height);
+    int maxChars = (image.width * image.height * 3) / 8 - 1;
+    printf("Reading %s with width %d and height %d\n", argv[1], image.width, image.height);
     printf("Max number of characters in the image: %d\n", maxChars);
 
     char message[256];
@@ -46,44 +165,19 @@ int main(int argc, char** argv) {
     fgets(message, 256, stdin);
     message[strcspn(message, "\n")] = 0; // Remove newline character
 
-    if (strlen(message) > maxChars) {
-        fprintf(stderr, "Error: Message too long for the image\n");
-        free(pixels);
-        return 1;
-    }
-
-    // Encode the message into the image
-    unsigned char* bytePtr = (unsigned char*) pixels;
-    for (int i = 0, bitIndex = 0; message[i] != '\0'; i++) {
-        for (int bit = 0; bit < 8; bit++, bitIndex++) {
-            //Debug: print original value in hex
-            //printf("Before: %02X ", bytePtr[bitIndex]);
-            int bitValue = (message[i] >> bit) & 1;
-            bytePtr[bitIndex] = (bytePtr[bitIndex] & ~1) | bitValue;
-            // Debug: print modified value in hex
-            //printf("After: %02X\n", bytePtr[bitIndex]);
+    int status = encode_image(argv[1], &image, message, &saver);
+    for (int i = 2; i < argc; i++) {
+        ppm_loader_next(&loader, &image);
+        if (image.pixels == NULL) {
+            fprintf(stderr, "Error: Cannot read file %s\n", argv[i]);
+            status = 1;
+            continue;
         }
+        printf("Reading %s with width %d and height %d\n", argv[i], image.width, image.height);
+        status |= encode_image(argv[i], &image, message, &saver);
     }
 
-    // Mark the end of the message with a null terminator
-    for (int bit = 0; bit < 8; bit++) {
-        int bitIndex = 8 * strlen(message) + bit;
-        // Debug: print original value in hex
-        // printf("Before End: %02X ", bytePtr[bitIndex]);
-        bytePtr[bitIndex] = (bytePtr[bitIndex] & ~1); // Clear the LSB
-        // Debug: print modified value in hex
-        //printf("After End: %02X\n", bytePtr[bitIndex]);
-    }
-
-    // Format the output filename to append "-encoded" before the file extension
-    char outputFilename[260];
-    snprintf(outputFilename, 260, "%.*s-encoded%s", 
-            (int)(strrchr(argv[1], '.') - argv[1]), 
-            argv[1], strrchr(argv[1], '.'));
-    write_ppm(outputFilename, pixels, width, height);
-
-    printf("Writing file %s\n", outputFilename);
-
-    free(pixels);
-    return 0;
+    ppm_loader_close(&loader);
+    if (ppm_saver_close(&saver) != 0) status = 1;
+    return status;
 }
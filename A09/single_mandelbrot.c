@@ -1,19 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
 #include "read_ppm.h"
 #include "write_ppm.h"
+#include "escape.h"
 
 /**
  * Generates a Mandelbrot set image based on given input parameters
  * and writes the generated image to a PPM file.
  *
- * This program accepts command-line options for image size and coordinate
- * boundaries. It calculates each pixel’s color based on the Mandelbrot
- * set equation and saves the output in a PPM format with a filename that
- * includes a timestamp.
+ * This program accepts command-line options for image size, coordinate
+ * boundaries, the escape-time kernel (-k, see escape.h), the iteration
+ * limit (-i), the output file (-o) and its format (-f ppm|qoi). It
+ * calculates each pixel’s color based on the Mandelbrot set equation and
+ * saves the output as PPM, or compressed losslessly as QOI, with a
+ * filename that includes a timestamp. Rows that mirror an earlier row
+ * about the real axis are copied instead of computed (-y computes every
+ * row).
  *
  * @param argc The number of command-line arguments
  * @param argv The array of command-line arguments
@@ -31,23 +37,52 @@ int main(int argc, char* argv[]) {
     float ymin = -1.12;
     float ymax = 1.12;
     int maxIterations = 1000;
+    const char* kernelName = "mandelbrot";
+    const char* output = NULL;
+    const char* formatName = "ppm";
+    int useSymmetry = 1;
 
     int opt;
-    while ((opt = getopt(argc, argv, ":s:l:r:t:b:")) != -1) {
+    while ((opt = getopt(argc, argv, ":s:l:r:t:b:k:i:o:f:y")) != -1) {
       switch (opt) {
         case 's': size = atoi(optarg); break;
         case 'l': xmin = atof(optarg); break;
         case 'r': xmax = atof(optarg); break;
         case 't': ymax = atof(optarg); break;
         case 'b': ymin = atof(optarg); break;
+        case 'k': kernelName = optarg; break;
+        case 'i': maxIterations = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'f': formatName = optarg; break;
+        case 'y': useSymmetry = 0; break;
         case '?': 
-            printf("usage: %s -s <size> -l <xmin> -r <xmax> -b <ymin> -t <ymax>\n", argv[0]); 
+            printf("usage: %s -s <size> -l <xmin> -r <xmax> -b <ymin> -t <ymax> "
+                   "-k <kernel> -i <maxIterations> -o <output.ppm> -f ppm|qoi -y\n", argv[0]); 
             break;
       }
     }
+
+    struct escape_kernel kernel;
+    if (escape_kernel_parse(kernelName, &kernel) != 0) {
+        fprintf(stderr, "Unknown kernel %s\n", kernelName);
+        return 1;
+    }
+    enum image_format format;
+    if (image_format_parse(formatName, &format) != 0) {
+        fprintf(stderr, "Unknown output format %s\n", formatName);
+        return 1;
+    }
+    kernel.maxIterations = maxIterations;
+
     printf("Generating mandelbrot with size %dx%d\n", size, size);
+    printf("  Kernel = %s\n", kernelName);
     printf("  X range = [%.4f,%.4f]\n", xmin, xmax);
     printf("  Y range = [%.4f,%.4f]\n", ymin, ymax);
+    int axis2 = useSymmetry ? escape_mirror_axis(&kernel, ymin, ymax, size) : -1;
+    if (axis2 >= 0) {
+        int mirrored = (axis2 < size - 1 ? axis2 : size - 1) - axis2 / 2;
+        printf("  Mirrored rows = %d of %d\n", mirrored, size);
+    }
 
     // Seed the random number generator for palette generation
     srand(time(0));
@@ -68,9 +103,14 @@ int main(int argc, char* argv[]) {
 
     // Allocate space for the image
     struct ppm_pixel *image = malloc(size * size * sizeof(struct ppm_pixel));
-    if (!image) {
+    double *xs = malloc(size * sizeof(double));
+    int *iters = malloc(size * sizeof(int));
+    if (!image || !xs || !iters) {
         fprintf(stderr, "Failed to allocate memory for image\n");
         free(palette);
+        free(image);
+        free(xs);
+        free(iters);
         return 1;
     }
 
@@ -78,22 +118,24 @@ int main(int argc, char* argv[]) {
     struct timeval start, end;
     gettimeofday(&start, NULL);
 
+    // Map each column to its real coordinate once; every row shares them
+    for (int col = 0; col < size; col++) {
+        xs[col] = xmin + (float)col / size * (xmax - xmin);
+    }
+
     // Calculate Mandelbrot set membership for each pixel
     for (int row = 0; row < size; row++) {
+        // The kernel's image is symmetric, so reuse the mirror row
+        if (escape_mirrored_row(axis2, row)) {
+            memcpy(image + row * size, image + (axis2 - row) * size,
+                   size * sizeof(struct ppm_pixel));
+            continue;
+        }
+        float y0 = ymin + (float)row / size * (ymax - ymin);
+        escape_row(&kernel, xs, y0, size, iters);
+
         for (int col = 0; col < size; col++) {
-            // Map pixel position to the corresponding complex plane coordinates
-            float x0 = xmin + (float)col / size * (xmax - xmin);
-            float y0 = ymin + (float)row / size * (ymax - ymin);
-            float x = 0, y = 0;
-            int iter = 0;
-
-            // Mandelbrot iteration loop
-            while (iter < maxIterations && x * x + y * y < 4) {
-                float xtemp = x * x - y * y + x0;
-                y = 2 * x * y + y0;
-                x = xtemp;
-                iter++;
-            }
+            int iter = iters[col];
 
             // Assign color based on escape iteration count or default to black
             if (iter < maxIterations) {
@@ -114,14 +156,21 @@ int main(int argc, char* argv[]) {
         (end.tv_usec - start.tv_usec) / 1000000.0;
     printf("Computed mandelbrot set (%dx%d) in %f seconds\n", size, size, elapsed);
 
-    // Generate a unique filename using the image size and current timestamp
-    char filename[64];
-    snprintf(filename, sizeof(filename), "mandelbrot-%d-%ld.ppm", size, time(0));
-    write_ppm(filename, image, size, size);
+    // Use -o if given, else a unique filename from the size and current timestamp
+    char filename[256];
+    if (output) {
+        snprintf(filename, sizeof(filename), "%s", output);
+    } else {
+        snprintf(filename, sizeof(filename), "mandelbrot-%d-%ld.%s", size, time(0),
+                 image_format_extension(format));
+    }
+    write_image(filename, image, size, size, format);
     printf("Writing file: %s\n", filename);
 
     // Free allocated memory for palette and image data
     free(palette);
     free(image);
+    free(xs);
+    free(iters);
     return 0;
 }
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
 #include <sys/time.h> 
@@ -7,13 +8,30 @@
 #include <pthread.h>
 #include "read_ppm.h"
 #include "write_ppm.h"
+#include "escape.h"
 
 /**
  * Multi-threaded Mandelbrot set generator for creating a PPM image.
- * Each thread processes a quadrant of the image, calculating color
- * values based on Mandelbrot set membership and storing them in a
+ * Each of the -p threads processes a band of rows of the image, calculating
+ * color values based on Mandelbrot set membership and storing them in a
  * shared image array.
  *
+ * With -a <n>, a second pass anti-aliases the image adaptively: only
+ * pixels whose escape count differs from one of their neighbours are
+ * re-rendered with n x n jittered samples, so smooth regions cost nothing
+ * extra compared with rendering at n times the size.
+ *
+ * When the kernel's image is symmetric about the real axis and rows of the
+ * view mirror each other (the default view is), the threads share out only
+ * the unique rows and then copy each mirrored row from its twin; -y turns
+ * this off.
+ *
+ * The output file is preallocated before rendering, and each thread writes
+ * its rows at their own offsets as soon as they are final, so no serial
+ * write of the whole image remains after the threads finish. With -f qoi
+ * the image is instead compressed losslessly as QOI once it is complete,
+ * since each QOI pixel depends on the ones before it.
+ *
  * @author: Tianyun Song
  * @date: 11/6/2024
  */
@@ -26,14 +44,169 @@ typedef struct {
     int end_col;
     int size;
     float xmin, xmax, ymin, ymax;
-    int maxIterations;
+    const struct escape_kernel* kernel;
+    const double* xs;      // real coordinate of every column
+    int axis2;             // mirrored rows sum to axis2, -1 = no symmetry
+    int first_unique, end_unique;   // this thread's share of the unique rows
+    int first_mirror, end_mirror;   // and of the mirrored rows
+    int samples;           // n for n x n supersampling of edge pixels, 0 = off
+    int* iters;            // escape count of every pixel from the first pass
     struct ppm_pixel* image;
     struct ppm_pixel* palette;
+    struct ppm_band_writer* output;   // rows are written here once final, if not NULL
+    int writeFailed;       // set if any of this thread's rows could not be written
+    unsigned int seed;     // per-thread state for rand_r jitter
+    long edgePixels;       // pixels this thread supersampled
+    long extraSamples;     // samples this thread spent on supersampling
     pthread_t thread_id;
 } ThreadData;
 
+// Synchronizes the first (escape count) and second (supersampling) passes
+pthread_barrier_t barrier;
+
+/**
+ * Returns the row of the j-th row that must be computed: every row except
+ * those that mirror an earlier one, which form one band after axis2 / 2.
+ *
+ * @param data Pointer to ThreadData struct with the view
+ * @param j Index among the computed rows
+ */
+int unique_row(const ThreadData* data, int j) {
+    if (data->axis2 < 0 || j <= data->axis2 / 2) return j;
+    return j + (data->axis2 < data->size - 1 ? data->axis2 : data->size - 1) - data->axis2 / 2;
+}
+
+/**
+ * Copies this thread's share of the mirrored rows, escape counts and
+ * colours, from the rows they mirror.
+ *
+ * @param data Pointer to ThreadData struct with the thread's configuration
+ */
+void copy_mirrored_rows(ThreadData* data) {
+    int size = data->size;
+    for (int j = data->first_mirror; j < data->end_mirror; j++) {
+        int row = data->axis2 / 2 + 1 + j;
+        int twin = data->axis2 - row;
+        memcpy(data->iters + row * size, data->iters + twin * size, size * sizeof(int));
+        memcpy(data->image + row * size, data->image + twin * size,
+               size * sizeof(struct ppm_pixel));
+    }
+}
+
+/**
+ * Writes rows [row, row + count) of the image to the output file.
+ *
+ * @param data Pointer to ThreadData struct with the image and output
+ * @param row The first row
+ * @param count The number of rows
+ */
+void write_rows(ThreadData* data, int row, int count) {
+    if (count > 0 && data->output && ppm_write_band(data->output, row, data->image + row * data->size, count) != 0) {
+        fprintf(stderr, "Failed to write rows %d to %d\n", row, row + count - 1);
+        data->writeFailed = 1;
+    }
+}
+
+/**
+ * Writes this thread's share of the unique rows, in runs of consecutive
+ * rows.
+ *
+ * @param data Pointer to ThreadData struct with the thread's configuration
+ */
+void write_unique_rows(ThreadData* data) {
+    int start = -1, count = 0;
+    for (int j = data->first_unique; j < data->end_unique; j++) {
+        int row = unique_row(data, j);
+        if (row != start + count) {
+            write_rows(data, start, count);
+            start = row;
+            count = 0;
+        }
+        count++;
+    }
+    write_rows(data, start, count);
+}
+
+/**
+ * Writes this thread's share of the mirrored rows, which are consecutive.
+ *
+ * @param data Pointer to ThreadData struct with the thread's configuration
+ */
+void write_mirrored_rows(ThreadData* data) {
+    write_rows(data, data->axis2 / 2 + 1 + data->first_mirror, data->end_mirror - data->first_mirror);
+}
+
+/**
+ * Returns 1 if any of the 8 neighbours of (row, col) escaped after a
+ * different number of iterations, i.e. the pixel lies on a colour edge.
+ *
+ * @param iters Escape counts for the whole image
+ * @param size Width and height of the image
+ * @param row Pixel row
+ * @param col Pixel column
+ */
+int is_edge(const int* iters, int size, int row, int col) {
+    int center = iters[row * size + col];
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+            int r = row + dr;
+            int c = col + dc;
+            if (r < 0 || r >= size || c < 0 || c >= size) continue;
+            if (iters[r * size + c] != center) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Re-renders the edge pixels in this thread's block by averaging
+ * samples x samples stratified, jittered samples taken over the pixel's
+ * footprint. Must run after every thread has finished its first pass,
+ * since edge detection reads the neighbouring blocks.
+ *
+ * @param data Pointer to ThreadData struct with the thread's configuration
+ */
+void supersample_edges(ThreadData* data) {
+    int size = data->size;
+    int n = data->samples;
+    float xstep = (data->xmax - data->xmin) / size;
+    float ystep = (data->ymax - data->ymin) / size;
+
+    for (int j = data->first_unique; j < data->end_unique; j++) {
+        int row = unique_row(data, j);
+        for (int col = data->start_col; col < data->end_col; col++) {
+            if (!is_edge(data->iters, size, row, col)) continue;
+
+            int red = 0, green = 0, blue = 0;
+            for (int sy = 0; sy < n; sy++) {
+                for (int sx = 0; sx < n; sx++) {
+                    // Jitter within the (sx, sy) cell of the pixel footprint,
+                    // which is centered on the first pass's sample point
+                    float jx = (sx + (float)rand_r(&data->seed) / RAND_MAX) / n - 0.5f;
+                    float jy = (sy + (float)rand_r(&data->seed) / RAND_MAX) / n - 0.5f;
+                    float x0 = data->xmin + (col + jx) * xstep;
+                    float y0 = data->ymin + (row + jy) * ystep;
+                    int iter = escape_point(data->kernel, x0, y0);
+                    if (iter < data->kernel->maxIterations) {
+                        red += data->palette[iter].red;
+                        green += data->palette[iter].green;
+                        blue += data->palette[iter].blue;
+                    }
+                }
+            }
+
+            struct ppm_pixel* px = &data->image[row * size + col];
+            px->red = red / (n * n);
+            px->green = green / (n * n);
+            px->blue = blue / (n * n);
+            data->edgePixels++;
+            data->extraSamples += n * n;
+        }
+    }
+}
+
 /**
- * Computes a quadrant of the Mandelbrot set for this thread’s assigned block.
+ * Computes the Mandelbrot set for this thread’s assigned block.
  * Maps pixel coordinates to the complex plane, iterates the Mandelbrot
  * function, and assigns a color based on the iteration count.
  *
@@ -42,7 +215,7 @@ typedef struct {
 void* compute_mandelbrot(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     int size = data->size;
-    int maxIterations = data->maxIterations;
+    int maxIterations = data->kernel->maxIterations;
     float xmin = data->xmin;
     float xmax = data->xmax;
     float ymin = data->ymin;
@@ -51,20 +224,15 @@ void* compute_mandelbrot(void* arg) {
     printf("Thread %ld) sub-image block: cols (%d, %d) to rows (%d, %d)\n",
            data->thread_id, data->start_col, data->end_col, data->start_row, data->end_row);
 
-    for (int row = data->start_row; row < data->end_row; row++) {
+    for (int j = data->first_unique; j < data->end_unique; j++) {
+        int row = unique_row(data, j);
+        float y0 = ymin + (float)row / size * (ymax - ymin);
+        escape_row(data->kernel, data->xs + data->start_col, y0,
+                   data->end_col - data->start_col,
+                   data->iters + row * size + data->start_col);
+
         for (int col = data->start_col; col < data->end_col; col++) {
-            float x0 = xmin + (float)col / size * (xmax - xmin);
-            float y0 = ymin + (float)row / size * (ymax - ymin);
-            float x = 0, y = 0;
-            int iter = 0;
-
-            // Mandelbrot iteration
-            while (iter < maxIterations && x * x + y * y < 4) {
-                float xtemp = x * x - y * y + x0;
-                y = 2 * x * y + y0;
-                x = xtemp;
-                iter++;
-            }
+            int iter = data->iters[row * size + col];
 
             // Assign color based on escape iteration
             if (iter < maxIterations) {
@@ -76,6 +244,32 @@ void* compute_mandelbrot(void* arg) {
             }
         }
     }
+
+    // Without supersampling the computed rows are final
+    if (data->samples == 0) {
+        write_unique_rows(data);
+    }
+
+    // Mirrored rows need their twins, and edge detection needs every row
+    if (data->axis2 >= 0) {
+        pthread_barrier_wait(&barrier);
+        copy_mirrored_rows(data);
+        if (data->samples == 0) {
+            write_mirrored_rows(data);
+        }
+    }
+
+    // Anti-alias only where the first pass found an edge
+    if (data->samples > 0) {
+        pthread_barrier_wait(&barrier);
+        supersample_edges(data);
+        write_unique_rows(data);
+        if (data->axis2 >= 0) {
+            pthread_barrier_wait(&barrier);
+            copy_mirrored_rows(data);
+            write_mirrored_rows(data);
+        }
+    }
     
     printf("Thread %ld) finished\n", data->thread_id);
     pthread_exit(NULL);
@@ -84,8 +278,8 @@ void* compute_mandelbrot(void* arg) {
 /**
  * Main function to initialize and manage multi-threaded Mandelbrot set generation.
  * Parses command-line options for image size and coordinates, sets up color palette,
- * spawns threads to compute each quadrant, measures execution time, and writes output
- * to a PPM file.
+ * spawns threads to compute each band of rows, measures execution time, and writes
+ * output to a PPM or QOI file (-o, or a timestamped name by default; -f).
  *
  * @param argc Number of command-line arguments
  * @param argv Array of command-line arguments
@@ -99,23 +293,60 @@ int main(int argc, char* argv[]) {
     float ymax = 1.12;
     int maxIterations = 1000;
     int numProcesses = 4;
+    int samples = 0;
+    const char* kernelName = "mandelbrot";
+    const char* output = NULL;
+    const char* formatName = "ppm";
+    int useSymmetry = 1;
 
     int opt;
-    while ((opt = getopt(argc, argv, ":s:l:r:t:b:p:")) != -1) {
+    while ((opt = getopt(argc, argv, ":s:l:r:t:b:p:a:k:i:o:f:y")) != -1) {
       switch (opt) {
         case 's': size = atoi(optarg); break;
         case 'l': xmin = atof(optarg); break;
         case 'r': xmax = atof(optarg); break;
         case 't': ymax = atof(optarg); break;
         case 'b': ymin = atof(optarg); break;
+        case 'p': numProcesses = atoi(optarg); break;
+        case 'a': samples = atoi(optarg); break;
+        case 'k': kernelName = optarg; break;
+        case 'i': maxIterations = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'f': formatName = optarg; break;
+        case 'y': useSymmetry = 0; break;
         case '?': printf("usage: %s -s <size> -l <xmin> -r <xmax> "
-          "-b <ymin> -t <ymax> -p <numProcesses>\n", argv[0]); break;
+          "-b <ymin> -t <ymax> -p <numProcesses> -a <samples> "
+          "-k <kernel> -i <maxIterations> -o <output.ppm> -f ppm|qoi -y\n", argv[0]); break;
       }
     }
+    if (numProcesses < 1) numProcesses = 1;
+
+    struct escape_kernel kernel;
+    if (escape_kernel_parse(kernelName, &kernel) != 0) {
+        fprintf(stderr, "Unknown kernel %s\n", kernelName);
+        return 1;
+    }
+    enum image_format format;
+    if (image_format_parse(formatName, &format) != 0) {
+        fprintf(stderr, "Unknown output format %s\n", formatName);
+        return 1;
+    }
+    kernel.maxIterations = maxIterations;
     printf("Generating mandelbrot with size %dx%d\n", size, size);
     printf("  Num processes = %d\n", numProcesses);
+    printf("  Kernel = %s\n", kernelName);
+    if (samples > 0) {
+        printf("  Edge supersampling = %dx%d\n", samples, samples);
+    }
     printf("  X range = [%.4f,%.4f]\n", xmin, xmax);
     printf("  Y range = [%.4f,%.4f]\n", ymin, ymax);
+    int axis2 = useSymmetry ? escape_mirror_axis(&kernel, ymin, ymax, size) : -1;
+    int mirrored = 0;
+    if (axis2 >= 0) {
+        mirrored = (axis2 < size - 1 ? axis2 : size - 1) - axis2 / 2;
+        printf("  Mirrored rows = %d of %d\n", mirrored, size);
+    }
+    int unique = size - mirrored;
 
     srand(time(0));
 
@@ -134,52 +365,79 @@ int main(int argc, char* argv[]) {
 
     // Allocate memory for the image
     struct ppm_pixel *image = malloc(size * size * sizeof(struct ppm_pixel));
-    if (!image) {
+    int *iters = malloc(size * size * sizeof(int));
+    double *xs = malloc(size * sizeof(double));
+    if (!image || !iters || !xs) {
         fprintf(stderr, "Failed to allocate memory for image\n");
         free(palette);
+        free(image);
+        free(iters);
+        free(xs);
+        return 1;
+    }
+
+    // Map each column to its real coordinate once; every row shares them
+    for (int col = 0; col < size; col++) {
+        xs[col] = xmin + (float)col / size * (xmax - xmin);
+    }
+
+    // Create a PPM file up front, so the threads can write their rows
+    char filename[256];
+    if (output) {
+        snprintf(filename, sizeof(filename), "%s", output);
+    } else {
+        snprintf(filename, sizeof(filename), "mandelbrot-%d-%ld.%s", size, time(0),
+                 image_format_extension(format));
+    }
+    struct ppm_band_writer writer = {-1};
+    struct ppm_header header = ppm_rgb_header(size, size);
+    if (format == IMAGE_PPM && ppm_band_writer_open(&writer, filename, &header) != 0) {
+        free(palette);
+        free(image);
+        free(iters);
+        free(xs);
         return 1;
     }
 
+    pthread_barrier_init(&barrier, NULL, numProcesses);
+
     struct timeval start, end;
     gettimeofday(&start, NULL);
 
-    // Set up threads and assign quadrants
-    pthread_t threads[4];
-    ThreadData thread_data[4];
-    int half_size = size / 2;
+    // Set up threads and assign each one a band of rows
+    pthread_t* threads = malloc(numProcesses * sizeof(pthread_t));
+    ThreadData* thread_data = malloc(numProcesses * sizeof(ThreadData));
 
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < numProcesses; i++) {
         thread_data[i].size = size;
         thread_data[i].xmin = xmin;
         thread_data[i].xmax = xmax;
         thread_data[i].ymin = ymin;
         thread_data[i].ymax = ymax;
-        thread_data[i].maxIterations = maxIterations;
+        thread_data[i].kernel = &kernel;
+        thread_data[i].xs = xs;
+        thread_data[i].samples = samples;
+        thread_data[i].iters = iters;
         thread_data[i].image = image;
         thread_data[i].palette = palette;
+        thread_data[i].output = format == IMAGE_PPM ? &writer : NULL;
+        thread_data[i].writeFailed = 0;
+        thread_data[i].seed = time(0) + i;
+        thread_data[i].edgePixels = 0;
+        thread_data[i].extraSamples = 0;
 
-        // Define each quadrant
-        if (i == 0) { // Top-left
-            thread_data[i].start_row = 0;
-            thread_data[i].end_row = half_size;
-            thread_data[i].start_col = 0;
-            thread_data[i].end_col = half_size;
-        } else if (i == 1) { // Top-right
-            thread_data[i].start_row = 0;
-            thread_data[i].end_row = half_size;
-            thread_data[i].start_col = half_size;
-            thread_data[i].end_col = size;
-        } else if (i == 2) { // Bottom-left
-            thread_data[i].start_row = half_size;
-            thread_data[i].end_row = size;
-            thread_data[i].start_col = 0;
-            thread_data[i].end_col = half_size;
-        } else { // Bottom-right
-            thread_data[i].start_row = half_size;
-            thread_data[i].end_row = size;
-            thread_data[i].start_col = half_size;
-            thread_data[i].end_col = size;
-        }
+        // Define each band, of the unique rows when mirroring
+        thread_data[i].axis2 = axis2;
+        thread_data[i].first_unique = (long)unique * i / numProcesses;
+        thread_data[i].end_unique = (long)unique * (i + 1) / numProcesses;
+        thread_data[i].first_mirror = (long)mirrored * i / numProcesses;
+        thread_data[i].end_mirror = (long)mirrored * (i + 1) / numProcesses;
+        thread_data[i].start_row = unique_row(&thread_data[i], thread_data[i].first_unique);
+        thread_data[i].end_row = thread_data[i].end_unique > thread_data[i].first_unique ?
+            unique_row(&thread_data[i], thread_data[i].end_unique - 1) + 1 :
+            thread_data[i].start_row;
+        thread_data[i].start_col = 0;
+        thread_data[i].end_col = size;
 
         // Create each thread and check for errors
         if (pthread_create(&threads[i], NULL, compute_mandelbrot, 
@@ -187,17 +445,27 @@ int main(int argc, char* argv[]) {
             fprintf(stderr, "Error creating thread %d\n", i);
             free(palette);
             free(image);
+            free(iters);
+            free(xs);
+            free(threads);
+            free(thread_data);
+            ppm_band_writer_close(&writer);
             return 1;
         }
         thread_data[i].thread_id = threads[i];
     }
 
     // Join threads and handle errors if any
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < numProcesses; i++) {
         if (pthread_join(threads[i], NULL) != 0) {
             fprintf(stderr, "Error joining thread %d\n", i);
             free(palette);
             free(image);
+            free(iters);
+            free(xs);
+            free(threads);
+            free(thread_data);
+            ppm_band_writer_close(&writer);
             return 1;
         }
     }
@@ -207,14 +475,43 @@ int main(int argc, char* argv[]) {
     double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
     printf("Computed mandelbrot set (%dx%d) in %f seconds\n", size, size, elapsed);
 
-    // Create output file
-    char filename[64];
-    snprintf(filename, sizeof(filename), "mandelbrot-%d-%ld.ppm", size, time(0));
-    write_ppm(filename, image, size, size);
-    printf("Writing file: %s\n", filename);
+    // Compare the adaptive cost against supersampling every pixel
+    if (samples > 0) {
+        long edgePixels = 0, extraSamples = 0;
+        for (int i = 0; i < numProcesses; i++) {
+            edgePixels += thread_data[i].edgePixels;
+            extraSamples += thread_data[i].extraSamples;
+        }
+        long fullSamples = (long)size * size * samples * samples;
+        printf("Supersampled %ld of %ld pixels: %ld extra samples "
+               "(%.2f%% of the %ld needed for full %dx%d supersampling)\n",
+               edgePixels, (long)size * size, extraSamples,
+               100.0 * extraSamples / fullSamples, fullSamples, samples, samples);
+    }
+
+    // The threads have written every row of a PPM file
+    int failed = 0;
+    for (int i = 0; i < numProcesses; i++) {
+        failed |= thread_data[i].writeFailed;
+    }
+    if (format == IMAGE_PPM) {
+        if (ppm_band_writer_close(&writer) != 0) failed = 1;
+    } else if (write_image(filename, image, size, size, format) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "Failed to write file: %s\n", filename);
+    } else {
+        printf("Writing file: %s\n", filename);
+    }
 
     // Free allocated memory
+    pthread_barrier_destroy(&barrier);
     free(palette);
     free(image);
-    return 0;
+    free(iters);
+    free(xs);
+    free(threads);
+    free(thread_data);
+    return failed;
 }
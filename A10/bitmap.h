@@ -0,0 +1,49 @@
+#ifndef bitmap_H_
+#define bitmap_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// A width x height grid of bits packed into 64-bit words. Every row starts
+// on a new word, so threads that write different rows never share a word.
+struct bitmap {
+  int width;
+  int height;
+  int stride;       // words per row
+  uint64_t* words;
+};
+
+// allocate a bitmap with every bit clear
+// returns 0 on success, or -1 if the memory cannot be allocated
+static inline int bitmap_init(struct bitmap* b, int width, int height) {
+  b->width = width;
+  b->height = height;
+  b->stride = (width + 63) / 64;
+  b->words = calloc((size_t)b->stride * height, sizeof(uint64_t));
+  return b->words || b->stride * height == 0 ? 0 : -1;
+}
+
+// free the words of a bitmap
+static inline void bitmap_free(struct bitmap* b) {
+  free(b->words);
+  b->words = NULL;
+}
+
+// the bit at (row, col)
+static inline int bitmap_get(const struct bitmap* b, int row, int col) {
+  return (b->words[(size_t)row * b->stride + col / 64] >> (col % 64)) & 1;
+}
+
+// set the bit at (row, col) to value (0 or 1)
+static inline void bitmap_put(struct bitmap* b, int row, int col, int value) {
+  uint64_t* word = &b->words[(size_t)row * b->stride + col / 64];
+  uint64_t mask = (uint64_t)1 << (col % 64);
+  *word = value ? *word | mask : *word & ~mask;
+}
+
+// the memory used by the bitmap, in bytes
+static inline size_t bitmap_bytes(const struct bitmap* b) {
+  return (size_t)b->stride * b->height * sizeof(uint64_t);
+}
+
+#endif
@@ -1,28 +1,118 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
 #include <assert.h>
+#include <math.h>
 #include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <pthread.h>
 #include "read_ppm.h"
 #include "write_ppm.h"
+#include "escape.h"
+#include "histogram.h"
+#include "rng.h"
+#include "checkpoint.h"
+#include "tonecurve.h"
+#include "pfm.h"
+#include "bitmap.h"
 
 #define MAX_ITER 1000
 #define GAMMA 0.681
+#define ROW_CHUNK 4         // rows claimed at a time from nextRow
+#define HISTOGRAM_MB 1024   // default memory budget for histogram shards
+#define SAMPLE_CHUNK 4096   // samples claimed at a time from nextSample
+#define DOMAIN 2.0          // random seeds are drawn from [-2,2] x [-2,2]
+#define LARGE_STEP 0.25     // chance that a Metropolis proposal is a fresh seed
+#define WARMUP_SAMPLES 20000
+#define MAX_CHANNELS CHECKPOINT_CHANNELS  // red, green and blue for -N
+#define CHECKPOINT_SECONDS 60  // default time between checkpoints
+#define PREVIEWS 10         // default number of previews over a render
+
+// How orbits are seeded and plotted, see -m below
+enum sample_mode { MODE_GRID, MODE_ONEPASS, MODE_RANDOM, MODE_MH };
 
 /**
  * Buddhabrot Generator
  *
  * This program generates a Buddhabrot visualization using multithreading.
- * It divides the work among threads, each processing a quadrant of the
- * image. The program computes Mandelbrot set membership, escaping point
- * counts, and gamma-corrected coloring for the visualization.
+ * Any number of threads (-p) claim chunks of rows from a shared counter,
+ * so the uneven cost of the rows is balanced between them. Orbits are
+ * accumulated into sharded histograms whose total size stays within a
+ * memory budget (-M, in MB); the shards are then merged with every thread
+ * reducing its own band of rows. The program computes Mandelbrot set
+ * membership, escaping point counts, and gamma-corrected coloring for the
+ * visualization.
+ *
+ * Sampling modes (-m):
+ *   grid     classify every pixel, then iterate the escaping ones again to
+ *            plot their orbits (the default)
+ *   onepass  iterate every pixel once into an orbit buffer and plot the
+ *            buffer only if the orbit escaped; the output is the same as
+ *            grid with roughly half the iterations
+ *   random   seed -n orbits uniformly at random from [-2,2] x [-2,2], so
+ *            the sample density no longer depends on the image size
+ *   mh       Metropolis-Hastings: each thread runs a Markov chain that
+ *            favours seeds whose orbits visit the viewport often, and
+ *            weights each orbit by the inverse of its visits so the image
+ *            converges to the same result as random, much faster for
+ *            zoomed-in views
+ *
+ * Both random modes report viewport hits per CPU-second, and -R compares
+ * the result with a reference image to measure convergence.
+ *
+ * Nebulabrot (-N <red>,<green>,<blue>): accumulates one histogram per
+ * color channel, each with its own iteration limit, from a single set of
+ * orbits. Every orbit is iterated once up to the largest limit and is
+ * credited to each channel whose limit it escaped within.
+ *
+ * Long renders: --checkpoint <file> saves the histograms and sampler state
+ * every --checkpoint-every seconds, when interrupted (SIGINT, SIGTERM) and
+ * at the end. --resume carries on from the file; with a larger -n it also
+ * refines a finished random render. The workers pause only between two
+ * chunks while a checkpoint is taken. --preview <file> writes a tone-mapped
+ * image every --preview-every samples (pixels in the row modes) from a
+ * snapshot of the histograms, without pausing the workers at all.
+ *
+ * HDR output: -H <file.pfm> also saves the raw counts as a float map, one
+ * channel per histogram, so that ./tonemap can re-grade the render with a
+ * different curve or gamma without computing it again.
+ *
+ * Memory: set membership is a bitmap (1 bit per pixel), and -w 16 halves
+ * the histograms with 16-bit counts that saturate at 65535 instead of
+ * wrapping; the footprint of every buffer is reported at startup.
+ *
+ * Cache-blocked scatter (-B <adds>): at large sizes every orbit point
+ * misses the cache. With -B, each thread buffers that many visits per
+ * channel, sorts them by 64 KB histogram tile and applies each tile's
+ * visits together; the buffers are flushed at the end of every chunk.
+ *
+ * Symmetry: in the row modes, when the kernel is symmetric about the real
+ * axis and rows of the view mirror each other (the default view does),
+ * only one row of each mirrored pair is iterated and its orbits are
+ * plotted together with their reflections, which are the orbits of the
+ * mirrored seeds. -y iterates every row.
+ *
+ * Output: the image file is preallocated before sampling starts, and each
+ * thread writes the band of rows it colors straight to its offset in the
+ * file, so no serial write of the whole image follows the render. -f qoi
+ * writes a losslessly compressed QOI file instead, once every band is
+ * colored.
  *
  * Usage: ./buddhabrot -s <size> -l <xmin> -r <xmax> -b <ymin> -t <ymax>
- *                     -p <numProcesses>
+ *                     -p <numProcesses> -k <kernel> -i <maxIterations>
+ *                     -o <output.ppm> -f ppm|qoi -M <histogramMB> -m <mode>
+ *                     -n <samples> -S <seed> -R <reference.ppm>
+ *                     -N <red>,<green>,<blue>
+ *                     --checkpoint <file> --checkpoint-every <seconds>
+ *                     --resume --preview <file> --preview-every <samples>
+ *                     -H <counts.pfm> -w 16|32 -B <bufferedAdds> -y
  *
- * Output: The image is written to a PPM file with the format
- *         buddhabrot-<size>-<timestamp>.ppm.
+ * Output: The image is written to the -o file, or by default to a PPM (or
+ *         QOI) file with the format buddhabrot-<size>-<timestamp>.ppm.
  *
  * @author: Tianyun Song
  * @version: November 15, 2024
@@ -37,157 +127,672 @@ int custom_round(double x) {
     return (int)(x + (x >= 0 ? 0.5 : -0.5));
 }
 
-/**
- * Computes the base-10 logarithm of an integer.
- * @param x The input value
- * @return The logarithm of x
- */
-double custom_log(int x) {
-    double result = 0.0;
-    int base = 2;
-    while (x > 1) {
-        x /= base;
-        result += 0.30102999566;  // log2 to log10
-    }
-    return result;
-}
-
-/**
- * Computes base raised to the power of exponent.
- * @param base The base value
- * @param exponent The exponent value
- * @return base raised to the power of exponent
- */
-double custom_pow(double base, double exponent) {
-    if (exponent == 0) return 1.0;
-    double result = 1.0;
-    int i;
-    for (i = 0; i < (int)exponent; i++) {
-        result *= base;
-    }
-    return result;
-}
-
 // Structure to hold thread arguments and pixel data
 typedef struct {
-    int startRow, endRow;
-    int startCol, endCol;
+    int id;
+    int startRow, endRow;  // band this thread reduces and colors
     int size;
     float xmin, xmax, ymin, ymax;
-    int *membership;
-    int *counts;
+    const struct escape_kernel *kernel;
+    const double *xs;      // real coordinate of every column
+    int axis2;             // rows r and axis2 - r mirror each other, or -1
+    enum sample_mode mode;
+    uint64_t seed;         // seed for the random modes
+    double weightScale;    // Metropolis-Hastings weight numerator
+    long iterations;       // total iterations this thread computed
+    long samples;          // orbits this thread seeded
+    long hits;             // orbit points this thread plotted
+    long accepted;         // Metropolis-Hastings proposals accepted
+    struct bitmap *membership;      // 1 bit per pixel: in the set
+    int numChannels;       // 1 for greyscale, 3 for -N
+    const int *limits;     // iteration limit of each channel
+    struct histogram *counts;        // one histogram per channel
+    void *shard[MAX_CHANNELS];       // this thread's shard of each
+    int bufferSize;        // adds buffered per channel, 0 to add directly
+    struct histogram_buffer buffers[MAX_CHANNELS];
     struct ppm_pixel *image;
+    struct ppm_band_writer *output;  // colored rows are written here, if not NULL
+    int writeFailed;       // set if this thread's rows could not be written
+    int inChunk;           // 1 while the thread works on a claimed chunk
+    struct checkpoint_chain chain;   // Metropolis-Hastings chain to save
 } ThreadData;
 
 // Global variables for synchronization
 pthread_barrier_t barrier;
 pthread_mutex_t countMutex;
-int maxCount = 0;
+int maxCount[MAX_CHANNELS] = {0};
+int nextRow = 0;            // next row not yet claimed by a thread
+long nextSample = 0;        // next random sample not yet claimed
+long totalSamples = 0;      // samples requested with -n
+
+// Checkpoints pause the workers between chunks: a worker is active from
+// claiming a chunk until it claims the next, and none may claim while
+// paused is set. gateCond also tells main when a worker finishes sampling.
+pthread_mutex_t gateMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t gateCond = PTHREAD_COND_INITIALIZER;
+int paused = 0;
+int activeWorkers = 0;
+int workersDone = 0;
+pthread_barrier_t sampledBarrier;   // workers and main, before the reduction
+volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Marks the end of the calling thread's current chunk, if any, and waits
+ * until claiming is allowed again.
+ * @param data The thread data of the calling thread
+ */
+void enter_chunk(ThreadData *data) {
+    pthread_mutex_lock(&gateMutex);
+    if (data->inChunk) {
+        activeWorkers--;
+        if (paused) pthread_cond_broadcast(&gateCond);
+    }
+    while (paused) {
+        pthread_cond_wait(&gateCond, &gateMutex);
+    }
+    activeWorkers++;
+    data->inChunk = 1;
+    pthread_mutex_unlock(&gateMutex);
+}
+
+/**
+ * Marks the end of the calling thread's last chunk.
+ * @param data The thread data of the calling thread
+ */
+void leave_chunk(ThreadData *data) {
+    pthread_mutex_lock(&gateMutex);
+    if (data->inChunk) {
+        activeWorkers--;
+        data->inChunk = 0;
+        if (paused) pthread_cond_broadcast(&gateCond);
+    }
+    pthread_mutex_unlock(&gateMutex);
+}
+
+/**
+ * Stops the workers from claiming chunks and waits until every claimed
+ * chunk is finished, so the histograms match the claim counters.
+ */
+void pause_workers() {
+    pthread_mutex_lock(&gateMutex);
+    paused = 1;
+    while (activeWorkers > 0) {
+        pthread_cond_wait(&gateCond, &gateMutex);
+    }
+    pthread_mutex_unlock(&gateMutex);
+}
+
+/**
+ * Lets the workers claim chunks again after pause_workers.
+ */
+void resume_workers() {
+    pthread_mutex_lock(&gateMutex);
+    paused = 0;
+    pthread_cond_broadcast(&gateCond);
+    pthread_mutex_unlock(&gateMutex);
+}
+
+/**
+ * Asks main to save a checkpoint and stop.
+ * @param sig The signal received
+ */
+void request_stop(int sig) {
+    stopRequested = 1;
+}
+
+/**
+ * Applies the calling thread's buffered visits, so that the histograms
+ * are up to date at the end of every chunk.
+ * @param data The thread data of the calling thread
+ */
+void flush_visits(ThreadData *data) {
+    for (int c = 0; c < data->numChannels && data->bufferSize > 0; c++) {
+        histogram_buffer_flush(&data->buffers[c], &data->counts[c], data->shard[c]);
+    }
+}
+
+/**
+ * Finishes the calling thread's chunk and claims the next chunk of rows.
+ * @param data The thread data of the calling thread
+ * @param startRow Returns the first row of the chunk
+ * @param endRow Returns one past the last row of the chunk
+ * @return 1 if a chunk was claimed, 0 once every row has been claimed
+ */
+int claim_rows(ThreadData *data, int *startRow, int *endRow) {
+    int size = data->size;
+    flush_visits(data);
+    enter_chunk(data);
+    int row = __atomic_fetch_add(&nextRow, ROW_CHUNK, __ATOMIC_RELAXED);
+    if (row >= size) {
+        leave_chunk(data);
+        return 0;
+    }
+    *startRow = row;
+    *endRow = row + ROW_CHUNK < size ? row + ROW_CHUNK : size;
+    return 1;
+}
+
+/**
+ * Finishes the calling thread's batch and claims the next batch of random
+ * samples.
+ * @param data The thread data of the calling thread
+ * @param first Returns the index of the first sample in the batch
+ * @param count Returns the number of samples in the batch
+ * @return 1 if a batch was claimed, 0 once every sample has been claimed
+ */
+int claim_samples(ThreadData *data, long *first, long *count) {
+    flush_visits(data);
+    enter_chunk(data);
+    long sample = __atomic_fetch_add(&nextSample, SAMPLE_CHUNK, __ATOMIC_RELAXED);
+    if (sample >= totalSamples) {
+        leave_chunk(data);
+        return 0;
+    }
+    *first = sample;
+    *count = sample + SAMPLE_CHUNK < totalSamples ? SAMPLE_CHUNK : totalSamples - sample;
+    return 1;
+}
+
+/**
+ * Returns 1 if c lies in the main cardioid or the period-2 bulb of the
+ * Mandelbrot set, where every orbit is known not to escape.
+ */
+int in_main_bulbs(double x, double y) {
+    double q = (x - 0.25) * (x - 0.25) + y * y;
+    if (q * (q + (x - 0.25)) <= 0.25 * y * y) return 1;
+    return (x + 1) * (x + 1) + y * y <= 0.0625;
+}
 
 /**
- * Determines Mandelbrot set membership for a quadrant.
- * @param data The thread data containing the quadrant range and other info
+ * Determines Mandelbrot set membership for a chunk of rows.
+ * @param data The thread data containing the viewport and other info
+ * @param startRow The first row of the chunk
+ * @param endRow One past the last row of the chunk
+ * @param iters Scratch space for one row of escape counts
  */
-void check_mandelbrot(ThreadData *data) {
-    float xScale = (data->xmax - data->xmin) / data->size;
+void check_mandelbrot(ThreadData *data, int startRow, int endRow, int *iters) {
     float yScale = (data->ymax - data->ymin) / data->size;
+    int maxIterations = data->kernel->maxIterations;
 
-    for (int row = data->startRow; row < data->endRow; row++) {
-        for (int col = data->startCol; col < data->endCol; col++) {
-            float x0 = data->xmin + col * xScale;
-            float y0 = data->ymin + row * yScale;
-            float x = 0, y = 0;
-            int iter = 0;
-
-            // Check if the point escapes within MAX_ITER iterations
-            while (iter < MAX_ITER && x * x + y * y < 4) {
-                float xtmp = x * x - y * y + x0;
-                y = 2 * x * y + y0;
-                x = xtmp;
-                iter++;
+    for (int row = startRow; row < endRow; row++) {
+        if (escape_mirrored_row(data->axis2, row)) continue;
+        float y0 = data->ymin + row * yScale;
+
+        // Check if each point escapes within maxIterations iterations
+        escape_row(data->kernel, data->xs, y0, data->size, iters);
+        for (int col = 0; col < data->size; col++) {
+            bitmap_put(data->membership, row, col, iters[col] >= maxIterations);
+            data->iterations += iters[col];
+        }
+    }
+}
+
+/**
+ * Adds one visit to a histogram cell in every channel whose iteration
+ * limit the orbit escaped within.
+ * @param data The thread data containing the channels
+ * @param cell The histogram cell
+ * @param n The number of iterations before the orbit escaped
+ */
+static inline void add_visit(ThreadData *data, int cell, int n) {
+    for (int c = 0; c < data->numChannels; c++) {
+        if (n < data->limits[c]) {
+            if (data->bufferSize > 0) {
+                histogram_buffer_add(&data->buffers[c], &data->counts[c], data->shard[c], cell);
+            } else {
+                histogram_add(&data->counts[c], data->shard[c], cell);
             }
-            data->membership[row * data->size + col] = (iter >= MAX_ITER);
         }
     }
 }
 
 /**
- * Computes the visited counts for escaping points.
- * @param data The thread data containing the quadrant range and other info
+ * Adds every point of an escaping orbit that falls inside the image to
+ * the thread's histogram shards.
+ * @param data The thread data containing the viewport and other info
+ * @param orbit The orbit as (x, y) pairs
+ * @param n The number of points in the orbit
+ * @param mirror 1 to also add the reflection of every point about the real
+ *               axis, which is the orbit of the mirrored seed
  */
-void compute_counts(ThreadData *data) {
-    int *localCounts = calloc(data->size * data->size, sizeof(int));
-    for (int i = 0; i < data->size * data->size; i++) {            
-        localCounts[i] = 0;
+int plot_orbit(ThreadData *data, const float *orbit, int n, int mirror) {
+    int hits = 0;
+    for (int i = 0; i < n; i++) {
+        float x = orbit[2 * i];
+        float y = orbit[2 * i + 1];
+
+        int yrow = custom_round(data->size * (y - data->ymin) / (data->ymax - data->ymin));
+        int xcol = custom_round(data->size * (x - data->xmin) / (data->xmax - data->xmin));
+
+        if (xcol < 0 || xcol >= data->size) continue;
+        if (yrow >= 0 && yrow < data->size) {
+            add_visit(data, yrow * data->size + xcol, n);
+            hits++;
+        }
+        if (mirror && data->axis2 - yrow >= 0 && data->axis2 - yrow < data->size) {
+            add_visit(data, (data->axis2 - yrow) * data->size + xcol, n);
+            hits++;
+        }
     }
+    return hits;
+}
 
-    float xScale = (data->xmax - data->xmin) / data->size;
-    float yScale = (data->ymax - data->ymin) / data->size;
+/**
+ * Returns 1 if the seeds of a row have mirror images in a later row of the
+ * image, so that plotting each orbit together with its reflection covers
+ * both rows and the later one is skipped.
+ * @param data The thread data containing the view
+ * @param row The row of seeds
+ */
+int mirrors_row(const ThreadData *data, int row) {
+    return data->axis2 >= 0 && 2 * row < data->axis2 && data->axis2 - row < data->size;
+}
 
-    for (int row = data->startRow; row < data->endRow; row++) {
-        for (int col = data->startCol; col < data->endCol; col++) {
-            int idx = row * data->size + col;
+/**
+ * Iterates the seed c = (x, y) and, if its orbit escapes, collects the
+ * histogram cells that the orbit visits inside the image.
+ * @param data The thread data containing the viewport and other info
+ * @param x Real part of the seed
+ * @param y Imaginary part of the seed
+ * @param orbit Scratch space for one orbit (2 * maxIterations floats)
+ * @param cells Returns the visited cells (room for maxIterations)
+ * @param escape Returns the number of iterations before the orbit escaped
+ * @return The number of visited cells, 0 if the orbit does not escape
+ */
+int trace_orbit(ThreadData *data, double x, double y, float *orbit, int *cells,
+                int *escape) {
+    if (data->kernel->formula == ESCAPE_MANDELBROT && in_main_bulbs(x, y)) return 0;
+
+    int n = escape_orbit(data->kernel, x, y, orbit);
+    data->iterations += n;
+    *escape = n;
+    if (n >= data->kernel->maxIterations) return 0;
+
+    int hits = 0;
+    for (int i = 0; i < n; i++) {
+        int yrow = custom_round(data->size * (orbit[2 * i + 1] - data->ymin) / (data->ymax - data->ymin));
+        int xcol = custom_round(data->size * (orbit[2 * i] - data->xmin) / (data->xmax - data->xmin));
+        if (yrow >= 0 && yrow < data->size && xcol >= 0 && xcol < data->size) {
+            cells[hits++] = yrow * data->size + xcol;
+        }
+    }
+    return hits;
+}
+
+/**
+ * Random mode: seeds orbits uniformly from the sampling domain. Every
+ * SAMPLE_CHUNK samples have their own random stream, so the image depends
+ * only on the seed and -n, not on how the batches were shared out between
+ * threads, nor on where a resumed render started.
+ * @param data The thread data containing the viewport and other info
+ * @param orbit Scratch space for one orbit (2 * maxIterations floats)
+ */
+void compute_counts_random(ThreadData *data, float *orbit) {
+    int maxIterations = data->kernel->maxIterations;
+    int mandelbrot = data->kernel->formula == ESCAPE_MANDELBROT;
+    long first, count;
+
+    while (claim_samples(data, &first, &count)) {
+        struct rng rng;
+        for (long i = 0; i < count; i++) {
+            // Batches after a resume need not start on a stream boundary
+            long sample = first + i;
+            if (i == 0 || sample % SAMPLE_CHUNK == 0) {
+                rng_seed(&rng, data->seed, sample / SAMPLE_CHUNK);
+                for (long skip = 0; skip < sample % SAMPLE_CHUNK; skip++) {
+                    rng_next(&rng);
+                    rng_next(&rng);
+                }
+            }
+            double x = DOMAIN * (2 * rng_uniform(&rng) - 1);
+            double y = DOMAIN * (2 * rng_uniform(&rng) - 1);
+            data->samples++;
+            if (mandelbrot && in_main_bulbs(x, y)) continue;
+
+            int n = escape_orbit(data->kernel, x, y, orbit);
+            data->iterations += n;
+            if (n < maxIterations) {
+                data->hits += plot_orbit(data, orbit, n, 0);
+            }
+        }
+    }
+}
+
+/**
+ * Adds an orbit's cells to the histograms with weight w per cell. Integer
+ * counts are kept by rounding w up or down at random, which leaves the
+ * expected count unchanged.
+ */
+void plot_weighted(ThreadData *data, const int *cells, int hits, int n,
+                   double w, struct rng *rng) {
+    int whole = (int)w;
+    double fraction = w - whole;
+    for (int i = 0; i < hits; i++) {
+        int add = whole + (rng_uniform(rng) < fraction);
+        for (int k = 0; k < add; k++) {
+            add_visit(data, cells[i], n);
+        }
+        data->hits += add;
+    }
+}
+
+/**
+ * Metropolis-Hastings mode: the thread's chain proposes either a small
+ * move of the current seed (an exponentially distributed distance between
+ * one pixel and a tenth of the view) or, with probability LARGE_STEP, a
+ * fresh uniform seed. Both proposals are symmetric, so a proposal with h'
+ * viewport hits replaces the current one with h hits with probability
+ * min(1, h'/h). Every step plots the current orbit weighted by
+ * weightScale / h, which undoes the bias toward high-hit orbits.
+ * @param data The thread data containing the viewport and other info
+ * @param orbit Scratch space for one orbit (2 * maxIterations floats)
+ */
+void compute_counts_metropolis(ThreadData *data, float *orbit) {
+    int maxIterations = data->kernel->maxIterations;
+    int *cells = malloc(maxIterations * sizeof(int));
+    int *proposal = malloc(maxIterations * sizeof(int));
+    double pixel = (data->xmax - data->xmin) / data->size;
+    double farthest = 0.1 * (data->xmax - data->xmin);
+
+    struct rng rng;
+    rng_seed(&rng, data->seed, ~(uint64_t)data->id);
+
+    // Start the chain from any seed whose orbit visits the image, or pick
+    // up a resumed chain where it stopped
+    double cx = 0, cy = 0;
+    int hits = 0, escape = 0;
+    if (data->chain.ready) {
+        cx = data->chain.x;
+        cy = data->chain.y;
+        rng.state = data->chain.rng;
+        hits = trace_orbit(data, cx, cy, orbit, cells, &escape);
+    }
+    while (hits == 0) {
+        cx = DOMAIN * (2 * rng_uniform(&rng) - 1);
+        cy = DOMAIN * (2 * rng_uniform(&rng) - 1);
+        hits = trace_orbit(data, cx, cy, orbit, cells, &escape);
+    }
+
+    long first, count;
+    while (claim_samples(data, &first, &count)) {
+        for (long i = 0; i < count; i++) {
+            double px, py;
+            if (rng_uniform(&rng) < LARGE_STEP) {
+                px = DOMAIN * (2 * rng_uniform(&rng) - 1);
+                py = DOMAIN * (2 * rng_uniform(&rng) - 1);
+            } else {
+                double r = pixel * exp(log(farthest / pixel) * rng_uniform(&rng));
+                double angle = 2 * M_PI * rng_uniform(&rng);
+                px = cx + r * cos(angle);
+                py = cy + r * sin(angle);
+            }
+            data->samples++;
+
+            int proposalHits = 0, proposalEscape = 0;
+            if (px >= -DOMAIN && px <= DOMAIN && py >= -DOMAIN && py <= DOMAIN) {
+                proposalHits = trace_orbit(data, px, py, orbit, proposal, &proposalEscape);
+            }
+            if (proposalHits > 0 && rng_uniform(&rng) * hits < proposalHits) {
+                int *swap = cells;
+                cells = proposal;
+                proposal = swap;
+                hits = proposalHits;
+                escape = proposalEscape;
+                cx = px;
+                cy = py;
+                data->accepted++;
+            }
+            plot_weighted(data, cells, hits, escape, data->weightScale / hits, &rng);
+        }
+        // Publish the chain for checkpoints, which see it between batches
+        data->chain.x = cx;
+        data->chain.y = cy;
+        data->chain.rng = rng.state;
+        data->chain.ready = 1;
+    }
+    free(cells);
+    free(proposal);
+}
+
+/**
+ * Estimates the weight numerator for Metropolis-Hastings from uniform
+ * seeds: the mean hits of an orbit drawn in proportion to its hits,
+ * sum(h^2) / sum(h). Each plotted cell then gets a weight near 1, so the
+ * counts have little rounding noise. Run once, before the threads start,
+ * so that every chain uses the same scale.
+ * @param data Thread data for the viewport
+ * @return The weight numerator
+ */
+double estimate_weight_scale(ThreadData *data) {
+    int maxIterations = data->kernel->maxIterations;
+    float *orbit = malloc(2 * maxIterations * sizeof(float));
+    int *cells = malloc(maxIterations * sizeof(int));
+    struct rng rng;
+    rng_seed(&rng, data->seed, ~(uint64_t)0 >> 1);
 
-            if (!data->membership[idx]) {
-                float x0 = data->xmin + col * xScale;
+    double sum = 0, squares = 0;
+    for (int i = 0; i < WARMUP_SAMPLES; i++) {
+        double x = DOMAIN * (2 * rng_uniform(&rng) - 1);
+        double y = DOMAIN * (2 * rng_uniform(&rng) - 1);
+        int escape;
+        int hits = trace_orbit(data, x, y, orbit, cells, &escape);
+        sum += hits;
+        squares += (double)hits * hits;
+    }
+    free(orbit);
+    free(cells);
+    return sum > 0 ? squares / sum : 1.0;
+}
+
+/**
+ * Computes the visited counts for escaping points in a chunk of rows.
+ * @param data The thread data containing the viewport and other info
+ * @param startRow The first row of the chunk
+ * @param endRow One past the last row of the chunk
+ * @param orbit Scratch space for one orbit (2 * maxIterations floats)
+ */
+void compute_counts(ThreadData *data, int startRow, int endRow, float *orbit) {
+    float yScale = (data->ymax - data->ymin) / data->size;
+
+    for (int row = startRow; row < endRow; row++) {
+        // Mirrored rows were plotted as reflections of their twins
+        if (escape_mirrored_row(data->axis2, row)) continue;
+        int mirror = mirrors_row(data, row);
+        for (int col = 0; col < data->size; col++) {
+            if (!bitmap_get(data->membership, row, col)) {
                 float y0 = data->ymin + row * yScale;
-                float x = 0, y = 0;
 
                 // Iterate through the escaping trajectory
-                while (x * x + y * y < 4) {
-                    float xtmp = x * x - y * y + x0;
-                    y = 2 * x * y + y0;
-                    x = xtmp;
+                int n = escape_orbit(data->kernel, data->xs[col], y0, orbit);
+                data->iterations += n;
+                plot_orbit(data, orbit, n, mirror);
+            }
+        }
+    }
+}
 
-                    int yrow = custom_round(data->size * (y - data->ymin) / (data->ymax - data->ymin));
-                    int xcol = custom_round(data->size * (x - data->xmin) / (data->xmax - data->xmin));
+/**
+ * Single-pass alternative to check_mandelbrot followed by compute_counts:
+ * each pixel is iterated once into the orbit buffer, which is plotted only
+ * if the orbit escaped.
+ * @param data The thread data containing the viewport and other info
+ * @param startRow The first row of the chunk
+ * @param endRow One past the last row of the chunk
+ * @param orbit Scratch space for one orbit (2 * maxIterations floats)
+ */
+void compute_counts_onepass(ThreadData *data, int startRow, int endRow, float *orbit) {
+    float yScale = (data->ymax - data->ymin) / data->size;
+    int maxIterations = data->kernel->maxIterations;
 
-                    if (yrow >= 0 && yrow < data->size && xcol >= 0 && xcol < data->size) {
-                        localCounts[yrow * data->size + xcol]++;
-                    }
-                }
+    for (int row = startRow; row < endRow; row++) {
+        if (escape_mirrored_row(data->axis2, row)) continue;
+        int mirror = mirrors_row(data, row);
+        float y0 = data->ymin + row * yScale;
+        for (int col = 0; col < data->size; col++) {
+            int n = escape_orbit(data->kernel, data->xs[col], y0, orbit);
+            data->iterations += n;
+            bitmap_put(data->membership, row, col, n >= maxIterations);
+            if (n < maxIterations) {
+                plot_orbit(data, orbit, n, mirror);
             }
         }
     }
+}
 
-    // Merge local counts into global counts
-    int localMax = 0;
-    for (int i = 0; i < data->size * data->size; i++) {
-        data->counts[i] += localCounts[i];
-        if (data->counts[i] > localMax) {
-            localMax = data->counts[i];
+/**
+ * Merges the histogram shards of every channel for this thread's band of
+ * rows and folds the band's largest counts into maxCount.
+ * @param data The thread data containing the band and other info
+ */
+void reduce_counts(ThreadData *data) {
+    for (int c = 0; c < data->numChannels; c++) {
+        int localMax = histogram_reduce(&data->counts[c], data->startRow, data->endRow);
+
+        // Update maxCount with the local maximum
+        pthread_mutex_lock(&countMutex);
+        if (localMax > maxCount[c]) {
+            maxCount[c] = localMax;
         }
+        pthread_mutex_unlock(&countMutex);
+    }
+}
+
+/**
+ * Builds the tone curve of every channel for its largest count.
+ * @param numChannels The number of channels
+ * @param maxCounts The largest count of each channel
+ * @param curves Returns the curves; free them with tonecurve_free
+ */
+void build_curves(int numChannels, const int *maxCounts, struct tonecurve *curves) {
+    for (int c = 0; c < numChannels; c++) {
+        tonecurve_init(&curves[c], TONECURVE_LEGACY, GAMMA, maxCounts[c],
+                       tonecurve_entries(maxCounts[c]), NULL);
     }
+}
 
-    // Update maxCount with the local maximum
-    pthread_mutex_lock(&countMutex);
-    if (localMax > maxCount) {
-        maxCount = localMax;
+/**
+ * Colors one pixel from its counts with gamma correction. A single channel
+ * is drawn in grey; with three, each histogram is normalized by its own
+ * maximum and drives one color component.
+ * @param numChannels The number of channels
+ * @param counts The pixel's count in each channel
+ * @param curves The tone curve of each channel
+ * @param pixel Returns the color
+ */
+void color_pixel(int numChannels, const int *counts, const struct tonecurve *curves,
+                 struct ppm_pixel *pixel) {
+    unsigned char rgb[MAX_CHANNELS];
+    for (int c = 0; c < numChannels; c++) {
+        rgb[c] = curves[c].lut[tonecurve_index_count(&curves[c], counts[c])];
     }
-    pthread_mutex_unlock(&countMutex);
-    free(localCounts);
+    pixel->red = rgb[0];
+    pixel->green = numChannels > 1 ? rgb[1] : rgb[0];
+    pixel->blue = numChannels > 2 ? rgb[2] : rgb[0];
 }
 
 /**
  * Computes pixel colors based on counts and gamma correction.
- * @param data The thread data containing the quadrant range and other info
+ * @param data The thread data containing the band and other info
  * @param image The image array to store pixel colors
  */
 void compute_colors(ThreadData *data, struct ppm_pixel *image) {
+    struct tonecurve curves[MAX_CHANNELS];
+    build_curves(data->numChannels, maxCount, curves);
     for (int row = data->startRow; row < data->endRow; row++) {
-        for (int col = data->startCol; col < data->endCol; col++) {
-            float value = 0;
+        for (int col = 0; col < data->size; col++) {
             int idx = row * data->size + col;
+            int counts[MAX_CHANNELS];
 
-            if (data->counts[idx] > 0) {
-                value = custom_log(data->counts[idx]) / custom_log(maxCount);
-                value = custom_pow(value, 1.0 / GAMMA);
+            for (int c = 0; c < data->numChannels; c++) {
+                counts[c] = histogram_count(&data->counts[c], idx);
             }
-            image[idx].red = (unsigned char)(value * 255);
-            image[idx].green = (unsigned char)(value * 255);
-            image[idx].blue = (unsigned char)(value * 255);
+            color_pixel(data->numChannels, counts, curves, &image[idx]);
+        }
+    }
+    for (int c = 0; c < data->numChannels; c++) {
+        tonecurve_free(&curves[c]);
+    }
+}
+
+/**
+ * Writes a preview of the render so far from a snapshot of the histograms,
+ * while the workers keep adding to them. The image is written beside the
+ * target and renamed over it, so viewers never see a partial file.
+ * @param data Thread data for the render
+ * @param snapshot Scratch space for every channel's counts (size * size each)
+ * @param image Scratch space for the preview image
+ * @param filename The preview file
+ */
+void write_preview(ThreadData *data, int **snapshot, struct ppm_pixel *image,
+                   const char *filename) {
+    int cells = data->size * data->size;
+    int max[MAX_CHANNELS];
+    for (int c = 0; c < data->numChannels; c++) {
+        histogram_snapshot(&data->counts[c], 0, data->size, snapshot[c]);
+        max[c] = 0;
+        for (int i = 0; i < cells; i++) {
+            if (snapshot[c][i] > max[c]) max[c] = snapshot[c][i];
+        }
+    }
+    struct tonecurve curves[MAX_CHANNELS];
+    build_curves(data->numChannels, max, curves);
+    for (int i = 0; i < cells; i++) {
+        int counts[MAX_CHANNELS];
+        for (int c = 0; c < data->numChannels; c++) {
+            counts[c] = snapshot[c][i];
         }
+        color_pixel(data->numChannels, counts, curves, &image[i]);
     }
+    for (int c = 0; c < data->numChannels; c++) {
+        tonecurve_free(&curves[c]);
+    }
+
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", filename);
+    write_ppm(temp, image, data->size, data->size);
+    rename(temp, filename);
+}
+
+/**
+ * Returns how much of the render has been claimed: pixels in the row
+ * modes, samples in the random modes.
+ * @param data Thread data for the render
+ */
+long work_done(ThreadData *data) {
+    if (data->mode == MODE_GRID || data->mode == MODE_ONEPASS) {
+        int rows = __atomic_load_n(&nextRow, __ATOMIC_RELAXED);
+        return (long)(rows < data->size ? rows : data->size) * data->size;
+    }
+    long done = __atomic_load_n(&nextSample, __ATOMIC_RELAXED);
+    return done < totalSamples ? done : totalSamples;
+}
+
+/**
+ * Saves a checkpoint of the render. The workers must be paused, or done
+ * with merged set once the shards have been reduced.
+ * @param path The checkpoint file
+ * @param ck The render parameters and the progress of earlier runs
+ * @param data Thread data of every worker
+ * @param numProcesses The number of workers
+ * @param merged 1 if the counts are already merged into shard 0
+ */
+void save_checkpoint(const char *path, const struct checkpoint *ck, ThreadData *data,
+                     int numProcesses, int merged) {
+    struct checkpoint now = *ck;
+    struct checkpoint_chain *chains = malloc(numProcesses * sizeof(struct checkpoint_chain));
+    now.nextRow = nextRow < data->size ? nextRow : data->size;
+    now.nextSample = nextSample < totalSamples ? nextSample : totalSamples;
+    for (int i = 0; i < numProcesses; i++) {
+        now.iterations += data[i].iterations;
+        now.samples += data[i].samples;
+        now.hits += data[i].hits;
+        now.accepted += data[i].accepted;
+        chains[i] = data[i].chain;
+    }
+    if (checkpoint_write(path, &now, chains, data->counts, merged) == 0) {
+        printf("Checkpoint after %ld samples: %s\n", work_done(data), path);
+    }
+    free(chains);
 }
 
 /**
@@ -197,17 +802,63 @@ void compute_colors(ThreadData *data, struct ppm_pixel *image) {
  */
 void *start(void *arg) {
     ThreadData *data = (ThreadData *)arg;
-    printf("Thread %lu) sub-image block: cols (%d,%d) to rows (%d,%d)\n",
-           pthread_self(), data->startCol, data->endCol, data->startRow, data->endRow);
-
-    // Determine Mandelbrot set membership
-    check_mandelbrot(data);
-    // Compute visited counts
-    compute_counts(data);
-    // Synchronize threads
+    printf("Thread %lu) reduces and colors rows (%d,%d)\n",
+           pthread_self(), data->startRow, data->endRow);
+    for (int c = 0; c < data->numChannels; c++) {
+        data->shard[c] = histogram_shard(&data->counts[c], data->id);
+        if (data->bufferSize > 0 &&
+            histogram_buffer_init(&data->buffers[c], &data->counts[c], data->bufferSize) != 0) {
+            fprintf(stderr, "Failed to allocate the scatter buffer\n");
+            exit(1);
+        }
+    }
+
+    int *iters = malloc(data->size * sizeof(int));
+    float *orbit = malloc(2 * data->kernel->maxIterations * sizeof(float));
+    int startRow, endRow;
+    data->inChunk = 0;
+    if (data->mode == MODE_RANDOM) {
+        compute_counts_random(data, orbit);
+    } else if (data->mode == MODE_MH) {
+        compute_counts_metropolis(data, orbit);
+    }
+    while ((data->mode == MODE_GRID || data->mode == MODE_ONEPASS) &&
+           claim_rows(data, &startRow, &endRow)) {
+        if (data->mode == MODE_ONEPASS) {
+            compute_counts_onepass(data, startRow, endRow, orbit);
+            continue;
+        }
+        // Determine Mandelbrot set membership
+        check_mandelbrot(data, startRow, endRow, iters);
+        // Compute visited counts
+        compute_counts(data, startRow, endRow, orbit);
+    }
+    free(iters);
+    free(orbit);
+    for (int c = 0; c < data->numChannels && data->bufferSize > 0; c++) {
+        histogram_buffer_free(&data->buffers[c]);
+    }
+
+    // Tell main that this thread has finished sampling; main may still
+    // checkpoint the unmerged shards until it joins the barrier
+    pthread_mutex_lock(&gateMutex);
+    workersDone++;
+    pthread_cond_broadcast(&gateCond);
+    pthread_mutex_unlock(&gateMutex);
+
+    // Every orbit must be counted before the shards are merged
+    pthread_barrier_wait(&sampledBarrier);
+    reduce_counts(data);
+    // maxCount must be final before any pixel is colored
     pthread_barrier_wait(&barrier);
-    // Compute colors
+    // Compute colors, and write them while other bands are still coloring
     compute_colors(data, data->image);
+    int rows = data->endRow - data->startRow;
+    if (data->output && ppm_write_band(data->output, data->startRow,
+                       data->image + (size_t)data->startRow * data->size, rows) != 0) {
+        fprintf(stderr, "Failed to write rows %d to %d\n", data->startRow, data->endRow - 1);
+        data->writeFailed = 1;
+    }
 
     printf("Thread %lu) finished\n", pthread_self());
     pthread_exit(NULL);
@@ -230,116 +881,469 @@ int main(int argc, char* argv[]) {
     float xmax = 0.47;
     float ymin = -1.12;
     float ymax = 1.12;
-    int maxIterations = 1000;
+    int maxIterations = MAX_ITER;
     int numProcesses = 4;
+    const char *kernelName = "mandelbrot";
+    const char *output = NULL;
+    const char *formatName = "ppm";
+    int histogramMB = HISTOGRAM_MB;
+    const char *modeName = "grid";
+    long samples = 0;
+    uint64_t seed = time(0);
+    const char *reference = NULL;
+    const char *nebula = NULL;
+    const char *checkpointPath = NULL;
+    int checkpointEvery = CHECKPOINT_SECONDS;
+    int resume = 0;
+    const char *previewPath = NULL;
+    long previewEvery = 0;
+    const char *hdrOutput = NULL;
+    int countBits = 32;
+    int bufferSize = 0;
+    int useSymmetry = 1;
 
+    static struct option longOptions[] = {
+        {"checkpoint", required_argument, 0, 'C'},
+        {"checkpoint-every", required_argument, 0, 'E'},
+        {"resume", no_argument, 0, 'U'},
+        {"preview", required_argument, 0, 'P'},
+        {"preview-every", required_argument, 0, 'V'},
+        {0, 0, 0, 0}
+    };
     int opt;
-    while ((opt = getopt(argc, argv, ":s:l:r:t:b:p:")) != -1) {
+    while ((opt = getopt_long(argc, argv, ":s:l:r:t:b:p:k:i:o:f:M:m:n:S:R:N:H:w:B:y",
+                              longOptions, NULL)) != -1) {
         switch (opt) {
         case 's': size = atoi(optarg); break;
         case 'l': xmin = atof(optarg); break;
         case 'r': xmax = atof(optarg); break;
         case 't': ymax = atof(optarg); break;
         case 'b': ymin = atof(optarg); break;
+        case 'k': kernelName = optarg; break;
+        case 'i': maxIterations = atoi(optarg); break;
+        case 'p': numProcesses = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'f': formatName = optarg; break;
+        case 'M': histogramMB = atoi(optarg); break;
+        case 'm': modeName = optarg; break;
+        case 'n': samples = atol(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 'R': reference = optarg; break;
+        case 'N': nebula = optarg; break;
+        case 'H': hdrOutput = optarg; break;
+        case 'w': countBits = atoi(optarg); break;
+        case 'B': bufferSize = atoi(optarg); break;
+        case 'y': useSymmetry = 0; break;
+        case 'C': checkpointPath = optarg; break;
+        case 'E': checkpointEvery = atoi(optarg); break;
+        case 'U': resume = 1; break;
+        case 'P': previewPath = optarg; break;
+        case 'V': previewEvery = atol(optarg); break;
         case '?': printf("usage: %s -s <size> -l <xmin> -r <xmax> "
-            "-b <ymin> -t <ymax> -p <numProcesses>\n", argv[0]); break;
+            "-b <ymin> -t <ymax> -p <numProcesses> -k <kernel> "
+            "-i <maxIterations> -o <output.ppm> -f ppm|qoi -M <histogramMB> "
+            "-m grid|onepass|random|mh -n <samples> -S <seed> "
+            "-R <reference.ppm> -N <red>,<green>,<blue> "
+            "--checkpoint <file> --checkpoint-every <seconds> --resume "
+            "--preview <file> --preview-every <samples> "
+            "-H <counts.pfm> -w 16|32 -B <bufferedAdds> -y\n", argv[0]); break;
         }
     }
+
+    enum sample_mode mode;
+    if (strcmp(modeName, "grid") == 0) mode = MODE_GRID;
+    else if (strcmp(modeName, "onepass") == 0) mode = MODE_ONEPASS;
+    else if (strcmp(modeName, "random") == 0) mode = MODE_RANDOM;
+    else if (strcmp(modeName, "mh") == 0) mode = MODE_MH;
+    else {
+        fprintf(stderr, "Unknown sampling mode %s\n", modeName);
+        return 1;
+    }
+    if (numProcesses < 1) numProcesses = 1;
+    if (countBits != 16 && countBits != 32) {
+        fprintf(stderr, "Counts must be 16 or 32 bits wide\n");
+        return 1;
+    }
+    if (resume && !checkpointPath) {
+        fprintf(stderr, "--resume needs --checkpoint <file>\n");
+        return 1;
+    }
+
+    // Nebulabrot: one iteration limit per channel, orbits run to the largest
+    int numChannels = 1;
+    int limits[MAX_CHANNELS] = {maxIterations};
+    if (nebula) {
+        if (sscanf(nebula, "%d,%d,%d", &limits[0], &limits[1], &limits[2]) != 3 ||
+            limits[0] < 1 || limits[1] < 1 || limits[2] < 1) {
+            fprintf(stderr, "Expected -N <red>,<green>,<blue> iteration limits\n");
+            return 1;
+        }
+        numChannels = 3;
+        maxIterations = 0;
+        for (int c = 0; c < numChannels; c++) {
+            if (limits[c] > maxIterations) maxIterations = limits[c];
+        }
+    }
+
+    struct escape_kernel kernel;
+    if (escape_kernel_parse(kernelName, &kernel) != 0) {
+        fprintf(stderr, "Unknown kernel %s\n", kernelName);
+        return 1;
+    }
+    enum image_format format;
+    if (image_format_parse(formatName, &format) != 0) {
+        fprintf(stderr, "Unknown output format %s\n", formatName);
+        return 1;
+    }
+    kernel.maxIterations = maxIterations;
     printf("Generating buddhabrot with size %dx%d\n", size, size);
     printf("  Num processes = %d\n", numProcesses);
+    printf("  Kernel = %s\n", kernelName);
+    printf("  Sampling mode = %s\n", modeName);
+    if (nebula) {
+        printf("  Nebulabrot limits = R %d, G %d, B %d\n", limits[0], limits[1], limits[2]);
+    }
+    int randomMode = (mode == MODE_RANDOM || mode == MODE_MH);
+    if (randomMode) {
+        totalSamples = samples > 0 ? samples : (long)size * size;
+        printf("  Samples = %ld (seed %llu)\n", totalSamples, (unsigned long long)seed);
+    }
     printf("  X range = [%.4f,%.4f]\n", xmin, xmax);
     printf("  Y range = [%.4f,%.4f]\n", ymin, ymax);
+    int axis2 = (useSymmetry && !randomMode) ? escape_mirror_axis(&kernel, ymin, ymax, size) : -1;
+    if (axis2 >= 0) {
+        int mirrored = (axis2 < size - 1 ? axis2 : size - 1) - axis2 / 2;
+        printf("  Mirrored rows = %d of %d\n", mirrored, size);
+    }
 
 
-    clock_t startTime = clock(); // Start timing
+    // Wall clock time; clock() would add up the CPU time of every thread
+    struct timeval startTime, endTime;
+    gettimeofday(&startTime, NULL);
+    struct rusage startUsage, endUsage;
+    getrusage(RUSAGE_SELF, &startUsage);
 
-    int *membership = malloc(size * size * sizeof(int));
-    int *counts = malloc(size * size * sizeof(int));
-    struct ppm_pixel *image = malloc(size * size * sizeof(struct ppm_pixel));
+    // Only the row modes classify pixels, so the random modes need no rows
+    struct bitmap membership;
+    struct ppm_pixel *image = malloc((size_t)size * size * sizeof(struct ppm_pixel));
+    if (bitmap_init(&membership, size, randomMode ? 0 : size) != 0 || !image) {
+        fprintf(stderr, "Failed to allocate memory for image\n");
+        return 1;
+    }
+    // The channels split the histogram memory budget between them
+    struct histogram counts[MAX_CHANNELS];
+    for (int c = 0; c < numChannels; c++) {
+        if (histogram_init(&counts[c], size, numProcesses,
+                           ((size_t)histogramMB << 20) / numChannels, countBits) != 0) {
+            fprintf(stderr, "Failed to allocate memory for histogram\n");
+            return 1;
+        }
+    }
+    printf("  Histogram shards = %d x %d channel(s) (%.1f MB%s)\n", counts[0].numShards,
+           numChannels, numChannels * histogram_bytes(&counts[0]) / 1048576.0,
+           counts[0].shared ? ", shared" : "");
+    size_t histogramBytes = numChannels * histogram_bytes(&counts[0]);
+    size_t imageBytes = (size_t)size * size * sizeof(struct ppm_pixel);
+    printf("  Memory = %.1f MB: histograms %.1f MB (%d-bit counts%s), membership "
+           "%.1f MB, image %.1f MB\n",
+           (histogramBytes + bitmap_bytes(&membership) + imageBytes) / 1048576.0,
+           histogramBytes / 1048576.0, counts[0].bits,
+           counts[0].bits == 16 ? ", saturating" : "",
+           bitmap_bytes(&membership) / 1048576.0, imageBytes / 1048576.0);
+    if (bufferSize > 0) {
+        printf("  Scatter buffers = %d adds per thread and channel (%.1f MB)\n", bufferSize,
+               (double)numProcesses * numChannels * bufferSize * 2 * sizeof(uint32_t) / 1048576.0);
+    }
+    double *xs = malloc(size * sizeof(double));
 
-    for (int i = 0; i < size * size; i++) {
-        membership[i] = 0;
-        counts[i] = 0;
-        image[i].red = image[i].green = image[i].blue = 0;
+    // Map each column to its real coordinate once; every row shares them
+    float xScale = (xmax - xmin) / size;
+    for (int col = 0; col < size; col++) {
+        xs[col] = xmin + col * xScale;
     }
 
+    memset(image, 0, imageBytes);
+
     // Allocate memory for thread data and thread handles
     ThreadData *data = malloc(numProcesses * sizeof(ThreadData));
     pthread_t *threads = malloc(numProcesses * sizeof(pthread_t));
 
     // Initialize synchronization primitives
     pthread_barrier_init(&barrier, NULL, numProcesses);
+    pthread_barrier_init(&sampledBarrier, NULL, numProcesses + 1);
     pthread_mutex_init(&countMutex, NULL);
 
-    // Determine the boundaries for each thread
-    int rowMid = size / 2;
-    int colMid = size / 2;
-
-    // Create threads to handle each quadrant of the image
+    // Set up threads; each also reduces and colors one band of rows
     for (int i = 0; i < numProcesses; i++) {
+        data[i].id = i;
+        data[i].startRow = (long)size * i / numProcesses;
+        data[i].endRow = (long)size * (i + 1) / numProcesses;
         data[i].size = size;
         data[i].xmin = xmin;
         data[i].xmax = xmax;
         data[i].ymin = ymin;
         data[i].ymax = ymax;
-        data[i].membership = membership;
+        data[i].kernel = &kernel;
+        data[i].xs = xs;
+        data[i].axis2 = axis2;
+        data[i].mode = mode;
+        data[i].seed = seed;
+        data[i].iterations = 0;
+        data[i].samples = 0;
+        data[i].hits = 0;
+        data[i].accepted = 0;
+        data[i].membership = &membership;
+        data[i].numChannels = numChannels;
+        data[i].limits = limits;
         data[i].counts = counts;
+        data[i].bufferSize = bufferSize;
         data[i].image = image;
+        data[i].writeFailed = 0;
+        data[i].weightScale = 1.0;
+        memset(&data[i].chain, 0, sizeof(data[i].chain));
+    }
 
-        if (i == 0) { 
-            data[i].startRow = 0; 
-            data[i].endRow = rowMid; 
-            data[i].startCol = 0;
-            data[i].endCol = colMid; 
-        }
-        if (i == 1) { 
-            data[i].startRow = 0; 
-            data[i].endRow = rowMid; 
-            data[i].startCol = colMid; 
-            data[i].endCol = size; 
+    // The render as a checkpoint describes it, with no progress yet
+    struct checkpoint ck;
+    memset(&ck, 0, sizeof(ck));
+    ck.size = size;
+    ck.xmin = xmin;
+    ck.xmax = xmax;
+    ck.ymin = ymin;
+    ck.ymax = ymax;
+    ck.kernel = kernel;
+    ck.mode = mode;
+    ck.axis2 = axis2;
+    ck.countBits = counts[0].bits;
+    ck.seed = seed;
+    ck.numChannels = numChannels;
+    memcpy(ck.limits, limits, sizeof(limits));
+    ck.numChains = mode == MODE_MH ? numProcesses : 0;
+
+    if (resume) {
+        struct checkpoint saved;
+        struct checkpoint_chain *chains = calloc(numProcesses, sizeof(struct checkpoint_chain));
+        if (checkpoint_read(checkpointPath, &ck, &saved, chains, counts) != 0) {
+            return 1;
         }
-        if (i == 2) { 
-            data[i].startRow = rowMid; 
-            data[i].endRow = size; 
-            data[i].startCol = 0; 
-            data[i].endCol = colMid; 
+        for (int i = 0; i < saved.numChains; i++) {
+            data[i].chain = chains[i];
         }
-        if (i == 3) { 
-            data[i].startRow = rowMid; 
-            data[i].endRow = size; 
-            data[i].startCol = colMid; 
-            data[i].endCol = size; 
+        free(chains);
+        nextRow = saved.nextRow;
+        nextSample = saved.nextSample;
+        // Later checkpoints add this run's progress to the earlier runs'
+        ck.iterations = saved.iterations;
+        ck.samples = saved.samples;
+        ck.hits = saved.hits;
+        ck.accepted = saved.accepted;
+        ck.weightScale = saved.weightScale;
+        printf("  Resumed from %s after %ld samples\n", checkpointPath, work_done(&data[0]));
+    }
+
+    // Every Metropolis-Hastings chain must weight its orbits the same way
+    if (mode == MODE_MH) {
+        double weightScale = resume ? ck.weightScale : estimate_weight_scale(&data[0]);
+        ck.weightScale = weightScale;
+        printf("  Weight scale = %.3f\n", weightScale);
+        for (int i = 0; i < numProcesses; i++) {
+            data[i].weightScale = weightScale;
         }
+    }
+
+    // Use -o if given, else generate the output filename with a timestamp;
+    // the file is created now so that the threads can write their bands
+    time_t currentTime = time(0);
+    char filename[256];
+    if (output) {
+        snprintf(filename, sizeof(filename), "%s", output);
+    } else {
+        snprintf(filename, sizeof(filename), "buddhabrot-%d-%ld.%s", size, currentTime,
+                 image_format_extension(format));
+    }
+    struct ppm_band_writer writer = {-1};
+    struct ppm_header header = ppm_rgb_header(size, size);
+    if (format == IMAGE_PPM && ppm_band_writer_open(&writer, filename, &header) != 0) {
+        return 1;
+    }
 
+    for (int i = 0; i < numProcesses; i++) {
+        data[i].output = format == IMAGE_PPM ? &writer : NULL;
         pthread_create(&threads[i], NULL, start, &data[i]);
     }
 
+    // Watch the render while it samples: write previews, and pause the
+    // workers for checkpoints on a timer or when interrupted
+    if (checkpointPath) {
+        signal(SIGINT, request_stop);
+        signal(SIGTERM, request_stop);
+    }
+    long totalWork = randomMode ? totalSamples : (long)size * size;
+    if (previewEvery <= 0) previewEvery = totalWork / PREVIEWS > 0 ? totalWork / PREVIEWS : 1;
+    long nextPreview = work_done(&data[0]) + previewEvery;
+    int **snapshot = NULL;
+    struct ppm_pixel *preview = NULL;
+    if (previewPath) {
+        snapshot = malloc(numChannels * sizeof(int *));
+        for (int c = 0; c < numChannels; c++) {
+            snapshot[c] = malloc(size * size * sizeof(int));
+        }
+        preview = malloc(size * size * sizeof(struct ppm_pixel));
+    }
+    struct timeval lastCheckpoint = startTime;
+
+    pthread_mutex_lock(&gateMutex);
+    while (workersDone < numProcesses) {
+        if (!checkpointPath && !previewPath) {
+            pthread_cond_wait(&gateCond, &gateMutex);
+            continue;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 100 * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&gateCond, &gateMutex, &deadline);
+        if (workersDone == numProcesses) break;
+        pthread_mutex_unlock(&gateMutex);
+
+        long done = work_done(&data[0]);
+        if (previewPath && done >= nextPreview) {
+            write_preview(&data[0], snapshot, preview, previewPath);
+            printf("Preview after %ld samples: %s\n", done, previewPath);
+            while (nextPreview <= done) nextPreview += previewEvery;
+        }
+
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        if (checkpointPath &&
+            (stopRequested || now.tv_sec - lastCheckpoint.tv_sec >= checkpointEvery)) {
+            pause_workers();
+            save_checkpoint(checkpointPath, &ck, data, numProcesses, 0);
+            if (stopRequested) {
+                printf("Stopped; continue with --resume --checkpoint %s\n", checkpointPath);
+                // The image was never colored, so leave no blank file behind
+                if (format == IMAGE_PPM) {
+                    ppm_band_writer_close(&writer);
+                    remove(filename);
+                }
+                exit(1);
+            }
+            resume_workers();
+            gettimeofday(&lastCheckpoint, NULL);
+        }
+        pthread_mutex_lock(&gateMutex);
+    }
+    pthread_mutex_unlock(&gateMutex);
+    // Let the workers merge the shards
+    pthread_barrier_wait(&sampledBarrier);
+
     // Wait for all threads to complete their work
     for (int i = 0; i < numProcesses; i++) {
         pthread_join(threads[i], NULL);
     }
 
-    clock_t endTime = clock(); // End timing
-    double elapsed = ((double)(endTime - startTime)) / CLOCKS_PER_SEC;
+    gettimeofday(&endTime, NULL);
+    getrusage(RUSAGE_SELF, &endUsage);
+    double elapsed = (endTime.tv_sec - startTime.tv_sec) +
+        (endTime.tv_usec - startTime.tv_usec) / 1000000.0;
+    double cpu = (endUsage.ru_utime.tv_sec - startUsage.ru_utime.tv_sec) +
+        (endUsage.ru_utime.tv_usec - startUsage.ru_utime.tv_usec) / 1000000.0 +
+        (endUsage.ru_stime.tv_sec - startUsage.ru_stime.tv_sec) +
+        (endUsage.ru_stime.tv_usec - startUsage.ru_stime.tv_usec) / 1000000.0;
     printf("Computed buddhabrot set (%dx%d) in %.6f seconds\n", size, size, elapsed);
+    if (checkpointPath) {
+        save_checkpoint(checkpointPath, &ck, data, numProcesses, 1);
+    }
 
-    // Generate the output filename with a timestamp
-    time_t currentTime = time(0);
-    char filename[256];
-    snprintf(filename, sizeof(filename), "buddhabrot-%d-%ld.ppm", size, currentTime);
-    write_ppm(filename, image, size, size);
-    printf("Writing file: %s\n", filename);
+    long iterations = 0, sampled = 0, hits = 0, accepted = 0;
+    for (int i = 0; i < numProcesses; i++) {
+        iterations += data[i].iterations;
+        sampled += data[i].samples;
+        hits += data[i].hits;
+        accepted += data[i].accepted;
+    }
+    printf("  Iterations = %ld (%.1f per pixel)\n", iterations, (double)iterations / size / size);
+    if (randomMode) {
+        printf("  CPU time = %.3f s: %.0f samples/CPU-s, %.0f viewport hits/CPU-s\n",
+               cpu, sampled / cpu, hits / cpu);
+    }
+    if (mode == MODE_MH) {
+        printf("  Acceptance rate = %.2f%%\n", 100.0 * accepted / sampled);
+    }
+
+    // The threads have written every band of a PPM file
+    int failed = 0;
+    for (int i = 0; i < numProcesses; i++) {
+        failed |= data[i].writeFailed;
+    }
+    if (format == IMAGE_PPM) {
+        if (ppm_band_writer_close(&writer) != 0) failed = 1;
+    } else if (write_image(filename, image, size, size, format) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "Failed to write file: %s\n", filename);
+    } else {
+        printf("Writing file: %s\n", filename);
+    }
+
+    // Save the merged counts for re-grading with ./tonemap
+    if (hdrOutput) {
+        float *values = malloc((size_t)size * size * numChannels * sizeof(float));
+        for (int i = 0; i < size * size; i++) {
+            for (int c = 0; c < numChannels; c++) {
+                values[i * numChannels + c] = histogram_count(&counts[c], i);
+            }
+        }
+        if (write_pfm(hdrOutput, values, size, size, numChannels) == 0) {
+            printf("Writing file: %s\n", hdrOutput);
+        }
+        free(values);
+    }
+
+    // Measure convergence against a (long-running) reference render
+    if (reference) {
+        int refWidth, refHeight;
+        struct ppm_map refMap;
+        const struct ppm_pixel *ref = map_ppm(reference, &refWidth, &refHeight, &refMap);
+        if (ref && refWidth == size && refHeight == size) {
+            double error = 0;
+            for (int i = 0; i < size * size; i++) {
+                double diff = (image[i].red - ref[i].red) / 255.0;
+                error += diff * diff;
+            }
+            error = sqrt(error / size / size);
+            printf("  RMS error vs %s = %.5f after %.3f CPU seconds\n", reference, error, cpu);
+        } else {
+            fprintf(stderr, "Reference %s does not match the image size\n", reference);
+        }
+        unmap_ppm(&refMap);
+    }
 
     // Clean up synchronization primitives
     pthread_barrier_destroy(&barrier); 
+    pthread_barrier_destroy(&sampledBarrier);
     pthread_mutex_destroy(&countMutex);
 
     // Free dynamically allocated memory
-    free(membership);
-    free(counts);
+    bitmap_free(&membership);
+    for (int c = 0; c < numChannels; c++) {
+        histogram_free(&counts[c]);
+    }
     free(image);
+    free(xs);
+    if (previewPath) {
+        for (int c = 0; c < numChannels; c++) {
+            free(snapshot[c]);
+        }
+        free(snapshot);
+        free(preview);
+    }
     free(data);
     free(threads);
 
-    return 0;
+    return failed;
 }
\ No newline at end of file
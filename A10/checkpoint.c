@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+
+/**
+ * Buddhabrot Checkpoints
+ *
+ * Saves the histograms and sampler state of a render so that it can be
+ * resumed after it is stopped. The file holds a magic number, the
+ * checkpoint structure, the chain states, and the counts of every channel
+ * as variable-length integers (7 bits per byte), which keeps the mostly
+ * small counts to a byte or two each. The file is meant to be resumed on
+ * the machine that wrote it.
+ *
+ * @author: Tianyun Song
+ * @version: November 26, 2024
+ */
+
+static const char MAGIC[8] = "BUDDHCK2";
+
+/**
+ * Writes a count as a variable-length integer.
+ * @param fp The file to write to
+ * @param value The count, never negative
+ */
+static void put_count(FILE* fp, unsigned int value) {
+    while (value >= 0x80) {
+        putc((value & 0x7f) | 0x80, fp);
+        value >>= 7;
+    }
+    putc(value, fp);
+}
+
+/**
+ * Reads a count written by put_count.
+ * @param fp The file to read from
+ * @param value Returns the count
+ * @return 0 on success, or -1 at the end of the file
+ */
+static int get_count(FILE* fp, int* value) {
+    unsigned int result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = getc(fp);
+        if (c == EOF) return -1;
+        result |= (unsigned int)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value = (int)result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int checkpoint_write(const char* path, const struct checkpoint* ck,
+                     const struct checkpoint_chain* chains,
+                     const struct histogram* channels, int merged) {
+    // Write beside the old checkpoint and swap it in at the end, so that a
+    // crash while writing never loses the last good one
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* fp = fopen(temp, "wb");
+    if (!fp) {
+        fprintf(stderr, "Cannot write checkpoint %s\n", temp);
+        return -1;
+    }
+
+    fwrite(MAGIC, sizeof(MAGIC), 1, fp);
+    fwrite(ck, sizeof(*ck), 1, fp);
+    fwrite(chains, sizeof(*chains), ck->numChains, fp);
+
+    int* row = malloc(ck->size * sizeof(int));
+    for (int c = 0; c < ck->numChannels; c++) {
+        for (int r = 0; r < ck->size; r++) {
+            if (merged) {
+                for (int i = 0; i < ck->size; i++) {
+                    row[i] = histogram_count(&channels[c], (size_t)r * ck->size + i);
+                }
+            } else {
+                histogram_snapshot(&channels[c], r, r + 1, row);
+            }
+            for (int i = 0; i < ck->size; i++) {
+                put_count(fp, row[i]);
+            }
+        }
+    }
+    free(row);
+
+    int failed = ferror(fp);
+    if (fclose(fp) != 0 || failed || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write checkpoint %s\n", path);
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Checks that a saved checkpoint describes the same render.
+ * @param a The render being resumed
+ * @param b The saved checkpoint
+ * @return 1 if they match, 0 otherwise
+ */
+static int same_render(const struct checkpoint* a, const struct checkpoint* b) {
+    if (a->size != b->size || a->xmin != b->xmin || a->xmax != b->xmax ||
+        a->ymin != b->ymin || a->ymax != b->ymax) return 0;
+    if (a->kernel.formula != b->kernel.formula || a->kernel.power != b->kernel.power ||
+        a->kernel.precision != b->kernel.precision || a->kernel.jx != b->kernel.jx ||
+        a->kernel.jy != b->kernel.jy || a->kernel.maxIterations != b->kernel.maxIterations) return 0;
+    if (a->mode != b->mode || a->axis2 != b->axis2 || a->countBits != b->countBits ||
+        a->seed != b->seed || a->numChannels != b->numChannels) return 0;
+    for (int c = 0; c < a->numChannels; c++) {
+        if (a->limits[c] != b->limits[c]) return 0;
+    }
+    return 1;
+}
+
+int checkpoint_read(const char* path, const struct checkpoint* expected,
+                    struct checkpoint* saved, struct checkpoint_chain* chains,
+                    struct histogram* channels) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open checkpoint %s\n", path);
+        return -1;
+    }
+
+    char magic[sizeof(MAGIC)];
+    if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        fread(saved, sizeof(*saved), 1, fp) != 1) {
+        fprintf(stderr, "%s is not a buddhabrot checkpoint\n", path);
+        fclose(fp);
+        return -1;
+    }
+    if (!same_render(expected, saved)) {
+        fprintf(stderr, "Checkpoint %s was saved for a different render "
+                "(size, view, kernel, mode, symmetry (-y), count width (-w), seed and limits "
+                "must match)\n", path);
+        fclose(fp);
+        return -1;
+    }
+    if (saved->numChains > expected->numChains) {
+        fprintf(stderr, "Checkpoint %s has %d chains; resume with at least -p %d\n",
+                path, saved->numChains, saved->numChains);
+        fclose(fp);
+        return -1;
+    }
+    if (fread(chains, sizeof(*chains), saved->numChains, fp) != (size_t)saved->numChains) {
+        fprintf(stderr, "Checkpoint %s is truncated\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    size_t cells = (size_t)saved->size * saved->size;
+    for (int c = 0; c < saved->numChannels; c++) {
+        for (size_t i = 0; i < cells; i++) {
+            int count;
+            if (get_count(fp, &count) != 0) {
+                fprintf(stderr, "Checkpoint %s is truncated\n", path);
+                fclose(fp);
+                return -1;
+            }
+            histogram_set(&channels[c], i, count);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
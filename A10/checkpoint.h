@@ -0,0 +1,57 @@
+#ifndef checkpoint_H_
+#define checkpoint_H_
+
+#include <stdint.h>
+#include "escape.h"
+#include "histogram.h"
+
+#define CHECKPOINT_CHANNELS 3
+
+// The state of one Metropolis-Hastings chain between two batches
+struct checkpoint_chain {
+  int ready;      // 0 if the chain had not started yet
+  double x, y;    // current seed
+  uint64_t rng;   // state of the chain's generator
+};
+
+// Everything a render needs to carry on where it stopped. The first group
+// of fields describes the render and must match to resume; the second is
+// the progress so far.
+struct checkpoint {
+  int size;
+  float xmin, xmax, ymin, ymax;
+  struct escape_kernel kernel;
+  int mode;
+  int axis2;             // the mirror axis of the row modes, or -1
+  int countBits;         // 16 or 32
+  uint64_t seed;
+  int numChannels;
+  int limits[CHECKPOINT_CHANNELS];
+  double weightScale;
+  int numChains;
+
+  int nextRow;           // rows finished by the row modes
+  long nextSample;       // samples finished by the random modes
+  long iterations;
+  long samples;
+  long hits;
+  long accepted;
+};
+
+// write a checkpoint to path, replacing any older one only once the new
+// one is complete; the counts of every channel are summed over the shards,
+// or taken from shard 0 alone if merged is set (after histogram_reduce)
+// returns 0 on success, or -1 if the file cannot be written
+extern int checkpoint_write(const char* path, const struct checkpoint* ck,
+                            const struct checkpoint_chain* chains,
+                            const struct histogram* channels, int merged);
+
+// read the checkpoint at path into saved, checking that it describes the
+// same render as expected; the chains (up to expected->numChains) and the
+// counts of every channel, into shard 0, are loaded as well
+// returns 0 on success, or -1 if the file is missing, damaged or differs
+extern int checkpoint_read(const char* path, const struct checkpoint* expected,
+                           struct checkpoint* saved, struct checkpoint_chain* chains,
+                           struct histogram* channels);
+
+#endif
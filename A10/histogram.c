@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+/**
+ * Sharded Count Histogram
+ *
+ * Bounds the memory of parallel accumulation: rather than one full-size
+ * private histogram per thread, threads share a fixed number of shards
+ * that fit in a memory budget. The shards are merged band by band, so
+ * every thread takes part in the reduction.
+ *
+ * @author: Tianyun Song
+ * @version: November 25, 2024
+ */
+
+/**
+ * Allocates the shards of a histogram.
+ * @param h The histogram to initialize
+ * @param size The width and height of the count grid
+ * @param numThreads The number of threads that will add to it
+ * @param budget The most memory, in bytes, that the shards may use
+ * @param bits The width of a count, 16 (saturating) or 32
+ * @return 0 on success, or -1 if memory allocation fails
+ */
+int histogram_init(struct histogram* h, int size, int numThreads, size_t budget, int bits) {
+    size_t cell = bits == 16 ? sizeof(uint16_t) : sizeof(int);
+    size_t bytes = (size_t)size * size * cell;
+    size_t fit = bytes > 0 ? budget / bytes : 1;
+
+    h->size = size;
+    h->bits = bits == 16 ? 16 : 32;
+    h->numShards = numThreads < (int)fit ? numThreads : (int)fit;
+    if (h->numShards < 1) h->numShards = 1;
+    h->shared = numThreads > h->numShards;
+
+    h->shards = calloc(h->numShards, sizeof(void*));
+    if (!h->shards) return -1;
+    for (int i = 0; i < h->numShards; i++) {
+        h->shards[i] = calloc((size_t)size * size, cell);
+        if (!h->shards[i]) {
+            fprintf(stderr, "Failed to allocate histogram shard %d\n", i);
+            histogram_free(h);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Frees the shards of a histogram.
+ * @param h The histogram to free
+ */
+void histogram_free(struct histogram* h) {
+    if (!h->shards) return;
+    for (int i = 0; i < h->numShards; i++) {
+        free(h->shards[i]);
+    }
+    free(h->shards);
+    h->shards = NULL;
+}
+
+/**
+ * Returns the shard that a thread adds to.
+ * @param h The histogram
+ * @param thread The thread's index, from 0
+ */
+void* histogram_shard(const struct histogram* h, int thread) {
+    return h->shards[thread % h->numShards];
+}
+
+/**
+ * Adds every shard into shard 0 for a band of rows.
+ * @param h The histogram
+ * @param startRow The first row of the band
+ * @param endRow One past the last row of the band
+ * @return The largest merged count in the band
+ */
+int histogram_reduce(struct histogram* h, int startRow, int endRow) {
+    size_t start = (size_t)startRow * h->size;
+    size_t end = (size_t)endRow * h->size;
+    int max = 0;
+
+    if (h->bits == 16) {
+        uint16_t* total = h->shards[0];
+        for (int s = 1; s < h->numShards; s++) {
+            uint16_t* shard = h->shards[s];
+            for (size_t i = start; i < end; i++) {
+                int sum = total[i] + shard[i];
+                total[i] = sum < HISTOGRAM_MAX16 ? sum : HISTOGRAM_MAX16;
+            }
+        }
+        for (size_t i = start; i < end; i++) {
+            if (total[i] > max) max = total[i];
+        }
+        return max;
+    }
+
+    int* total = h->shards[0];
+    for (int s = 1; s < h->numShards; s++) {
+        int* shard = h->shards[s];
+        for (size_t i = start; i < end; i++) {
+            total[i] += shard[i];
+        }
+    }
+
+    for (size_t i = start; i < end; i++) {
+        if (total[i] > max) max = total[i];
+    }
+    return max;
+}
+
+/**
+ * Sums every shard for a band of rows without modifying the shards. The
+ * loads are atomic and so are the stores of histogram_add, shared or not,
+ * so this may run while threads are adding.
+ * @param h The histogram
+ * @param startRow The first row of the band
+ * @param endRow One past the last row of the band
+ * @param out Returns the summed counts of the band
+ */
+void histogram_snapshot(const struct histogram* h, int startRow, int endRow, int* out) {
+    size_t start = (size_t)startRow * h->size;
+    size_t end = (size_t)endRow * h->size;
+
+    memset(out, 0, (end - start) * sizeof(int));
+    for (int s = 0; s < h->numShards; s++) {
+        if (h->bits == 16) {
+            uint16_t* shard = h->shards[s];
+            for (size_t i = start; i < end; i++) {
+                int sum = out[i - start] + __atomic_load_n(&shard[i], __ATOMIC_RELAXED);
+                out[i - start] = sum < HISTOGRAM_MAX16 ? sum : HISTOGRAM_MAX16;
+            }
+        } else {
+            int* shard = h->shards[s];
+            for (size_t i = start; i < end; i++) {
+                out[i - start] += __atomic_load_n(&shard[i], __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+/**
+ * Returns the memory used by all shards.
+ * @param h The histogram
+ */
+size_t histogram_bytes(const struct histogram* h) {
+    size_t cell = h->bits == 16 ? sizeof(uint16_t) : sizeof(int);
+    return (size_t)h->numShards * h->size * h->size * cell;
+}
+
+/**
+ * Allocates a buffer of pending adds.
+ * @param b The buffer to initialize
+ * @param h The histogram the adds are for
+ * @param capacity The number of adds held before a flush
+ * @return 0 on success, or -1 if memory allocation fails
+ */
+int histogram_buffer_init(struct histogram_buffer* b, const struct histogram* h, int capacity) {
+    size_t cells = (size_t)h->size * h->size;
+    b->capacity = capacity > 0 ? capacity : 1;
+    b->count = 0;
+    b->numTiles = (int)((cells + (1 << HISTOGRAM_TILE_SHIFT) - 1) >> HISTOGRAM_TILE_SHIFT);
+    b->cells = malloc(b->capacity * sizeof(uint32_t));
+    b->sorted = malloc(b->capacity * sizeof(uint32_t));
+    b->tileStarts = malloc((b->numTiles + 1) * sizeof(int));
+    if (!b->cells || !b->sorted || !b->tileStarts) {
+        histogram_buffer_free(b);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Frees a buffer of pending adds.
+ * @param b The buffer to free
+ */
+void histogram_buffer_free(struct histogram_buffer* b) {
+    free(b->cells);
+    free(b->sorted);
+    free(b->tileStarts);
+    b->cells = b->sorted = NULL;
+    b->tileStarts = NULL;
+}
+
+/**
+ * Applies the pending adds: a counting sort groups them by tile, then the
+ * adds of each tile are made together.
+ * @param b The buffer
+ * @param h The histogram
+ * @param shard The shard to add to
+ */
+void histogram_buffer_flush(struct histogram_buffer* b, const struct histogram* h, void* shard) {
+    if (b->count == 0) return;
+
+    int* starts = b->tileStarts;
+    memset(starts, 0, (b->numTiles + 1) * sizeof(int));
+    for (int i = 0; i < b->count; i++) {
+        starts[(b->cells[i] >> HISTOGRAM_TILE_SHIFT) + 1]++;
+    }
+    for (int t = 0; t < b->numTiles; t++) {
+        starts[t + 1] += starts[t];
+    }
+    for (int i = 0; i < b->count; i++) {
+        b->sorted[starts[b->cells[i] >> HISTOGRAM_TILE_SHIFT]++] = b->cells[i];
+    }
+
+    for (int i = 0; i < b->count; i++) {
+        histogram_add(h, shard, b->sorted[i]);
+    }
+    b->count = 0;
+}
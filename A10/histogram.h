@@ -0,0 +1,119 @@
+#ifndef histogram_H_
+#define histogram_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTOGRAM_MAX16 0xffff   // where 16-bit counts saturate
+
+// A size x size count grid split into shards so that threads can add to it
+// without a private full-size copy each. Thread t adds to shard
+// t % numShards; shard 0 doubles as the merged result. When there are more
+// threads than shards, the shards are shared and updated atomically.
+// A shard with one thread adding to it is updated with relaxed atomic
+// loads and stores, which cost the same as plain ones, so that
+// histogram_snapshot can read it while the thread adds.
+// Counts are 32-bit ints, or 16-bit and saturating at HISTOGRAM_MAX16 to
+// fit twice as many shards or pixels in the same memory.
+struct histogram {
+  int size;
+  int numShards;
+  int shared;     // 1 if more than one thread adds to a shard
+  int bits;       // 16 or 32
+  void** shards;
+};
+
+// allocate a histogram of 16- or 32-bit counts with as many shards as
+// numThreads, limited so that all shards fit in budget bytes (at least one
+// shard is always allocated)
+// returns 0 on success, or -1 if the memory cannot be allocated
+extern int histogram_init(struct histogram* h, int size, int numThreads, size_t budget, int bits);
+
+// free the shards of a histogram
+extern void histogram_free(struct histogram* h);
+
+// the shard a thread should add to
+extern void* histogram_shard(const struct histogram* h, int thread);
+
+// add one visit to cell idx of a thread's shard
+static inline void histogram_add(const struct histogram* h, void* shard, int idx) {
+  if (h->bits == 16) {
+    uint16_t* cell = (uint16_t*)shard + idx;
+    if (h->shared) {
+      uint16_t old = __atomic_load_n(cell, __ATOMIC_RELAXED);
+      while (old != HISTOGRAM_MAX16 &&
+             !__atomic_compare_exchange_n(cell, &old, old + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      }
+    } else {
+      uint16_t old = __atomic_load_n(cell, __ATOMIC_RELAXED);
+      if (old != HISTOGRAM_MAX16) __atomic_store_n(cell, old + 1, __ATOMIC_RELAXED);
+    }
+  } else if (h->shared) {
+    __atomic_fetch_add((int*)shard + idx, 1, __ATOMIC_RELAXED);
+  } else {
+    int* cell = (int*)shard + idx;
+    __atomic_store_n(cell, __atomic_load_n(cell, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+  }
+}
+
+// the merged count of cell idx, once histogram_reduce has run
+static inline int histogram_count(const struct histogram* h, size_t idx) {
+  if (h->bits == 16) return ((uint16_t*)h->shards[0])[idx];
+  return ((int*)h->shards[0])[idx];
+}
+
+// set the merged count of cell idx, saturating 16-bit counts
+static inline void histogram_set(struct histogram* h, size_t idx, int count) {
+  if (h->bits == 16) {
+    ((uint16_t*)h->shards[0])[idx] = count < HISTOGRAM_MAX16 ? count : HISTOGRAM_MAX16;
+  } else {
+    ((int*)h->shards[0])[idx] = count;
+  }
+}
+
+// merge rows [startRow, endRow) of every shard into shard 0; threads may
+// reduce disjoint bands in parallel once all adds have finished
+// returns the largest merged count in the band
+extern int histogram_reduce(struct histogram* h, int startRow, int endRow);
+
+// sum rows [startRow, endRow) of every shard into out, which starts at row
+// startRow; safe to call while other threads are still adding, in which
+// case the result is a recent but not exact total
+extern void histogram_snapshot(const struct histogram* h, int startRow, int endRow, int* out);
+
+// the memory used by all shards, in bytes
+extern size_t histogram_bytes(const struct histogram* h);
+
+#define HISTOGRAM_TILE_SHIFT 14   // a tile is 2^14 cells, 64 KB of int counts
+
+// A thread's buffer of pending adds for one shard. Rather than scattering
+// each add across a histogram much larger than the cache, adds are
+// collected, sorted by tile, and applied one tile at a time, so each tile
+// stays in cache while its adds land.
+struct histogram_buffer {
+  int capacity;
+  int count;
+  int numTiles;
+  uint32_t* cells;    // pending adds, in arrival order
+  uint32_t* sorted;   // the same adds grouped by tile
+  int* tileStarts;    // numTiles + 1 counters for the counting sort
+};
+
+// allocate a buffer of capacity adds for histogram h
+// returns 0 on success, or -1 if the memory cannot be allocated
+extern int histogram_buffer_init(struct histogram_buffer* b, const struct histogram* h, int capacity);
+
+// free the memory of a buffer; any pending adds are lost
+extern void histogram_buffer_free(struct histogram_buffer* b);
+
+// apply every pending add to shard, tile by tile
+extern void histogram_buffer_flush(struct histogram_buffer* b, const struct histogram* h, void* shard);
+
+// queue one visit to cell idx of shard, flushing when the buffer is full
+static inline void histogram_buffer_add(struct histogram_buffer* b, const struct histogram* h,
+                                        void* shard, int idx) {
+  b->cells[b->count++] = idx;
+  if (b->count == b->capacity) histogram_buffer_flush(b, h, shard);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pfm.h"
+
+/**
+ * PFM Reader and Writer
+ *
+ * Portable float maps hold one or three 32-bit floats per pixel, which
+ * keeps raw histogram counts without rounding them to 8 bits. The rows
+ * are stored from the bottom of the image up and the sign of the scale
+ * gives the byte order (negative for little-endian).
+ *
+ * @author: Tianyun Song
+ * @version: November 27, 2024
+ */
+
+/**
+ * Returns 1 if this machine stores numbers little-endian.
+ */
+static int little_endian() {
+    uint16_t one = 1;
+    return *(unsigned char*)&one == 1;
+}
+
+/**
+ * Writes a PFM file in the machine's byte order.
+ *
+ * @param filename The name of the PFM file to write
+ * @param values The pixel values, rows from the top down
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param channels 1 for greyscale or 3 for color
+ * @return 0 on success, or -1 if the file could not be written
+ */
+int write_pfm(const char* filename, const float* values, int w, int h, int channels) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        return -1;
+    }
+
+    fprintf(file, "%s\n%d %d\n%s\n", channels == 3 ? "PF" : "Pf", w, h,
+            little_endian() ? "-1.0" : "1.0");
+    size_t row = (size_t)w * channels;
+    for (int y = h - 1; y >= 0; y--) {
+        fwrite(values + y * row, sizeof(float), row, file);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Unable to write file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Reads a PFM file in either byte order.
+ *
+ * @param filename The name of the PFM file to read
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @param channels Pointer to store the number of channels
+ * @return The pixel values from the top row down, or NULL if the file
+ *         could not be read
+ */
+float* read_pfm(const char* filename, int* w, int* h, int* channels) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return NULL;
+    }
+
+    char format[3];
+    double scale;
+    if (fscanf(file, "%2s %d %d %lf", format, w, h, &scale) != 4 ||
+        (strcmp(format, "PF") != 0 && strcmp(format, "Pf") != 0) ||
+        *w <= 0 || *h <= 0 || scale == 0) {
+        fprintf(stderr, "%s is not a PFM file\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    fgetc(file);  // Consume the newline character after the scale
+    *channels = format[1] == 'F' ? 3 : 1;
+
+    size_t row = (size_t)*w * *channels;
+    float* values = malloc(row * *h * sizeof(float));
+    if (!values) {
+        fprintf(stderr, "Failed to allocate memory for pixels\n");
+        fclose(file);
+        return NULL;
+    }
+    for (int y = *h - 1; y >= 0; y--) {
+        if (fread(values + y * row, sizeof(float), row, file) != row) {
+            fprintf(stderr, "%s is truncated\n", filename);
+            free(values);
+            fclose(file);
+            return NULL;
+        }
+    }
+    fclose(file);
+
+    // Swap the bytes of files written on a machine of the other order
+    if ((scale < 0) != little_endian()) {
+        uint32_t* words = (uint32_t*)values;
+        for (size_t i = 0; i < row * *h; i++) {
+            words[i] = __builtin_bswap32(words[i]);
+        }
+    }
+    return values;
+}
@@ -0,0 +1,23 @@
+#ifndef PFM_H_
+#define PFM_H_
+
+// write a PFM (portable float map) file
+// filename: the file to save to
+// values: channels floats per pixel, rows from the top of the image down
+// w: the width of the image
+// h: the height of the image
+// channels: 1 (greyscale, "Pf") or 3 (color, "PF")
+// returns 0 on success, or -1 if the file cannot be written
+extern int write_pfm(const char* filename, const float* values, int w, int h, int channels);
+
+// read in a PFM file
+// filename: the image to load
+// w: pointer argument for returning the width of the image
+// h: pointer argument for returning the height of the image
+// channels: pointer argument for returning 1 or 3
+// returns channels floats per pixel from the top row down, or NULL, if the
+// file cannot be loaded
+// NOTE: Caller is responsible for freeing the returned array
+extern float* read_pfm(const char* filename, int* w, int* h, int* channels);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef rng_H_
+#define rng_H_
+
+#include <stdint.h>
+
+// A small, fast pseudo-random generator (splitmix64) that each thread owns,
+// so sampling never contends on the shared state of rand()
+struct rng {
+  uint64_t state;
+};
+
+// advance the generator and return 64 random bits
+static inline uint64_t rng_next(struct rng* r) {
+  uint64_t z = (r->state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// start an independent stream for (seed, stream), e.g. one per thread or
+// per batch of samples; the same pair always gives the same sequence
+static inline void rng_seed(struct rng* r, uint64_t seed, uint64_t stream) {
+  r->state = seed;
+  r->state = rng_next(r) ^ (stream * 0xD1B54A32D192ED03ull);
+  rng_next(r);
+}
+
+// a uniform double in [0, 1)
+static inline double rng_uniform(struct rng* r) {
+  return (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tonecurve.h"
+
+/**
+ * Tone Curves
+ *
+ * Builds a lookup table for a tone curve once, so that mapping an image
+ * costs one table lookup per value instead of a log and a pow. The table
+ * indices of a block of values are computed four at a time with SSE2 (a
+ * shift, subtract and clamp of the float bits); the lookups themselves
+ * stay scalar since SSE2 has no gather.
+ *
+ * @author: Tianyun Song
+ * @version: November 27, 2024
+ */
+
+#define BLOCK 1024   // values whose indices are computed at a time
+
+/**
+ * Computes the base-10 logarithm of an integer, as the original buddhabrot
+ * coloring did: one step of log10(2) per halving.
+ * @param x The input value
+ * @return The logarithm of x
+ */
+static double custom_log(int x) {
+    double result = 0.0;
+    int base = 2;
+    while (x > 1) {
+        x /= base;
+        result += 0.30102999566;  // log2 to log10
+    }
+    return result;
+}
+
+/**
+ * Computes base raised to the power of exponent, as the original buddhabrot
+ * coloring did: only the integer part of the exponent is used.
+ * @param base The base value
+ * @param exponent The exponent value
+ * @return base raised to the power of exponent
+ */
+static double custom_pow(double base, double exponent) {
+    if (exponent == 0) return 1.0;
+    double result = 1.0;
+    int i;
+    for (i = 0; i < (int)exponent; i++) {
+        result *= base;
+    }
+    return result;
+}
+
+int tonecurve_parse(const char* name, enum tonecurve_kind* kind) {
+    if (strcmp(name, "legacy") == 0) *kind = TONECURVE_LEGACY;
+    else if (strcmp(name, "log") == 0) *kind = TONECURVE_LOG;
+    else if (strcmp(name, "gamma") == 0) *kind = TONECURVE_GAMMA;
+    else if (strcmp(name, "equalize") == 0) *kind = TONECURVE_EQUALIZE;
+    else return -1;
+    return 0;
+}
+
+int tonecurve_entries(float max) {
+    struct tonecurve unbounded = { 0x7fffffff, NULL };
+    int entries = tonecurve_index(&unbounded, max) + 1;
+    return entries > 2 ? entries : 2;
+}
+
+void tonecurve_count(const float* values, size_t n, int stride, int entries, size_t* buckets) {
+    struct tonecurve bounded = { entries, NULL };
+    memset(buckets, 0, entries * sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        buckets[tonecurve_index(&bounded, values[i * stride])]++;
+    }
+}
+
+/**
+ * Returns the smallest value that falls in a table entry.
+ * @param idx The table entry, from 1
+ */
+static float entry_value(int idx) {
+    union { int32_t i; float f; } bits = { (int32_t)(idx + TONECURVE_BASE) << TONECURVE_SHIFT };
+    return bits.f;
+}
+
+int tonecurve_init(struct tonecurve* tc, enum tonecurve_kind kind, double gamma,
+                   float max, int entries, const size_t* buckets) {
+    tc->entries = entries;
+    tc->lut = malloc(entries);
+    if (!tc->lut) return -1;
+
+    size_t total = 0, below = 0;
+    if (kind == TONECURVE_EQUALIZE) {
+        for (int i = 1; i < entries; i++) total += buckets[i];
+    }
+
+    tc->lut[0] = 0;
+    for (int i = 1; i < entries; i++) {
+        float v = entry_value(i);
+        if (kind == TONECURVE_LEGACY) {
+            // Exactly the arithmetic of the original compute_colors
+            float value = 0;
+            double scale = custom_log((int)max);
+            if (scale > 0) {
+                value = custom_log((int)v) / scale;
+                value = custom_pow(value, 1.0 / gamma);
+            }
+            tc->lut[i] = (unsigned char)(value * 255);
+            continue;
+        }
+
+        double value;
+        if (kind == TONECURVE_LOG) {
+            value = log1p(v) / log1p(max);
+        } else if (kind == TONECURVE_GAMMA) {
+            value = v / max;
+        } else {
+            below += buckets[i];
+            value = total > 0 ? (double)below / total : 0;
+        }
+        value = pow(value, 1.0 / gamma) * 255 + 0.5;
+        tc->lut[i] = value >= 255 ? 255 : (unsigned char)value;
+    }
+    return 0;
+}
+
+void tonecurve_free(struct tonecurve* tc) {
+    free(tc->lut);
+    tc->lut = NULL;
+}
+
+/**
+ * Computes the table indices of n consecutive values.
+ * @param values The values
+ * @param n The number of values
+ * @param entries The number of table entries
+ * @param indices Returns the index of every value
+ */
+static void compute_indices(const float* values, size_t n, int entries, int* indices) {
+    struct tonecurve bounded = { entries, NULL };
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i base = _mm_set1_epi32(TONECURVE_BASE);
+    __m128i top = _mm_set1_epi32(entries - 1);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i bits = _mm_castps_si128(_mm_loadu_ps(values + i));
+        __m128i idx = _mm_sub_epi32(_mm_srai_epi32(bits, TONECURVE_SHIFT), base);
+        idx = _mm_and_si128(idx, _mm_cmpgt_epi32(idx, zero));
+        __m128i over = _mm_cmpgt_epi32(idx, top);
+        idx = _mm_or_si128(_mm_andnot_si128(over, idx), _mm_and_si128(over, top));
+        _mm_storeu_si128((__m128i*)(indices + i), idx);
+    }
+#endif
+    for (; i < n; i++) {
+        indices[i] = tonecurve_index(&bounded, values[i]);
+    }
+}
+
+void tonecurve_apply(const struct tonecurve* curves, int channels,
+                     const float* values, size_t pixels, unsigned char* rgb) {
+    int indices[BLOCK];
+    size_t n = pixels * channels;
+
+    // Blocks are a multiple of 3 values, so each starts on a pixel
+    for (size_t start = 0; start < n; start += BLOCK - BLOCK % 3) {
+        size_t count = n - start < BLOCK - BLOCK % 3 ? n - start : BLOCK - BLOCK % 3;
+        compute_indices(values + start, count, curves[0].entries, indices);
+        if (channels == 1) {
+            const unsigned char* lut = curves[0].lut;
+            unsigned char* out = rgb + 3 * start;
+            for (size_t i = 0; i < count; i++) {
+                out[3 * i] = out[3 * i + 1] = out[3 * i + 2] = lut[indices[i]];
+            }
+        } else {
+            const unsigned char *red = curves[0].lut, *green = curves[1].lut, *blue = curves[2].lut;
+            unsigned char* out = rgb + start;
+            for (size_t i = 0; i < count; i += 3) {
+                out[i] = red[indices[i]];
+                out[i + 1] = green[indices[i + 1]];
+                out[i + 2] = blue[indices[i + 2]];
+            }
+        }
+    }
+}
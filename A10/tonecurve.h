@@ -0,0 +1,75 @@
+#ifndef tonecurve_H_
+#define tonecurve_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tone curves map histogram counts to 8-bit values through a lookup table.
+// The table is indexed by the top bits of a value's float representation:
+// its exponent and the first TONECURVE_BITS bits of its mantissa. Entries
+// are therefore spaced logarithmically, 0.1% apart, which follows a log
+// curve closely at every scale; every count below 2^11 has its own entry
+// and entry 0 holds all values below 1.
+#define TONECURVE_BITS 10
+#define TONECURVE_SHIFT (23 - TONECURVE_BITS)
+#define TONECURVE_BASE ((0x3F800000 >> TONECURVE_SHIFT) - 1)
+
+enum tonecurve_kind {
+  TONECURVE_LEGACY,    // buddhabrot's original 8-bit mapping
+  TONECURVE_LOG,       // log(1 + v) / log(1 + max)
+  TONECURVE_GAMMA,     // v / max
+  TONECURVE_EQUALIZE   // share of the non-zero values at or below v
+};
+
+struct tonecurve {
+  int entries;
+  unsigned char* lut;
+};
+
+// the table entry for a float value
+static inline int tonecurve_index(const struct tonecurve* tc, float value) {
+  union { float f; int32_t i; } bits = { value };
+  int idx = (bits.i >> TONECURVE_SHIFT) - TONECURVE_BASE;
+  if (idx < 0) idx = 0;
+  if (idx >= tc->entries) idx = tc->entries - 1;
+  return idx;
+}
+
+// the table entry for an integer count; unlike converting the count to a
+// float first, this never rounds a large count up into the next entry
+static inline int tonecurve_index_count(const struct tonecurve* tc, int count) {
+  if (count <= 0) return 0;
+  int e = 31 - __builtin_clz(count);
+  int mantissa = e > TONECURVE_BITS ? count >> (e - TONECURVE_BITS) : count << (TONECURVE_BITS - e);
+  int idx = (e << TONECURVE_BITS) + (mantissa & ((1 << TONECURVE_BITS) - 1)) + 1;
+  return idx < tc->entries ? idx : tc->entries - 1;
+}
+
+// look up a curve by name: legacy, log, gamma or equalize
+// returns 0 on success, or -1 if the name is unknown
+extern int tonecurve_parse(const char* name, enum tonecurve_kind* kind);
+
+// the number of table entries needed for values up to max
+extern int tonecurve_entries(float max);
+
+// count how many of n values (stride floats apart) fall in each of entries
+// table entries, as needed by TONECURVE_EQUALIZE
+extern void tonecurve_count(const float* values, size_t n, int stride, int entries, size_t* buckets);
+
+// build the table of a curve for values up to max, followed by the gamma
+// correction v^(1 / gamma); buckets are the counts from tonecurve_count for
+// TONECURVE_EQUALIZE and may be NULL otherwise
+// returns 0 on success, or -1 if memory allocation fails
+extern int tonecurve_init(struct tonecurve* tc, enum tonecurve_kind kind, double gamma,
+                          float max, int entries, const size_t* buckets);
+
+// free the table of a curve
+extern void tonecurve_free(struct tonecurve* tc);
+
+// map pixels of 1 or 3 interleaved channels to RGB bytes, channel c
+// through curves[c] (a single channel is replicated to grey); every curve
+// must have the same number of entries
+extern void tonecurve_apply(const struct tonecurve* curves, int channels,
+                            const float* values, size_t pixels, unsigned char* rgb);
+
+#endif
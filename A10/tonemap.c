@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "read_ppm.h"
+#include "write_ppm.h"
+#include "pfm.h"
+#include "tonecurve.h"
+
+/**
+ * Buddhabrot Tone Mapper
+ *
+ * Re-grades a raw histogram saved by buddhabrot -H without rendering it
+ * again. Each channel of the PFM gets its own lookup table for the chosen
+ * curve, built from that channel's maximum (and, for equalize, its
+ * distribution of counts), and the image is then mapped through the
+ * tables.
+ *
+ * Curves (-c):
+ *   log       log(1 + v) / log(1 + max), the default
+ *   gamma     v / max
+ *   equalize  share of the non-zero pixels with a count up to v
+ *   legacy    the mapping buddhabrot uses for its own 8-bit output
+ * Every curve is followed by the gamma correction v^(1 / gamma) (-g); the
+ * default gamma is 2.2 for the gamma curve, 0.681 for legacy and 1 for
+ * the others.
+ *
+ * Usage: ./tonemap -c <curve> -g <gamma> -o <output.ppm> -f ppm|qoi <input.pfm>
+ *
+ * Output: The image is written to the -o file, or by default to the input
+ *         name with its extension replaced by .ppm (or .qoi with -f qoi).
+ *
+ * @author: Tianyun Song
+ * @version: November 27, 2024
+ */
+
+/**
+ * Returns the seconds since an earlier time.
+ * @param start The earlier time
+ */
+double seconds_since(struct timeval start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* curveName = "log";
+    double gamma = 0;
+    const char* output = NULL;
+    const char* formatName = "ppm";
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":c:g:o:f:")) != -1) {
+        switch (opt) {
+        case 'c': curveName = optarg; break;
+        case 'g': gamma = atof(optarg); break;
+        case 'o': output = optarg; break;
+        case 'f': formatName = optarg; break;
+        case '?': printf("usage: %s -c log|gamma|equalize|legacy -g <gamma> "
+            "-o <output.ppm> -f ppm|qoi <input.pfm>\n", argv[0]); break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s -c log|gamma|equalize|legacy -g <gamma> "
+                "-o <output.ppm> -f ppm|qoi <input.pfm>\n", argv[0]);
+        return 1;
+    }
+    const char* input = argv[optind];
+
+    enum tonecurve_kind kind;
+    if (tonecurve_parse(curveName, &kind) != 0) {
+        fprintf(stderr, "Unknown curve %s\n", curveName);
+        return 1;
+    }
+    enum image_format format;
+    if (image_format_parse(formatName, &format) != 0) {
+        fprintf(stderr, "Unknown output format %s\n", formatName);
+        return 1;
+    }
+    if (gamma <= 0) {
+        gamma = kind == TONECURVE_GAMMA ? 2.2 : kind == TONECURVE_LEGACY ? 0.681 : 1.0;
+    }
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    int w, h, channels;
+    float* values = read_pfm(input, &w, &h, &channels);
+    if (!values) return 1;
+    double readTime = seconds_since(start);
+
+    gettimeofday(&start, NULL);
+    size_t pixels = (size_t)w * h;
+    float max[3] = {0, 0, 0};
+    float top = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        for (int c = 0; c < channels; c++) {
+            float v = values[i * channels + c];
+            if (v > max[c]) max[c] = v;
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        if (max[c] > top) top = max[c];
+    }
+
+    // All channels share one table size so they can be mapped together
+    int entries = tonecurve_entries(top);
+    size_t* buckets = NULL;
+    struct tonecurve curves[3];
+    for (int c = 0; c < channels; c++) {
+        if (kind == TONECURVE_EQUALIZE) {
+            buckets = realloc(buckets, entries * sizeof(size_t));
+            tonecurve_count(values + c, pixels, channels, entries, buckets);
+        }
+        if (tonecurve_init(&curves[c], kind, gamma, max[c], entries, buckets) != 0) {
+            fprintf(stderr, "Failed to allocate memory for the curve\n");
+            return 1;
+        }
+    }
+    free(buckets);
+    double buildTime = seconds_since(start);
+
+    gettimeofday(&start, NULL);
+    struct ppm_pixel* image = malloc(pixels * sizeof(struct ppm_pixel));
+    if (!image) {
+        fprintf(stderr, "Failed to allocate memory for image\n");
+        return 1;
+    }
+    tonecurve_apply(curves, channels, values, pixels, (unsigned char*)image);
+    double mapTime = seconds_since(start);
+
+    // Use -o if given, else replace the extension of the input
+    char filename[1024];
+    if (output) {
+        snprintf(filename, sizeof(filename), "%s", output);
+    } else {
+        snprintf(filename, sizeof(filename), "%s", input);
+        char* dot = strrchr(filename, '.');
+        if (dot && !strchr(dot, '/')) *dot = '\0';
+        strncat(filename, ".", sizeof(filename) - strlen(filename) - 1);
+        strncat(filename, image_format_extension(format), sizeof(filename) - strlen(filename) - 1);
+    }
+    write_image(filename, image, w, h, format);
+
+    printf("Tone mapped %dx%d (%d channel%s) with %s, gamma %.3f\n",
+           w, h, channels, channels > 1 ? "s" : "", curveName, gamma);
+    printf("  Read %.6f s, table of %d entries %.6f s, mapping %.6f s (%.1f Mpixels/s)\n",
+           readTime, entries, buildTime, mapTime, pixels / mapTime / 1e6);
+    printf("Writing file: %s\n", filename);
+
+    for (int c = 0; c < channels; c++) {
+        tonecurve_free(&curves[c]);
+    }
+    free(values);
+    free(image);
+    return 0;
+}
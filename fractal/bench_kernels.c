@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "escape.h"
+
+/**
+ * Escape-Time Kernel Microbenchmark
+ *
+ * Checks every kernel variant against a plain C reference and then times
+ * it over a fixed grid, reporting pixels and iterations per second.
+ *
+ * Usage: ./bench_kernels [-s <size>] [-i <maxIterations>]
+ *
+ * @author: Tianyun Song
+ * @version: November 22, 2024
+ */
+
+static const char* KERNELS[] = {
+    "mandelbrot", "mandelbrot-d", "julia", "julia-d", "burningship",
+    "burningship-d", "multibrot3", "multibrot3-d", "multibrot4",
+    "multibrot4-d", "multibrot5", "multibrot5-d", "multibrot6", "multibrot6-d",
+    "multibrot7", "multibrot7-d", "multibrot8", "multibrot8-d"
+};
+#define NUM_KERNELS (int)(sizeof(KERNELS) / sizeof(KERNELS[0]))
+
+void check(int expr, const char* message) {
+    if (!expr) {
+        printf("%s: FAILED\n", message);
+        exit(1);
+    }
+    else {
+        printf("%s: PASSED\n", message);
+    }
+}
+
+/**
+ * Straightforward double precision implementation of every formula, used
+ * as the reference for the specialized kernels.
+ */
+int reference_escape(const struct escape_kernel* k, double px, double py) {
+    double x = 0, y = 0, cx = px, cy = py;
+    if (k->formula == ESCAPE_JULIA) {
+        x = px; y = py; cx = k->jx; cy = k->jy;
+    }
+    int iter = 0;
+    while (iter < k->maxIterations && x * x + y * y < 4) {
+        if (k->formula == ESCAPE_BURNING_SHIP) {
+            x = x < 0 ? -x : x;
+            y = y < 0 ? -y : y;
+        }
+        int power = k->formula == ESCAPE_MULTIBROT ? k->power : 2;
+        double zx = x, zy = y;
+        for (int i = 1; i < power; i++) {
+            double t = zx * x - zy * y;
+            zy = zx * y + zy * x;
+            zx = t;
+        }
+        x = zx + cx;
+        y = zy + cy;
+        iter++;
+    }
+    return iter;
+}
+
+/**
+ * The float Mandelbrot loop as written in the original renderers; the
+ * float kernel must reproduce it exactly.
+ */
+int legacy_escape(float x0, float y0, int maxIterations) {
+    float x = 0, y = 0;
+    int iter = 0;
+    while (iter < maxIterations && x * x + y * y < 4) {
+        float xtemp = x * x - y * y + x0;
+        y = 2 * x * y + y0;
+        x = xtemp;
+        iter++;
+    }
+    return iter;
+}
+
+double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char* argv[]) {
+    int size = 512;
+    int maxIterations = 1000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":s:i:")) != -1) {
+        switch (opt) {
+        case 's': size = atoi(optarg); break;
+        case 'i': maxIterations = atoi(optarg); break;
+        case '?': printf("usage: %s -s <size> -i <maxIterations>\n", argv[0]); break;
+        }
+    }
+
+    double* xs = malloc(size * sizeof(double));
+    int* iters = malloc(size * size * sizeof(int));
+    float* orbit = malloc(2 * maxIterations * sizeof(float));
+    for (int col = 0; col < size; col++) {
+        xs[col] = (float)(-2.0f + (float)col / size * 4.0f);
+    }
+
+    printf("Running kernel checks (%dx%d, %d iterations)...\n", size, size, maxIterations);
+    struct escape_kernel k;
+    char name[32], message[128];
+    k.maxIterations = maxIterations;
+
+    // The float Mandelbrot kernel must match the original renderers exactly
+    escape_kernel_parse("mandelbrot", &k);
+    int exact = 1;
+    for (int row = 0; row < size && exact; row += 7) {
+        float y0 = -2.0f + (float)row / size * 4.0f;
+        escape_row(&k, xs, y0, size, iters);
+        for (int col = 0; col < size; col++) {
+            if (iters[col] != legacy_escape((float)xs[col], y0, maxIterations)) exact = 0;
+        }
+    }
+    check(exact, "mandelbrot matches the original float loop");
+
+    for (int i = 0; i < NUM_KERNELS; i++) {
+        check(escape_kernel_parse(KERNELS[i], &k) == 0, "kernel name parses");
+        k.maxIterations = maxIterations;
+        escape_kernel_name(&k, name, sizeof(name));
+        snprintf(message, sizeof(message), "%s round-trips its name", KERNELS[i]);
+        check(strcmp(name, KERNELS[i]) == 0, message);
+
+        // Orbit recording must not change the escape count, and the
+        // recorded orbit must end where the escaping iteration ended
+        int same = 1, agree = 0, total = 0;
+        for (int row = 0; row < size; row += 16) {
+            double y0 = (float)(-2.0f + (float)row / size * 4.0f);
+            escape_row(&k, xs, y0, size, iters);
+            for (int col = 0; col < size; col += 16) {
+                int n = escape_orbit(&k, xs[col], y0, orbit);
+                if (n != iters[col] || n != escape_point(&k, xs[col], y0)) same = 0;
+                if (n > 0 && n < maxIterations) {
+                    float x = orbit[2 * (n - 1)], y = orbit[2 * (n - 1) + 1];
+                    if (x * x + y * y < 4) same = 0;
+                }
+                // Reordered arithmetic may flip points right on the boundary
+                agree += abs(n - reference_escape(&k, xs[col], y0)) <= maxIterations / 100;
+                total++;
+            }
+        }
+        snprintf(message, sizeof(message), "%s row, point and orbit variants agree", KERNELS[i]);
+        check(same, message);
+        snprintf(message, sizeof(message), "%s matches the reference formula", KERNELS[i]);
+        check(agree >= total * 95 / 100, message);
+    }
+
+    printf("\n%-16s %12s %14s %14s\n", "kernel", "best (s)", "Mpixels/s", "Miterations/s");
+    for (int i = 0; i < NUM_KERNELS; i++) {
+        escape_kernel_parse(KERNELS[i], &k);
+        k.maxIterations = maxIterations;
+
+        double best = 0;
+        long total = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            double start = now();
+            for (int row = 0; row < size; row++) {
+                double y0 = -2.0 + (double)row / size * 4.0;
+                escape_row(&k, xs, y0, size, iters + row * size);
+            }
+            double elapsed = now() - start;
+            if (rep == 0 || elapsed < best) best = elapsed;
+        }
+        for (int p = 0; p < size * size; p++) total += iters[p];
+
+        printf("%-16s %12.6f %14.2f %14.2f\n", KERNELS[i], best,
+               (double)size * size / best / 1e6, total / best / 1e6);
+    }
+
+    free(xs);
+    free(iters);
+    free(orbit);
+    return 0;
+}
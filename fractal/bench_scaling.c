@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/**
+ * Fractal Scaling Benchmark
+ *
+ * Runs a renderer (thread_mandelbrot, single_mandelbrot, buddhabrot) over
+ * every combination of image size, iteration limit, thread count and
+ * kernel, with warmup runs and repetitions. Each run is a child process:
+ * wall time is measured around it, CPU time (user + system, summed over
+ * all threads) comes from wait4, and the compute time is parsed from the
+ * renderer's own "Computed ... in X seconds" line. Results are written as
+ * CSV or JSON, one record per repetition, for regression tracking. A run
+ * fails if the renderer exits non-zero or prints no compute time; failed
+ * runs are marked in the records, left out of the summary, and make the
+ * benchmark exit 1. A case whose warmup run fails is skipped.
+ *
+ * Variants (-v) compare settings of the renderer: a semicolon separated
+ * list of extra arguments, each run as its own case, e.g.
+ * -v ";-B 1048576" runs once without and once with -B 1048576. With -e,
+ * hardware counters (cycles, instructions, last-level cache misses and
+ * data TLB misses, user space only) are read for every run through
+ * perf_event_open; they are reported as -1 where the machine does not
+ * provide them.
+ *
+ * Usage: ./bench_scaling -x <program> [-s <sizes>] [-i <iterations>]
+ *                        [-p <threads>] [-k <kernels>] [-w <warmup>]
+ *                        [-n <repetitions>] [-f csv|json] [-o <file>]
+ *                        [-v <variants>] [-e]
+ *                        [-- <extra renderer arguments>]
+ *
+ * Lists are comma separated, e.g. -s 240,480,960. A thread count of 0
+ * leaves out -p, for single-threaded renderers.
+ *
+ * @author: Tianyun Song
+ * @version: November 24, 2024
+ */
+
+#define MAX_LIST 32
+#define MAX_ARGS 64
+#define NUM_EVENTS 4
+
+// The hardware counters read with -e
+static const struct {
+    const char *name;
+    unsigned int type;
+    unsigned long long config;
+} events[NUM_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+struct run_result {
+    double wall;     // seconds, whole process
+    double compute;  // seconds, as reported by the renderer, or -1
+    double cpu;      // seconds of user + system time over all threads
+    int status;      // exit status, or -1 if the renderer crashed
+    long long counts[NUM_EVENTS];  // hardware counters, or -1
+};
+
+/**
+ * Splits a list of numbers or names.
+ * @param list The list to split; modified in place
+ * @param items Returns pointers to each item
+ * @param separators The characters between items
+ * @return The number of items
+ */
+int split_list(char *list, char **items, const char *separators) {
+    int n = 0;
+    char *save;
+    for (char *tok = strtok_r(list, separators, &save); tok && n < MAX_LIST;
+         tok = strtok_r(NULL, separators, &save)) {
+        items[n++] = tok;
+    }
+    return n;
+}
+
+/**
+ * Opens a hardware counter for a process and the threads it creates. The
+ * counter starts when the process calls exec.
+ * @param pid The process to count
+ * @param event The index of the event in events
+ * @return The counter's file descriptor, or -1 if it is not available
+ */
+int open_counter(pid_t pid, int event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[event].type;
+    attr.config = events[event].config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Runs the renderer once and measures it.
+ * @param args NULL-terminated argument vector; args[0] is the program
+ * @param counters 1 to read the hardware counters
+ * @param result Returns the measurements
+ * @return 0 on success, -1 if the process could not be started
+ */
+int run_once(char **args, int counters, struct run_result *result) {
+    int fds[2], go[2];
+    if (pipe(fds) != 0 || pipe(go) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        // Wait until the counters are attached, then start the renderer
+        char ready;
+        close(go[1]);
+        read(go[0], &ready, 1);
+        close(go[0]);
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        execv(args[0], args);
+        perror(args[0]);
+        exit(127);
+    }
+    close(fds[1]);
+    close(go[0]);
+
+    int counterFds[NUM_EVENTS];
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        counterFds[e] = counters ? open_counter(pid, e) : -1;
+    }
+    close(go[1]);
+
+    // Keep the renderer's output to find its own timing line
+    char output[65536];
+    size_t len = 0;
+    ssize_t got;
+    char discard[4096];
+    while ((got = read(fds[0], len < sizeof(output) - 1 ? output + len : discard,
+                       len < sizeof(output) - 1 ? sizeof(output) - 1 - len : sizeof(discard))) > 0) {
+        if (len < sizeof(output) - 1) len += got;
+    }
+    output[len] = '\0';
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result->wall = now() - start;
+    result->cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                  usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        result->counts[e] = -1;
+        if (counterFds[e] >= 0) {
+            long long value;
+            if (read(counterFds[e], &value, sizeof(value)) == sizeof(value)) {
+                result->counts[e] = value;
+            }
+            close(counterFds[e]);
+        }
+    }
+
+    result->compute = -1;
+    char *line = strstr(output, "Computed");
+    if (line) {
+        char *in = strstr(line, " in ");
+        if (!in || sscanf(in, " in %lf seconds", &result->compute) != 1) {
+            result->compute = -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes a CSV field in double quotes, doubling any quotes inside it.
+ * @param out The file to write to
+ * @param text The field
+ */
+void put_csv(FILE *out, const char *text) {
+    putc('"', out);
+    for (; *text; text++) {
+        if (*text == '"') putc('"', out);
+        putc(*text, out);
+    }
+    putc('"', out);
+}
+
+/**
+ * Writes a JSON string, escaping quotes, backslashes and control characters.
+ * @param out The file to write to
+ * @param text The string
+ */
+void put_json(FILE *out, const char *text) {
+    putc('"', out);
+    for (; *text; text++) {
+        unsigned char c = *text;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            putc(c, out);
+        }
+    }
+    putc('"', out);
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    char *program = NULL;
+    char sizeList[256] = "240,480";
+    char iterList[256] = "1000";
+    char threadList[256] = "1,2,4";
+    char kernelList[256] = "mandelbrot";
+    int warmup = 1;
+    int reps = 3;
+    const char *format = "csv";
+    const char *outName = NULL;
+    char variantList[1024] = "";
+    int counters = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":x:s:i:p:k:w:n:f:o:v:e")) != -1) {
+        switch (opt) {
+        case 'x': program = optarg; break;
+        case 's': snprintf(sizeList, sizeof(sizeList), "%s", optarg); break;
+        case 'i': snprintf(iterList, sizeof(iterList), "%s", optarg); break;
+        case 'p': snprintf(threadList, sizeof(threadList), "%s", optarg); break;
+        case 'k': snprintf(kernelList, sizeof(kernelList), "%s", optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'n': reps = atoi(optarg); break;
+        case 'f': format = optarg; break;
+        case 'o': outName = optarg; break;
+        case 'v': snprintf(variantList, sizeof(variantList), "%s", optarg); break;
+        case 'e': counters = 1; break;
+        case '?': printf("usage: %s -x <program> -s <sizes> -i <iterations> "
+            "-p <threads> -k <kernels> -w <warmup> -n <repetitions> "
+            "-f csv|json -o <file> -v <variants> -e "
+            "[-- <extra arguments>]\n", argv[0]); break;
+        }
+    }
+    if (!program || reps < 1) {
+        fprintf(stderr, "A renderer must be given with -x\n");
+        return 1;
+    }
+    int json = strcmp(format, "json") == 0;
+
+    char *sizes[MAX_LIST], *iterations[MAX_LIST], *threads[MAX_LIST], *kernels[MAX_LIST];
+    int numSizes = split_list(sizeList, sizes, ",");
+    int numIters = split_list(iterList, iterations, ",");
+    int numThreads = split_list(threadList, threads, ",");
+    int numKernels = split_list(kernelList, kernels, ",");
+
+    // Keep each variant's name for the report and split it into arguments
+    char *variants[MAX_LIST], *variantArgs[MAX_LIST][MAX_ARGS];
+    int numVariants = 0, numVariantArgs[MAX_LIST];
+    char *rest = variantList;
+    do {
+        char *end = strchr(rest, ';');
+        if (end) *end = '\0';
+        variants[numVariants] = rest;
+        char *copy = strdup(rest);
+        numVariantArgs[numVariants] = 0;
+        char *save;
+        for (char *tok = strtok_r(copy, " ", &save); tok && numVariantArgs[numVariants] < MAX_ARGS;
+             tok = strtok_r(NULL, " ", &save)) {
+            variantArgs[numVariants][numVariantArgs[numVariants]++] = tok;
+        }
+        numVariants++;
+        rest = end ? end + 1 : NULL;
+    } while (rest && numVariants < MAX_LIST);
+
+    FILE *out = outName ? fopen(outName, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Unable to open file %s for writing\n", outName);
+        return 1;
+    }
+    if (json) {
+        fprintf(out, "{\n  \"program\": ");
+        put_json(out, program);
+        fprintf(out, ",\n  \"runs\": [");
+    } else {
+        fprintf(out, "program,kernel,size,iterations,threads,rep,wall_s,compute_s,"
+                     "cpu_s,pixels_per_s,status,failed,variant");
+        for (int e = 0; counters && e < NUM_EVENTS; e++) {
+            fprintf(out, ",%s", events[e].name);
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(stderr, "%-14s %6s %6s %4s %10s %10s %10s %14s", "kernel", "size",
+            "iters", "p", "wall (s)", "comp (s)", "cpu (s)", "pixels/s");
+    if (counters) fprintf(stderr, " %6s %14s %14s", "IPC", "LLC misses", "dTLB misses");
+    fprintf(stderr, "  variant\n");
+    int first = 1;
+    int warned = 0;
+    int anyFailed = 0;
+    double *walls = malloc(reps * sizeof(double));
+    for (int k = 0; k < numKernels; k++) {
+        for (int s = 0; s < numSizes; s++) {
+            for (int i = 0; i < numIters; i++) {
+                for (int t = 0; t < numThreads; t++) {
+                    for (int v = 0; v < numVariants; v++) {
+                        char *args[MAX_ARGS];
+                        int n = 0;
+                        args[n++] = program;
+                        args[n++] = "-s"; args[n++] = sizes[s];
+                        args[n++] = "-i"; args[n++] = iterations[i];
+                        args[n++] = "-k"; args[n++] = kernels[k];
+                        if (atoi(threads[t]) > 0) {
+                            args[n++] = "-p"; args[n++] = threads[t];
+                        }
+                        args[n++] = "-o"; args[n++] = "/dev/null";
+                        for (int a = 0; a < numVariantArgs[v] && n < MAX_ARGS - 1; a++) {
+                            args[n++] = variantArgs[v][a];
+                        }
+                        for (int e = optind; e < argc && n < MAX_ARGS - 1; e++) {
+                            args[n++] = argv[e];
+                        }
+                        args[n] = NULL;
+
+                        // A configuration that fails while warming up is not
+                        // worth timing
+                        struct run_result result;
+                        int warmupFailed = 0;
+                        for (int w = 0; w < warmup && !warmupFailed; w++) {
+                            if (run_once(args, counters, &result) != 0) return 1;
+                            warmupFailed = result.status != 0 || result.compute < 0;
+                        }
+                        if (warmupFailed) {
+                            fprintf(stderr, "%-14s %6s %6s %4s  warmup FAILED (status %d), "
+                                    "skipped  %s\n", kernels[k], sizes[s], iterations[i],
+                                    threads[t], result.status, variants[v]);
+                            anyFailed = 1;
+                            continue;
+                        }
+
+                        // Failed runs are recorded but left out of the summary,
+                        // or a renderer that exits at once would look fastest
+                        double compute = 0, cpu = 0;
+                        double totals[NUM_EVENTS] = {0};
+                        int passed = 0;
+                        for (int r = 0; r < reps; r++) {
+                            if (run_once(args, counters, &result) != 0) return 1;
+                            int failed = result.status != 0 || result.compute < 0;
+                            double pixels = (double)atoi(sizes[s]) * atoi(sizes[s]);
+                            double rate = failed ? -1 : pixels / (result.compute > 0 ? result.compute : result.wall);
+                            if (!failed) {
+                                walls[passed++] = result.wall;
+                                compute += result.compute;
+                                cpu += result.cpu;
+                                for (int e = 0; e < NUM_EVENTS; e++) {
+                                    totals[e] += result.counts[e];
+                                }
+                            }
+                            if (counters && result.counts[0] < 0 && !warned) {
+                                fprintf(stderr, "Hardware counters are not available here; "
+                                        "they are reported as -1\n");
+                                warned = 1;
+                            }
+
+                            if (json) {
+                                fprintf(out, "%s\n    {\"kernel\": ", first ? "" : ",");
+                                put_json(out, kernels[k]);
+                                fprintf(out, ", \"size\": %d, "
+                                    "\"iterations\": %d, \"threads\": %d, \"rep\": %d, "
+                                    "\"wall_s\": %.6f, \"compute_s\": %.6f, \"cpu_s\": %.6f, "
+                                    "\"pixels_per_s\": %.1f, \"status\": %d, \"failed\": %s, "
+                                    "\"variant\": ",
+                                    atoi(sizes[s]), atoi(iterations[i]), atoi(threads[t]), r,
+                                    result.wall, result.compute, result.cpu,
+                                    rate, result.status, failed ? "true" : "false");
+                                put_json(out, variants[v]);
+                                for (int e = 0; counters && e < NUM_EVENTS; e++) {
+                                    fprintf(out, ", \"%s\": %lld", events[e].name, result.counts[e]);
+                                }
+                                fprintf(out, "}");
+                            } else {
+                                put_csv(out, program);
+                                putc(',', out);
+                                put_csv(out, kernels[k]);
+                                fprintf(out, ",%d,%d,%d,%d,%.6f,%.6f,%.6f,%.1f,%d,%d,",
+                                    atoi(sizes[s]), atoi(iterations[i]), atoi(threads[t]),
+                                    r, result.wall, result.compute, result.cpu, rate,
+                                    result.status, failed);
+                                put_csv(out, variants[v]);
+                                for (int e = 0; counters && e < NUM_EVENTS; e++) {
+                                    fprintf(out, ",%lld", result.counts[e]);
+                                }
+                                fprintf(out, "\n");
+                            }
+                            first = 0;
+                        }
+                        fflush(out);
+
+                        // Human readable summary of the runs that passed: median
+                        // wall time, mean of the rest
+                        if (passed < reps) anyFailed = 1;
+                        if (passed == 0) {
+                            fprintf(stderr, "%-14s %6s %6s %4s  all %d runs FAILED  %s\n",
+                                    kernels[k], sizes[s], iterations[i], threads[t], reps,
+                                    variants[v]);
+                            continue;
+                        }
+                        qsort(walls, passed, sizeof(double), compare_doubles);
+                        double median = walls[passed / 2];
+                        fprintf(stderr, "%-14s %6s %6s %4s %10.4f %10.4f %10.4f %14.1f",
+                                kernels[k], sizes[s], iterations[i], threads[t], median,
+                                compute / passed, cpu / passed,
+                                (double)atoi(sizes[s]) * atoi(sizes[s]) /
+                                (compute > 0 ? compute / passed : median));
+                        if (counters) {
+                            fprintf(stderr, " %6.2f %14.0f %14.0f",
+                                    totals[0] > 0 ? totals[1] / totals[0] : -1.0,
+                                    totals[2] / passed, totals[3] / passed);
+                        }
+                        fprintf(stderr, "  %s", variants[v]);
+                        if (passed < reps) {
+                            fprintf(stderr, " (%d of %d runs FAILED)", reps - passed, reps);
+                        }
+                        fprintf(stderr, "\n");
+                    }
+                }
+            }
+        }
+    }
+    if (json) {
+        fprintf(out, "\n  ]\n}\n");
+    }
+
+    free(walls);
+    if (out != stdout) fclose(out);
+    if (anyFailed) {
+        fprintf(stderr, "Some runs failed: see the status column and the summary\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include "escape.h"
+#include "escape_kernels.h"
+
+/**
+ * Escape-Time Kernel Library
+ *
+ * Exposes the templates in escape_kernels.h to C programs. Every
+ * (formula, float type, record) combination is instantiated here; the
+ * public functions only pick the instantiation once per call, so the
+ * per-iteration loop never branches on the fractal family.
+ *
+ * @author: Tianyun Song
+ * @version: November 22, 2024
+ */
+
+namespace
+{
+
+// Calls op.run<Formula, Real>() for the formula selected by k
+template <typename Real, typename Op>
+int dispatch(const escape_kernel* k, Op& op)
+{
+  switch (k->formula)
+  {
+    case ESCAPE_JULIA: return op.template run<escape::Julia, Real>();
+    case ESCAPE_BURNING_SHIP: return op.template run<escape::BurningShip, Real>();
+    case ESCAPE_MULTIBROT:
+      switch (k->power)
+      {
+        case 3: return op.template run<escape::MultibrotOf<3>::type, Real>();
+        case 4: return op.template run<escape::MultibrotOf<4>::type, Real>();
+        case 5: return op.template run<escape::MultibrotOf<5>::type, Real>();
+        case 6: return op.template run<escape::MultibrotOf<6>::type, Real>();
+        case 7: return op.template run<escape::MultibrotOf<7>::type, Real>();
+        case 8: return op.template run<escape::MultibrotOf<8>::type, Real>();
+      }
+      break;
+    default: break;
+  }
+  return op.template run<escape::Mandelbrot, Real>();
+}
+
+template <typename Op>
+int dispatch(const escape_kernel* k, Op& op)
+{
+  if (k->precision == 64) return dispatch<double>(k, op);
+  return dispatch<float>(k, op);
+}
+
+struct RowOp
+{
+  const escape_kernel* k;
+  const double* xs;
+  double y;
+  int n;
+  int* iters;
+
+  template <template <typename> class Formula, typename Real>
+  int run()
+  {
+    escape::row<Formula, Real>(xs, y, n, (Real) k->jx, (Real) k->jy,
+        k->maxIterations, iters);
+    return 0;
+  }
+};
+
+template <bool Record>
+struct PointOp
+{
+  const escape_kernel* k;
+  double x, y;
+  float* orbit;
+
+  template <template <typename> class Formula, typename Real>
+  int run()
+  {
+    return escape::iterate<Formula, Real, Record>((Real) x, (Real) y,
+        (Real) k->jx, (Real) k->jy, k->maxIterations, orbit);
+  }
+};
+
+}
+
+extern "C" int escape_kernel_parse(const char* name, struct escape_kernel* k)
+{
+  char base[32];
+  int len = (int) strlen(name);
+  int precision = 32;
+  if (len > 2 && strcmp(name + len - 2, "-d") == 0)
+  {
+    precision = 64;
+    len -= 2;
+  }
+  if (len <= 0 || len >= (int) sizeof(base)) return -1;
+  memcpy(base, name, len);
+  base[len] = '\0';
+
+  int power = 2;
+  enum escape_formula formula;
+  if (strcmp(base, "mandelbrot") == 0) formula = ESCAPE_MANDELBROT;
+  else if (strcmp(base, "julia") == 0) formula = ESCAPE_JULIA;
+  else if (strcmp(base, "burningship") == 0) formula = ESCAPE_BURNING_SHIP;
+  else if (strncmp(base, "multibrot", 9) == 0 && base[9] >= '3' &&
+      base[9] <= '8' && base[10] == '\0')
+  {
+    formula = ESCAPE_MULTIBROT;
+    power = base[9] - '0';
+  }
+  else return -1;
+
+  k->formula = formula;
+  k->power = power;
+  k->precision = precision;
+  k->jx = -0.8;
+  k->jy = 0.156;
+  return 0;
+}
+
+extern "C" const char* escape_kernel_name(const struct escape_kernel* k,
+    char* buf, int len)
+{
+  const char* suffix = k->precision == 64 ? "-d" : "";
+  switch (k->formula)
+  {
+    case ESCAPE_JULIA: snprintf(buf, len, "julia%s", suffix); break;
+    case ESCAPE_BURNING_SHIP: snprintf(buf, len, "burningship%s", suffix); break;
+    case ESCAPE_MULTIBROT: snprintf(buf, len, "multibrot%d%s", k->power, suffix); break;
+    default: snprintf(buf, len, "mandelbrot%s", suffix); break;
+  }
+  return buf;
+}
+
+extern "C" void escape_row(const struct escape_kernel* k, const double* xs,
+    double y, int n, int* iters)
+{
+  RowOp op = { k, xs, y, n, iters };
+  dispatch(k, op);
+}
+
+extern "C" int escape_point(const struct escape_kernel* k, double x, double y)
+{
+  PointOp<false> op = { k, x, y, nullptr };
+  return dispatch(k, op);
+}
+
+extern "C" int escape_orbit(const struct escape_kernel* k, double x, double y,
+    float* orbit)
+{
+  PointOp<true> op = { k, x, y, orbit };
+  return dispatch(k, op);
+}
+
+extern "C" int escape_mirror_axis(const struct escape_kernel* k, double ymin,
+    double ymax, int size)
+{
+  // z -> conj(z) maps the orbit of c to the orbit of conj(c) for these
+  // formulas; the burning ship folds |Im z| and has no such symmetry
+  bool symmetric = k->formula == ESCAPE_MANDELBROT ||
+      k->formula == ESCAPE_MULTIBROT ||
+      (k->formula == ESCAPE_JULIA && k->jy == 0);
+  if (!symmetric || ymax <= ymin || size < 2) return -1;
+
+  // y = 0 must fall on a row or halfway between two
+  double axis2 = -2 * ymin * size / (ymax - ymin);
+  long rounded = (long) (axis2 + (axis2 >= 0 ? 0.5 : -0.5));
+  if (axis2 - rounded > 1e-3 || rounded - axis2 > 1e-3) return -1;
+  if (rounded < 1 || rounded > 2L * size - 3) return -1;
+  return (int) rounded;
+}
@@ -0,0 +1,75 @@
+#ifndef escape_H_
+#define escape_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The iteration formulas understood by the escape-time kernels
+enum escape_formula {
+  ESCAPE_MANDELBROT,    // z = z^2 + c, z0 = 0
+  ESCAPE_JULIA,         // z = z^2 + k, z0 = c, for a fixed constant k
+  ESCAPE_BURNING_SHIP,  // z = (|Re z| + i|Im z|)^2 + c, z0 = 0
+  ESCAPE_MULTIBROT      // z = z^power + c, z0 = 0
+};
+
+// Selects one compile-time specialized kernel plus its runtime parameters
+struct escape_kernel {
+  enum escape_formula formula;
+  int power;            // multibrot exponent, 3 to 8
+  int precision;        // 32 iterates in float, 64 in double
+  double jx, jy;        // julia constant k
+  int maxIterations;
+};
+
+// fill in a kernel from a name such as "mandelbrot", "julia", "burningship"
+// or "multibrot3"; append "-d" (e.g. "mandelbrot-d") to iterate in double
+// name: the kernel name
+// k: the kernel to fill in; maxIterations is left untouched
+// returns 0 on success, or -1 if the name is not recognized
+extern int escape_kernel_parse(const char* name, struct escape_kernel* k);
+
+// write the canonical name of a kernel (the inverse of escape_kernel_parse)
+// returns buf
+extern const char* escape_kernel_name(const struct escape_kernel* k, char* buf, int len);
+
+// compute escape counts for one row of points
+// xs: the real coordinate of each point
+// y: the imaginary coordinate shared by the row
+// n: the number of points
+// iters: returns the iterations before escape, or maxIterations if the
+//   point did not escape
+extern void escape_row(const struct escape_kernel* k, const double* xs,
+    double y, int n, int* iters);
+
+// compute the escape count of a single point
+extern int escape_point(const struct escape_kernel* k, double x, double y);
+
+// iterate a single point, recording every z visited
+// orbit: room for 2 * maxIterations floats; returns z1..zn as (x, y) pairs
+// returns the number of iterations n, which equals maxIterations if the
+//   point did not escape
+extern int escape_orbit(const struct escape_kernel* k, double x, double y,
+    float* orbit);
+
+// find the rows of a view that mirror each other about the real axis, for
+// kernels whose images are symmetric about it (mandelbrot, multibrot, and
+// julia with a real constant)
+// ymin, ymax: the view, where row r lies at y = ymin + r * (ymax - ymin) / size
+// size: the number of rows
+// returns axis2, the sum of any two mirrored rows (twice the row of y = 0),
+//   or -1 if the kernel is not symmetric or no two rows mirror each other
+extern int escape_mirror_axis(const struct escape_kernel* k, double ymin,
+    double ymax, int size);
+
+// 1 if row is the mirror of the earlier row axis2 - row, so that it can be
+// copied from that row rather than computed
+static inline int escape_mirrored_row(int axis2, int row) {
+  return axis2 >= 0 && 2 * row > axis2 && row <= axis2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
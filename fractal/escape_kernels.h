@@ -0,0 +1,135 @@
+#ifndef escape_kernels_H_
+#define escape_kernels_H_
+
+// Escape-time kernels specialized at compile time on the iteration formula,
+// the floating point type and whether the orbit is recorded. Each
+// combination becomes its own loop with the formula inlined, so there are
+// no runtime branches on the fractal family inside the iteration.
+
+namespace escape
+{
+
+// z^N for a complex z = (x, y), expanded by the compiler into N - 1
+// complex multiplications
+template <int N, typename Real>
+struct Power
+{
+  static inline void apply(Real& x, Real& y)
+  {
+    Real px = x;
+    Real py = y;
+    Power<N - 1, Real>::apply(px, py);
+    Real t = px * x - py * y;
+    y = px * y + py * x;
+    x = t;
+  }
+};
+
+template <typename Real>
+struct Power<1, Real>
+{
+  static inline void apply(Real&, Real&) {}
+};
+
+template <typename Real>
+struct Mandelbrot
+{
+  static const bool julia = false;
+  static inline void step(Real& x, Real& y, Real cx, Real cy)
+  {
+    Real xtemp = x * x - y * y + cx;
+    y = 2 * x * y + cy;
+    x = xtemp;
+  }
+};
+
+template <typename Real>
+struct Julia
+{
+  static const bool julia = true;
+  static inline void step(Real& x, Real& y, Real cx, Real cy)
+  {
+    Mandelbrot<Real>::step(x, y, cx, cy);
+  }
+};
+
+template <typename Real>
+struct BurningShip
+{
+  static const bool julia = false;
+  static inline void step(Real& x, Real& y, Real cx, Real cy)
+  {
+    Real ax = x < 0 ? -x : x;
+    Real ay = y < 0 ? -y : y;
+    Real xtemp = ax * ax - ay * ay + cx;
+    y = 2 * ax * ay + cy;
+    x = xtemp;
+  }
+};
+
+template <int N, typename Real>
+struct Multibrot
+{
+  static const bool julia = false;
+  static inline void step(Real& x, Real& y, Real cx, Real cy)
+  {
+    Power<N, Real>::apply(x, y);
+    x += cx;
+    y += cy;
+  }
+};
+
+// Iterates one point until |z| >= 2 or maxIterations is reached. When
+// Record is true, z1..zn are stored in orbit as (x, y) pairs.
+template <template <typename> class Formula, typename Real, bool Record>
+inline int iterate(Real px, Real py, Real jx, Real jy, int maxIterations,
+    float* orbit)
+{
+  Real x, y, cx, cy;
+  if (Formula<Real>::julia)
+  {
+    x = px; y = py; cx = jx; cy = jy;
+  }
+  else
+  {
+    x = 0; y = 0; cx = px; cy = py;
+  }
+
+  int iter = 0;
+  while (iter < maxIterations && x * x + y * y < 4)
+  {
+    Formula<Real>::step(x, y, cx, cy);
+    if (Record)
+    {
+      orbit[2 * iter] = (float) x;
+      orbit[2 * iter + 1] = (float) y;
+    }
+    iter++;
+  }
+  return iter;
+}
+
+// Escape counts for a row of points sharing the imaginary coordinate y
+template <template <typename> class Formula, typename Real>
+void row(const double* xs, double y, int n, Real jx, Real jy,
+    int maxIterations, int* iters)
+{
+  Real py = (Real) y;
+  for (int i = 0; i < n; i++)
+  {
+    iters[i] = iterate<Formula, Real, false>((Real) xs[i], py, jx, jy,
+        maxIterations, nullptr);
+  }
+}
+
+// Binds the exponent so that Multibrot fits the one-parameter Formula slot
+template <int N>
+struct MultibrotOf
+{
+  template <typename Real>
+  using type = Multibrot<N, Real>;
+};
+
+}
+
+#endif
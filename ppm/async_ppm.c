@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "async_ppm.h"
+#include "write_ppm.h"
+
+/**
+ * Background Image I/O
+ *
+ * Overlaps reading, processing and writing in batch jobs: a loader thread
+ * reads the next images while the caller works on the current one, and a
+ * saver thread writes finished images while the caller moves on. Each side
+ * holds a bounded ring of images, so memory stays at a few images however
+ * long the batch is. Plain threads with blocking I/O are used, which needs
+ * nothing beyond pthreads and overlaps just as well for whole-image reads.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+/**
+ * Frees or unmaps the pixels of an image.
+ * @param image The image to release
+ */
+void ppm_async_release(struct ppm_async_image* image) {
+    if (image->map.base) {
+        unmap_ppm(&image->map);
+    } else {
+        free(image->pixels);
+    }
+    image->pixels = NULL;
+}
+
+/**
+ * Loads one image. Mapped images have every page faulted in here, so the
+ * disk reads happen on the loader thread rather than when the caller first
+ * touches the pixels.
+ * @param filename The image to load
+ * @param mapped 1 to map the file copy-on-write, 0 to read it
+ * @param image Returns the image; its pixels are NULL if loading failed
+ */
+static void load_image(const char* filename, int mapped, struct ppm_async_image* image) {
+    image->map.base = NULL;
+    if (!mapped) {
+        image->pixels = read_ppm(filename, &image->width, &image->height);
+        return;
+    }
+
+    image->pixels = map_ppm_private(filename, &image->width, &image->height, &image->map);
+    if (!image->pixels) return;
+    madvise(image->map.base, image->map.length, MADV_WILLNEED);
+    long page = sysconf(_SC_PAGESIZE);
+    const volatile unsigned char* bytes = image->map.base;
+    unsigned char sum = 0;
+    for (size_t i = 0; i < image->map.length; i += page) {
+        sum += bytes[i];
+    }
+}
+
+/**
+ * The loader thread: loads every image in order, waiting whenever depth
+ * loaded images have not yet been taken.
+ * @param arg The loader
+ */
+static void* load_images(void* arg) {
+    struct ppm_loader* loader = arg;
+    for (int i = 0; i < loader->count; i++) {
+        pthread_mutex_lock(&loader->mutex);
+        while (!loader->stop && loader->loaded - loader->taken >= loader->depth) {
+            pthread_cond_wait(&loader->cond, &loader->mutex);
+        }
+        int stop = loader->stop;
+        pthread_mutex_unlock(&loader->mutex);
+        if (stop) break;
+
+        struct ppm_async_image image;
+        load_image(loader->filenames[i], loader->mapped, &image);
+
+        pthread_mutex_lock(&loader->mutex);
+        loader->slots[i % loader->depth] = image;
+        loader->loaded++;
+        pthread_cond_broadcast(&loader->cond);
+        pthread_mutex_unlock(&loader->mutex);
+    }
+    return NULL;
+}
+
+/**
+ * Starts loading a list of images in the background.
+ * @param loader The loader to start
+ * @param filenames The images to load, in order
+ * @param count The number of images
+ * @param depth The most images loaded ahead of the caller, at least 1
+ * @param mapped 1 to map the images copy-on-write, 0 to read them
+ * @return 0 on success, or -1 if the thread cannot be started
+ */
+int ppm_loader_open(struct ppm_loader* loader, char** filenames, int count, int depth, int mapped) {
+    loader->filenames = filenames;
+    loader->count = count;
+    loader->mapped = mapped;
+    loader->depth = depth > 0 ? depth : 1;
+    loader->loaded = 0;
+    loader->taken = 0;
+    loader->stop = 0;
+    loader->slots = malloc(loader->depth * sizeof(struct ppm_async_image));
+    if (!loader->slots) return -1;
+
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+    if (pthread_create(&loader->thread, NULL, load_images, loader) != 0) {
+        pthread_mutex_destroy(&loader->mutex);
+        pthread_cond_destroy(&loader->cond);
+        free(loader->slots);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Waits for the next image in order.
+ * @param loader The loader
+ * @param image Returns the image, now owned by the caller
+ * @return 1 with the next image, or 0 when every image has been handed out
+ */
+int ppm_loader_next(struct ppm_loader* loader, struct ppm_async_image* image) {
+    pthread_mutex_lock(&loader->mutex);
+    if (loader->taken == loader->count) {
+        pthread_mutex_unlock(&loader->mutex);
+        return 0;
+    }
+    while (loader->loaded == loader->taken) {
+        pthread_cond_wait(&loader->cond, &loader->mutex);
+    }
+    *image = loader->slots[loader->taken % loader->depth];
+    loader->taken++;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+    return 1;
+}
+
+/**
+ * Stops a loader, releasing any images it loaded that were not taken.
+ * @param loader The loader to close
+ */
+void ppm_loader_close(struct ppm_loader* loader) {
+    pthread_mutex_lock(&loader->mutex);
+    loader->stop = 1;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+    pthread_join(loader->thread, NULL);
+
+    for (int i = loader->taken; i < loader->loaded; i++) {
+        ppm_async_release(&loader->slots[i % loader->depth]);
+    }
+    pthread_mutex_destroy(&loader->mutex);
+    pthread_cond_destroy(&loader->cond);
+    free(loader->slots);
+    loader->slots = NULL;
+}
+
+/**
+ * Writes one image as P6.
+ * @param filename The file to write
+ * @param image The image
+ * @return 0 on success, or -1 if the file cannot be written
+ */
+static int save_image(const char* filename, const struct ppm_async_image* image) {
+    struct ppm_header header = ppm_rgb_header(image->width, image->height);
+    struct ppm_writer writer;
+    if (ppm_writer_open(&writer, filename, &header) != 0) return -1;
+
+    int status = ppm_write_rows(&writer, image->pixels, image->height);
+    if (ppm_writer_close(&writer) != 0 || status != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The saver thread: writes and releases queued images in order until the
+ * saver is closed and the queue is empty.
+ * @param arg The saver
+ */
+static void* save_images(void* arg) {
+    struct ppm_saver* saver = arg;
+    pthread_mutex_lock(&saver->mutex);
+    while (1) {
+        while (saver->saved == saver->submitted && !saver->closing) {
+            pthread_cond_wait(&saver->cond, &saver->mutex);
+        }
+        if (saver->saved == saver->submitted) break;
+
+        int slot = saver->saved % saver->depth;
+        struct ppm_async_image image = saver->slots[slot];
+        char* filename = saver->filenames[slot];
+        pthread_mutex_unlock(&saver->mutex);
+
+        int status = save_image(filename, &image);
+        ppm_async_release(&image);
+        free(filename);
+
+        pthread_mutex_lock(&saver->mutex);
+        saver->saved++;
+        if (status != 0) saver->failures++;
+        pthread_cond_broadcast(&saver->cond);
+    }
+    pthread_mutex_unlock(&saver->mutex);
+    return NULL;
+}
+
+/**
+ * Starts a background saver.
+ * @param saver The saver to start
+ * @param depth The most images waiting to be written, at least 1
+ * @return 0 on success, or -1 if the thread cannot be started
+ */
+int ppm_saver_open(struct ppm_saver* saver, int depth) {
+    saver->depth = depth > 0 ? depth : 1;
+    saver->submitted = 0;
+    saver->saved = 0;
+    saver->failures = 0;
+    saver->closing = 0;
+    saver->slots = malloc(saver->depth * sizeof(struct ppm_async_image));
+    saver->filenames = malloc(saver->depth * sizeof(char*));
+    if (!saver->slots || !saver->filenames) {
+        free(saver->slots);
+        free(saver->filenames);
+        return -1;
+    }
+
+    pthread_mutex_init(&saver->mutex, NULL);
+    pthread_cond_init(&saver->cond, NULL);
+    if (pthread_create(&saver->thread, NULL, save_images, saver) != 0) {
+        pthread_mutex_destroy(&saver->mutex);
+        pthread_cond_destroy(&saver->cond);
+        free(saver->slots);
+        free(saver->filenames);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Queues an image to be written and then released, waiting while the
+ * queue is full.
+ * @param saver The saver
+ * @param filename The file to write the image to
+ * @param image The image; the saver takes ownership of its pixels
+ * @return 0 on success, or -1 if the image has no pixels
+ */
+int ppm_saver_submit(struct ppm_saver* saver, const char* filename, struct ppm_async_image* image) {
+    if (!image->pixels) return -1;
+    char* name = strdup(filename);
+    if (!name) return -1;
+
+    pthread_mutex_lock(&saver->mutex);
+    while (saver->submitted - saver->saved >= saver->depth) {
+        pthread_cond_wait(&saver->cond, &saver->mutex);
+    }
+    saver->slots[saver->submitted % saver->depth] = *image;
+    saver->filenames[saver->submitted % saver->depth] = name;
+    saver->submitted++;
+    pthread_cond_broadcast(&saver->cond);
+    pthread_mutex_unlock(&saver->mutex);
+
+    image->pixels = NULL;
+    image->map.base = NULL;
+    return 0;
+}
+
+/**
+ * Writes every queued image and stops the saver.
+ * @param saver The saver to close
+ * @return The number of images that could not be written
+ */
+int ppm_saver_close(struct ppm_saver* saver) {
+    pthread_mutex_lock(&saver->mutex);
+    saver->closing = 1;
+    pthread_cond_broadcast(&saver->cond);
+    pthread_mutex_unlock(&saver->mutex);
+    pthread_join(saver->thread, NULL);
+
+    pthread_mutex_destroy(&saver->mutex);
+    pthread_cond_destroy(&saver->cond);
+    free(saver->slots);
+    free(saver->filenames);
+    return saver->failures;
+}
@@ -0,0 +1,81 @@
+#ifndef async_ppm_H_
+#define async_ppm_H_
+
+#include <pthread.h>
+#include "read_ppm.h"
+
+// An image handed between the caller and the background I/O threads. Its
+// pixels are either read into memory or, for mapped loads, a private
+// copy-on-write mapping of the file.
+struct ppm_async_image {
+  struct ppm_pixel* pixels;   // NULL if the image could not be loaded
+  int width;
+  int height;
+  struct ppm_map map;         // base is NULL when the pixels were read
+};
+
+// free or unmap the pixels of an image
+extern void ppm_async_release(struct ppm_async_image* image);
+
+// A background thread that loads a list of images in order, staying at
+// most depth images ahead of the caller, so the next image is read from
+// disk while the current one is processed
+struct ppm_loader {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  char** filenames;
+  int count;
+  int mapped;                      // 1 to map copy-on-write, 0 to read
+  int depth;
+  struct ppm_async_image* slots;   // a ring of depth loaded images
+  int loaded;                      // images loaded so far
+  int taken;                       // images handed to the caller so far
+  int stop;
+};
+
+// start loading count images; with mapped, images are mapped copy-on-write
+// with map_ppm_private and their pages faulted in, otherwise read with
+// read_ppm
+// returns 0 on success, or -1 if the thread cannot be started
+extern int ppm_loader_open(struct ppm_loader* loader, char** filenames, int count, int depth, int mapped);
+
+// wait for the next image in order; the caller owns it and must release it
+// or pass it to a saver
+// returns 1 with the next image (whose pixels are NULL if it could not be
+// loaded), or 0 when every image has been handed out
+extern int ppm_loader_next(struct ppm_loader* loader, struct ppm_async_image* image);
+
+// stop loading, release any images not handed out, and join the thread
+extern void ppm_loader_close(struct ppm_loader* loader);
+
+// A background thread that writes images and then releases them, holding
+// at most depth images waiting to be written, so the caller moves on to
+// the next image while the previous one drains to disk
+struct ppm_saver {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int depth;
+  struct ppm_async_image* slots;   // a ring of depth queued images
+  char** filenames;                // where each queued image goes
+  int submitted;                   // images queued so far
+  int saved;                       // images written (or failed) so far
+  int failures;
+  int closing;
+};
+
+// start a saver thread that queues at most depth images
+// returns 0 on success, or -1 if the thread cannot be started
+extern int ppm_saver_open(struct ppm_saver* saver, int depth);
+
+// queue an image to be written as P6 to filename and then released; the
+// saver takes ownership of it; blocks while depth images are waiting
+// returns 0 on success, or -1 if the image has no pixels
+extern int ppm_saver_submit(struct ppm_saver* saver, const char* filename, struct ppm_async_image* image);
+
+// write every queued image and join the thread
+// returns the number of images that could not be written
+extern int ppm_saver_close(struct ppm_saver* saver);
+
+#endif
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "read_ppm.h"
+#include "write_ppm.h"
+#include "qoi.h"
+
+/**
+ * QOI Codec Benchmark
+ *
+ * Compares QOI output against raw P6 for each image given: the compression
+ * ratio, the speed of encoding and decoding in memory, and the speed of
+ * writing the file each way. Speeds are in MB/s of raw pixels, so they are
+ * comparable between the two formats, and each is the best of -r runs.
+ *
+ * Usage: ./bench_qoi [-r <repeats>] <image.ppm> [more.ppm ...]
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define TEMP_FILE "bench_qoi.tmp"
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Returns the size of a file in bytes, or -1 if it cannot be opened.
+ */
+static long file_size(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+int main(int argc, char* argv[]) {
+    int repeats = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, ":r:")) != -1) {
+        switch (opt) {
+        case 'r': repeats = atoi(optarg); break;
+        case '?': printf("usage: %s -r <repeats> <image.ppm> [more.ppm ...]\n", argv[0]); break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s -r <repeats> <image.ppm> [more.ppm ...]\n", argv[0]);
+        return 1;
+    }
+    if (repeats < 1) repeats = 1;
+
+    printf("%-32s %11s %11s %11s %6s %10s %10s %10s %10s\n", "image", "pixels", "ppm_bytes",
+           "qoi_bytes", "ratio", "enc_MB/s", "dec_MB/s", "ppm_wMB/s", "qoi_wMB/s");
+    int status = 0;
+    for (int i = optind; i < argc; i++) {
+        int w, h;
+        struct ppm_pixel* pixels = read_ppm(argv[i], &w, &h);
+        if (!pixels) {
+            status = 1;
+            continue;
+        }
+        double mb = (double)w * h * sizeof(struct ppm_pixel) / 1e6;
+        unsigned char* encoded = malloc(qoi_max_size(w, h));
+
+        // Encode and decode in memory
+        size_t length = 0;
+        double encode = 1e30, decode = 1e30;
+        int exact = 1;
+        for (int r = 0; r < repeats; r++) {
+            double t = now();
+            length = qoi_encode(pixels, w, h, encoded);
+            double t1 = now();
+            int dw, dh;
+            struct ppm_pixel* decoded = qoi_decode(encoded, length, &dw, &dh);
+            double t2 = now();
+            if (t1 - t < encode) encode = t1 - t;
+            if (t2 - t1 < decode) decode = t2 - t1;
+            exact = exact && decoded && memcmp(decoded, pixels, (size_t)w * h * sizeof(struct ppm_pixel)) == 0;
+            free(decoded);
+        }
+        if (!exact) {
+            fprintf(stderr, "%s: decoded image differs from the original\n", argv[i]);
+            status = 1;
+        }
+
+        // Write each format to a file
+        double writePpm = 1e30, writeQoi = 1e30;
+        long ppmBytes = 0;
+        for (int r = 0; r < repeats; r++) {
+            double t = now();
+            write_image(TEMP_FILE, pixels, w, h, IMAGE_PPM);
+            double t1 = now();
+            ppmBytes = file_size(TEMP_FILE);
+            double t2 = now();
+            write_image(TEMP_FILE, pixels, w, h, IMAGE_QOI);
+            double t3 = now();
+            if (t1 - t < writePpm) writePpm = t1 - t;
+            if (t3 - t2 < writeQoi) writeQoi = t3 - t2;
+        }
+        remove(TEMP_FILE);
+
+        printf("%-32s %11ld %11ld %11zu %6.2f %10.0f %10.0f %10.0f %10.0f\n", argv[i], (long)w * h,
+               ppmBytes, length, (double)ppmBytes / length, mb / encode, mb / decode,
+               mb / writePpm, mb / writeQoi);
+        free(encoded);
+        free(pixels);
+    }
+    return status;
+}
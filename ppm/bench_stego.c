@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "stego.h"
+
+/**
+ * Steganography Benchmark
+ *
+ * Fills a carrier of random samples to capacity and times stego_embed and
+ * stego_extract against a bit-at-a-time loop, checking that every path
+ * leaves identical samples and returns identical data. Speeds are in GB/s
+ * of carrier samples, each the best of -r runs.
+ *
+ * Usage: ./bench_stego [-m <megapixels>] [-r <repeats>]
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// The loops encode and decode used before, for comparison
+static void embed_loop(unsigned char* samples, const unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            samples[8 * i + bit] = (samples[8 * i + bit] & ~1) | ((data[i] >> (7 - bit)) & 1);
+        }
+    }
+}
+
+static void extract_loop(const unsigned char* samples, unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char byte = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            byte |= (samples[8 * i + bit] & 1) << (7 - bit);
+        }
+        data[i] = byte;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int megapixels = 12;
+    int repeats = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, ":m:r:")) != -1) {
+        switch (opt) {
+        case 'm': megapixels = atoi(optarg); break;
+        case 'r': repeats = atoi(optarg); break;
+        case '?': printf("usage: %s -m <megapixels> -r <repeats>\n", argv[0]); break;
+        }
+    }
+    if (megapixels < 1) megapixels = 1;
+    if (repeats < 1) repeats = 1;
+
+    size_t length = stego_capacity(1000 * megapixels, 1000);
+    size_t samples = 8 * length;
+    unsigned char* original = malloc(samples);
+    unsigned char* simd = malloc(samples);
+    unsigned char* loop = malloc(samples);
+    unsigned char* data = malloc(length);
+    unsigned char* simdData = malloc(length);
+    unsigned char* loopData = malloc(length);
+    if (!original || !simd || !loop || !data || !simdData || !loopData) {
+        fprintf(stderr, "Failed to allocate memory for a %d megapixel carrier\n", megapixels);
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < samples; i++) {
+        original[i] = rand();
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[i] = rand();
+    }
+
+    double best[4] = {1e30, 1e30, 1e30, 1e30};
+    for (int r = 0; r < repeats; r++) {
+        memcpy(simd, original, samples);
+        memcpy(loop, original, samples);
+        double t0 = now();
+        stego_embed(simd, data, length);
+        double t1 = now();
+        embed_loop(loop, data, length);
+        double t2 = now();
+        stego_extract(simd, simdData, length);
+        double t3 = now();
+        extract_loop(loop, loopData, length);
+        double t4 = now();
+        double times[4] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3};
+        for (int k = 0; k < 4; k++) {
+            if (times[k] < best[k]) best[k] = times[k];
+        }
+    }
+
+    int exact = memcmp(simd, loop, samples) == 0 && memcmp(simdData, data, length) == 0 &&
+                memcmp(loopData, data, length) == 0;
+    double gb = samples / 1e9;
+    printf("Carrier: %d megapixels, %zu bytes of data in %zu samples\n", megapixels, length, samples);
+    printf("%-8s %12s %12s\n", "", "embed_GB/s", "extract_GB/s");
+    printf("%-8s %12.2f %12.2f\n", "simd", gb / best[0], gb / best[2]);
+    printf("%-8s %12.2f %12.2f\n", "loop", gb / best[1], gb / best[3]);
+    printf("Bit-exact: %s\n", exact ? "yes" : "NO");
+
+    free(original);
+    free(simd);
+    free(loop);
+    free(data);
+    free(simdData);
+    free(loopData);
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "read_ppm.h"
+#include "write_ppm.h"
+#include "imageops.h"
+
+/**
+ * Image Operations
+ *
+ * Applies image operations to a P5 or P6 file, in this order: a channel
+ * swizzle, a gamma correction, a Gaussian blur and a resize, each only if
+ * asked for, and reports how long each one took.
+ *
+ * Usage: ./imageop -p <numThreads> -s <order> -g <gamma> -b <sigma>
+ *                  -r <width>x<height> -o <output> -f <ppm|qoi> <input.ppm>
+ *
+ * Output: the result is written to <output>, by default the input name with
+ *         "-out" before the extension.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+static double seconds_since(const struct timeval* start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 4;
+    const char* order = NULL;
+    double gamma = 0;
+    double sigma = 0;
+    int newWidth = 0, newHeight = 0;
+    const char* output = NULL;
+    enum image_format format = IMAGE_PPM;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":p:s:g:b:r:o:f:")) != -1) {
+        switch (opt) {
+        case 'p': threads = atoi(optarg); break;
+        case 's': order = optarg; break;
+        case 'g': gamma = atof(optarg); break;
+        case 'b': sigma = atof(optarg); break;
+        case 'r':
+            if (sscanf(optarg, "%dx%d", &newWidth, &newHeight) != 2 || newWidth <= 0 || newHeight <= 0) {
+                fprintf(stderr, "Invalid size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o': output = optarg; break;
+        case 'f':
+            if (image_format_parse(optarg, &format) != 0) {
+                fprintf(stderr, "Unknown format: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case '?':
+            printf("usage: %s -p <numThreads> -s <order> -g <gamma> -b <sigma> -r <width>x<height> "
+                   "-o <output> -f <ppm|qoi> <input.ppm>\n", argv[0]);
+            break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s -p <numThreads> -s <order> -g <gamma> -b <sigma> -r <width>x<height> "
+                "-o <output> -f <ppm|qoi> <input.ppm>\n", argv[0]);
+        return 1;
+    }
+    const char* input = argv[optind];
+
+    char name[1024];
+    if (!output) {
+        snprintf(name, sizeof(name), "%s", input);
+        char* dot = strrchr(name, '.');
+        if (dot && !strchr(dot, '/')) *dot = '\0';
+        size_t length = strlen(name);
+        snprintf(name + length, sizeof(name) - length, "-out.%s", image_format_extension(format));
+        output = name;
+    }
+
+    int w, h;
+    struct ppm_pixel* pixels = read_ppm(input, &w, &h);
+    if (!pixels) return 1;
+    size_t count = (size_t)w * h;
+    struct timeval start;
+
+    if (order) {
+        gettimeofday(&start, NULL);
+        if (image_swizzle(pixels, count, order, threads) != 0) {
+            fprintf(stderr, "Invalid channel order: %s\n", order);
+            free(pixels);
+            return 1;
+        }
+        printf("Swizzled to %s in %f seconds\n", order, seconds_since(&start));
+    }
+
+    if (gamma > 0) {
+        unsigned char lut[3][256];
+        image_gamma_lut(gamma, lut[0]);
+        memcpy(lut[1], lut[0], 256);
+        memcpy(lut[2], lut[0], 256);
+        gettimeofday(&start, NULL);
+        image_apply_lut(pixels, count, (const unsigned char (*)[256])lut, threads);
+        printf("Applied gamma %g in %f seconds\n", gamma, seconds_since(&start));
+    }
+
+    if (sigma > 0 || newWidth > 0) {
+        struct planar_image planar;
+        if (planar_alloc(&planar, w, h) != 0) {
+            free(pixels);
+            return 1;
+        }
+        gettimeofday(&start, NULL);
+        planar_from_pixels(pixels, &planar, threads);
+        printf("Split into planes in %f seconds\n", seconds_since(&start));
+
+        if (sigma > 0) {
+            gettimeofday(&start, NULL);
+            if (image_blur(&planar, sigma, threads) != 0) {
+                fprintf(stderr, "Cannot blur with sigma %g\n", sigma);
+                planar_free(&planar);
+                free(pixels);
+                return 1;
+            }
+            printf("Blurred with sigma %g in %f seconds\n", sigma, seconds_since(&start));
+        }
+
+        if (newWidth > 0) {
+            struct planar_image resized;
+            struct ppm_pixel* out = malloc((size_t)newWidth * newHeight * sizeof(struct ppm_pixel));
+            if (!out || planar_alloc(&resized, newWidth, newHeight) != 0) {
+                fprintf(stderr, "Failed to allocate memory for image\n");
+                free(out);
+                planar_free(&planar);
+                free(pixels);
+                return 1;
+            }
+            gettimeofday(&start, NULL);
+            if (image_resize(&planar, &resized, threads) != 0) {
+                fprintf(stderr, "Failed to allocate memory for resize\n");
+                planar_free(&resized);
+                free(out);
+                planar_free(&planar);
+                free(pixels);
+                return 1;
+            }
+            printf("Resized to %dx%d in %f seconds\n", newWidth, newHeight, seconds_since(&start));
+            planar_free(&planar);
+            planar = resized;
+            free(pixels);
+            pixels = out;
+            w = newWidth;
+            h = newHeight;
+        }
+
+        gettimeofday(&start, NULL);
+        planar_to_pixels(&planar, pixels, threads);
+        printf("Joined planes in %f seconds\n", seconds_since(&start));
+        planar_free(&planar);
+    }
+
+    int result = write_image(output, pixels, w, h, format);
+    free(pixels);
+    if (result != 0) return 1;
+    printf("Writing file %s\n", output);
+    return 0;
+}
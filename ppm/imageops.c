@@ -0,0 +1,625 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include "imageops.h"
+
+/**
+ * Image Operations
+ *
+ * SIMD kernels over rows of samples, run on several threads. Converting to
+ * and from planar images and swizzling channels are byte shuffles (SSSE3
+ * pshufb, the AVX2 form for swizzles). Blur and resize work on one plane
+ * at a time, widening 16 samples to 16-bit lanes of an AVX2 register so
+ * that each tap is one multiply and one add. Lookup tables stay scalar:
+ * there is no byte gather, and a table in L1 is as fast as any emulation.
+ * Every SIMD kernel has a plain C version for other CPUs and for the ends
+ * of rows, and the two give identical results.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define MAX_SIGMA 20.0
+#define MAX_RADIUS 60    // ceil(3 * MAX_SIGMA)
+
+// Runs fn over [0, count) split into one contiguous range per thread;
+// share is the index of the range, for indexing per-thread scratch space
+typedef void (*range_fn)(void* ctx, int share, size_t first, size_t end);
+
+struct range_job {
+    range_fn fn;
+    void* ctx;
+    int share;
+    size_t first;
+    size_t end;
+};
+
+static void* run_range(void* arg) {
+    struct range_job* job = arg;
+    job->fn(job->ctx, job->share, job->first, job->end);
+    return NULL;
+}
+
+/**
+ * Returns how many ranges parallel_for splits count items into, so callers
+ * can allocate scratch space for each.
+ */
+static int shares_of(size_t count, int threads) {
+    if ((size_t)threads > count) threads = count;
+    return threads > 1 ? threads : 1;
+}
+
+/**
+ * Runs fn over [0, count), sharing the range out between threads; the
+ * calling thread takes the first share.
+ */
+static void parallel_for(size_t count, int threads, range_fn fn, void* ctx) {
+    threads = shares_of(count, threads);
+    struct range_job* jobs = threads > 1 ? malloc(threads * sizeof(struct range_job)) : NULL;
+    pthread_t* ids = threads > 1 ? malloc(threads * sizeof(pthread_t)) : NULL;
+    if (!jobs || !ids) {
+        free(jobs);
+        free(ids);
+        fn(ctx, 0, 0, count);
+        return;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i] = (struct range_job){fn, ctx, i, count * i / threads, count * (i + 1) / threads};
+    }
+    int started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, run_range, &jobs[started]) != 0) break;
+    }
+    run_range(&jobs[0]);
+    for (int i = started; i < threads; i++) {
+        run_range(&jobs[i]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(jobs);
+    free(ids);
+}
+
+/**
+ * Allocates the planes of an image.
+ *
+ * @param image The image
+ * @param w The width of the image
+ * @param h The height of the image
+ * @return 0 on success, or -1 if the memory cannot be allocated
+ */
+int planar_alloc(struct planar_image* image, int w, int h) {
+    size_t plane = (size_t)w * h;
+    image->width = w;
+    image->height = h;
+    image->planes[0] = malloc(plane * 3 > 0 ? plane * 3 : 1);
+    if (!image->planes[0]) {
+        fprintf(stderr, "Failed to allocate memory for image\n");
+        return -1;
+    }
+    image->planes[1] = image->planes[0] + plane;
+    image->planes[2] = image->planes[1] + plane;
+    return 0;
+}
+
+/**
+ * Frees the planes of an image.
+ * @param image The image
+ */
+void planar_free(struct planar_image* image) {
+    free(image->planes[0]);
+    image->planes[0] = image->planes[1] = image->planes[2] = NULL;
+}
+
+// The pixels and planes of a conversion
+struct planar_job {
+    struct ppm_pixel* pixels;
+    unsigned char* planes[3];
+};
+
+/**
+ * Splits 16 pixels a step into planes with SSSE3. Each plane gathers its
+ * bytes from the three 16-byte loads with one shuffle each.
+ * @return The number of pixels done
+ */
+__attribute__((target("ssse3")))
+static size_t split_ssse3(const unsigned char* in, unsigned char* const* planes, size_t n) {
+    // masks[c][v]: where in load v the samples of channel c are
+    unsigned char masks[3][3][16];
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 3; v++) {
+            for (int p = 0; p < 16; p++) {
+                int byte = 3 * p + c;
+                masks[c][v][p] = byte / 16 == v ? byte % 16 : 0x80;
+            }
+        }
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i loads[3];
+        for (int v = 0; v < 3; v++) {
+            loads[v] = _mm_loadu_si128((const __m128i*)(in + 3 * i + 16 * v));
+        }
+        for (int c = 0; c < 3; c++) {
+            __m128i plane = _mm_setzero_si128();
+            for (int v = 0; v < 3; v++) {
+                __m128i mask = _mm_loadu_si128((const __m128i*)masks[c][v]);
+                plane = _mm_or_si128(plane, _mm_shuffle_epi8(loads[v], mask));
+            }
+            _mm_storeu_si128((__m128i*)(planes[c] + i), plane);
+        }
+    }
+    return i;
+}
+
+/**
+ * Joins 16 pixels a step from planes with SSSE3, the inverse of
+ * split_ssse3.
+ * @return The number of pixels done
+ */
+__attribute__((target("ssse3")))
+static size_t join_ssse3(unsigned char* const* planes, unsigned char* out, size_t n) {
+    // masks[v][c]: which samples of channel c go where in store v
+    unsigned char masks[3][3][16];
+    for (int v = 0; v < 3; v++) {
+        for (int c = 0; c < 3; c++) {
+            for (int k = 0; k < 16; k++) {
+                int byte = 16 * v + k;
+                masks[v][c][k] = byte % 3 == c ? byte / 3 : 0x80;
+            }
+        }
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i samples[3];
+        for (int c = 0; c < 3; c++) {
+            samples[c] = _mm_loadu_si128((const __m128i*)(planes[c] + i));
+        }
+        for (int v = 0; v < 3; v++) {
+            __m128i bytes = _mm_setzero_si128();
+            for (int c = 0; c < 3; c++) {
+                __m128i mask = _mm_loadu_si128((const __m128i*)masks[v][c]);
+                bytes = _mm_or_si128(bytes, _mm_shuffle_epi8(samples[c], mask));
+            }
+            _mm_storeu_si128((__m128i*)(out + 3 * i + 16 * v), bytes);
+        }
+    }
+    return i;
+}
+
+static void split_range(void* ctx, int share, size_t first, size_t end) {
+    struct planar_job* job = ctx;
+    const unsigned char* in = (const unsigned char*)(job->pixels + first);
+    unsigned char* planes[3] = {job->planes[0] + first, job->planes[1] + first, job->planes[2] + first};
+    size_t n = end - first;
+    size_t i = __builtin_cpu_supports("ssse3") ? split_ssse3(in, planes, n) : 0;
+    for (; i < n; i++) {
+        planes[0][i] = in[3 * i];
+        planes[1][i] = in[3 * i + 1];
+        planes[2][i] = in[3 * i + 2];
+    }
+}
+
+static void join_range(void* ctx, int share, size_t first, size_t end) {
+    struct planar_job* job = ctx;
+    unsigned char* out = (unsigned char*)(job->pixels + first);
+    unsigned char* planes[3] = {job->planes[0] + first, job->planes[1] + first, job->planes[2] + first};
+    size_t n = end - first;
+    size_t i = __builtin_cpu_supports("ssse3") ? join_ssse3(planes, out, n) : 0;
+    for (; i < n; i++) {
+        out[3 * i] = planes[0][i];
+        out[3 * i + 1] = planes[1][i];
+        out[3 * i + 2] = planes[2][i];
+    }
+}
+
+/**
+ * Splits interleaved pixels into planes.
+ *
+ * @param pixels The pixels, as many as the image has
+ * @param image Returns the planes
+ * @param threads The number of threads to use
+ */
+void planar_from_pixels(const struct ppm_pixel* pixels, struct planar_image* image, int threads) {
+    struct planar_job job = {(struct ppm_pixel*)pixels, {image->planes[0], image->planes[1], image->planes[2]}};
+    parallel_for((size_t)image->width * image->height, threads, split_range, &job);
+}
+
+/**
+ * Joins planes back into interleaved pixels.
+ *
+ * @param image The image
+ * @param pixels Returns the pixels
+ * @param threads The number of threads to use
+ */
+void planar_to_pixels(const struct planar_image* image, struct ppm_pixel* pixels, int threads) {
+    struct planar_job job = {pixels, {image->planes[0], image->planes[1], image->planes[2]}};
+    parallel_for((size_t)image->width * image->height, threads, join_range, &job);
+}
+
+/**
+ * Computes out[x] = sum of weights[k] * srcs[k][x], in 8.8 fixed point and
+ * rounded, for x in [from, n).
+ */
+static void taps_scalar(const unsigned char* const* srcs, const uint16_t* weights, int taps,
+                        unsigned char* out, int from, int n) {
+    for (int x = from; x < n; x++) {
+        unsigned sum = 128;
+        for (int k = 0; k < taps; k++) {
+            sum += weights[k] * srcs[k][x];
+        }
+        out[x] = sum >> 8;
+    }
+}
+
+/**
+ * The AVX2 form of taps_scalar, 16 samples a step. The weights sum to 256,
+ * so every sum fits in 16 bits.
+ */
+__attribute__((target("avx2")))
+static void taps_avx2(const unsigned char* const* srcs, const uint16_t* weights, int taps,
+                      unsigned char* out, int n) {
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        __m256i sum = _mm256_set1_epi16(128);
+        for (int k = 0; k < taps; k++) {
+            __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(srcs[k] + x)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(v, _mm256_set1_epi16(weights[k])));
+        }
+        sum = _mm256_srli_epi16(sum, 8);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128((__m128i*)(out + x), packed);
+    }
+    taps_scalar(srcs, weights, taps, out, x, n);
+}
+
+static void taps(const unsigned char* const* srcs, const uint16_t* weights, int count,
+                 unsigned char* out, int n) {
+    if (__builtin_cpu_supports("avx2")) {
+        taps_avx2(srcs, weights, count, out, n);
+    } else {
+        taps_scalar(srcs, weights, count, out, 0, n);
+    }
+}
+
+// A blur pass over the rows of all three planes, with scratch space for
+// each share of the rows
+struct blur_job {
+    const struct planar_image* in;
+    struct planar_image* out;
+    const uint16_t* weights;
+    int radius;
+    unsigned char* padded;        // a row and its edges, w + 2 * radius a share
+    const unsigned char** srcs;   // the rows of each tap, 2 * radius + 1 a share
+};
+
+/**
+ * Blurs rows across; row i is row i % height of plane i / height.
+ */
+static void blur_across(void* ctx, int share, size_t first, size_t end) {
+    struct blur_job* job = ctx;
+    int w = job->in->width, h = job->in->height, r = job->radius;
+    int taps_count = 2 * r + 1;
+    unsigned char* padded = job->padded + (size_t)share * (w + 2 * r);
+    const unsigned char** srcs = job->srcs + (size_t)share * taps_count;
+    for (int k = 0; k < taps_count; k++) {
+        srcs[k] = padded + k;
+    }
+
+    for (size_t i = first; i < end; i++) {
+        const unsigned char* row = job->in->planes[i / h] + (i % h) * (size_t)w;
+        memset(padded, row[0], r);
+        memcpy(padded + r, row, w);
+        memset(padded + r + w, row[w - 1], r);
+        taps(srcs, job->weights, taps_count, job->out->planes[i / h] + (i % h) * (size_t)w, w);
+    }
+}
+
+/**
+ * Blurs rows down, each output row summing the rows around it.
+ */
+static void blur_down(void* ctx, int share, size_t first, size_t end) {
+    struct blur_job* job = ctx;
+    int w = job->in->width, h = job->in->height, r = job->radius;
+    int taps_count = 2 * r + 1;
+    const unsigned char** srcs = job->srcs + (size_t)share * taps_count;
+
+    for (size_t i = first; i < end; i++) {
+        int y = i % h;
+        const unsigned char* plane = job->in->planes[i / h];
+        for (int k = 0; k < taps_count; k++) {
+            int row = y + k - r;
+            row = row < 0 ? 0 : row >= h ? h - 1 : row;
+            srcs[k] = plane + (size_t)row * w;
+        }
+        taps(srcs, job->weights, taps_count, job->out->planes[i / h] + (size_t)y * w, w);
+    }
+}
+
+/**
+ * Blurs an image in place with a separable Gaussian, in 8.8 fixed point.
+ *
+ * @param image The image
+ * @param sigma The standard deviation, in pixels
+ * @param threads The number of threads to use
+ * @return 0 on success, or -1 if sigma is out of range or the memory
+ *         cannot be allocated
+ */
+int image_blur(struct planar_image* image, double sigma, int threads) {
+    if (!(sigma >= 0 && sigma <= MAX_SIGMA)) return -1;
+    int radius = (int)ceil(3 * sigma);
+    if (radius == 0 || image->width == 0 || image->height == 0) return 0;
+
+    // Weights in 1/256ths that sum to exactly 256, so flat areas stay flat
+    uint16_t weights[2 * MAX_RADIUS + 1];
+    double g[2 * MAX_RADIUS + 1];
+    double total = 0;
+    for (int k = -radius; k <= radius; k++) {
+        g[k + radius] = exp(-(double)k * k / (2 * sigma * sigma));
+        total += g[k + radius];
+    }
+    int sum = 0;
+    for (int k = 0; k <= 2 * radius; k++) {
+        weights[k] = (uint16_t)(g[k] / total * 256 + 0.5);
+        sum += weights[k];
+    }
+    weights[radius] += 256 - sum;
+
+    // Scratch space for every share, so no thread can fail part way
+    size_t rows = (size_t)3 * image->height;
+    int shares = shares_of(rows, threads);
+    unsigned char* padded = malloc((size_t)shares * (image->width + 2 * radius));
+    const unsigned char** srcs = malloc((size_t)shares * (2 * radius + 1) * sizeof(unsigned char*));
+    struct planar_image temp;
+    if (!padded || !srcs || planar_alloc(&temp, image->width, image->height) != 0) {
+        free(padded);
+        free(srcs);
+        return -1;
+    }
+    struct blur_job across = {image, &temp, weights, radius, padded, srcs};
+    parallel_for(rows, threads, blur_across, &across);
+    struct blur_job down = {&temp, image, weights, radius, padded, srcs};
+    parallel_for(rows, threads, blur_down, &down);
+    planar_free(&temp);
+    free(padded);
+    free(srcs);
+    return 0;
+}
+
+// A resize, with where each output column comes from
+struct resize_job {
+    const struct planar_image* in;
+    struct planar_image* out;
+    const int* x0;        // left source column of each output column
+    const uint16_t* fx;   // weight of the column right of it, in 1/256ths
+    uint16_t* blended;    // a blended source row for each share of the rows
+};
+
+/**
+ * Maps output position i of n onto a source of length, aligning pixel
+ * centres.
+ * @param first Returns the source position at or before the centre
+ * @return The weight of the next source position, in 1/256ths
+ */
+static int source_of(int i, int n, int length, int* first) {
+    double s = (i + 0.5) * length / n - 0.5;
+    if (s < 0) s = 0;
+    if (s > length - 1) s = length - 1;
+    *first = (int)s;
+    return (int)((s - *first) * 256 + 0.5);
+}
+
+/**
+ * Blends two rows, out[x] = a[x] * (256 - f) + b[x] * f, for x in
+ * [from, n).
+ */
+static void blend_scalar(const unsigned char* a, const unsigned char* b, int f, uint16_t* out,
+                         int from, int n) {
+    for (int x = from; x < n; x++) {
+        out[x] = a[x] * (256 - f) + b[x] * f;
+    }
+}
+
+/**
+ * The AVX2 form of blend_scalar, 16 samples a step.
+ */
+__attribute__((target("avx2")))
+static void blend_avx2(const unsigned char* a, const unsigned char* b, int f, uint16_t* out, int n) {
+    const __m256i fa = _mm256_set1_epi16(256 - f);
+    const __m256i fb = _mm256_set1_epi16(f);
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + x)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + x)));
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(va, fa), _mm256_mullo_epi16(vb, fb));
+        _mm256_storeu_si256((__m256i*)(out + x), sum);
+    }
+    blend_scalar(a, b, f, out, x, n);
+}
+
+/**
+ * Resizes output rows; row i is row i % height of plane i / height. Each
+ * blends its two source rows with SIMD, then samples that blended row at
+ * the source columns.
+ */
+static void resize_rows(void* ctx, int share, size_t first, size_t end) {
+    struct resize_job* job = ctx;
+    int w = job->in->width, h = job->in->height;
+    int ow = job->out->width, oh = job->out->height;
+    uint16_t* blended = job->blended + (size_t)share * w;
+    int avx2 = __builtin_cpu_supports("avx2");
+
+    for (size_t i = first; i < end; i++) {
+        int y0;
+        int fy = source_of(i % oh, oh, h, &y0);
+        int y1 = y0 + 1 < h ? y0 + 1 : y0;
+        const unsigned char* plane = job->in->planes[i / oh];
+        const unsigned char* a = plane + (size_t)y0 * w;
+        const unsigned char* b = plane + (size_t)y1 * w;
+        if (avx2) {
+            blend_avx2(a, b, fy, blended, w);
+        } else {
+            blend_scalar(a, b, fy, blended, 0, w);
+        }
+
+        unsigned char* out = job->out->planes[i / oh] + (i % oh) * (size_t)ow;
+        for (int x = 0; x < ow; x++) {
+            int x0 = job->x0[x];
+            int x1 = x0 + 1 < w ? x0 + 1 : x0;
+            uint32_t f = job->fx[x];
+            out[x] = (blended[x0] * (256 - f) + blended[x1] * f + 32768) >> 16;
+        }
+    }
+}
+
+/**
+ * Resizes an image to the size of out by bilinear interpolation.
+ *
+ * @param in The image
+ * @param out The resized image, allocated at its size
+ * @param threads The number of threads to use
+ * @return 0 on success, or -1 if the memory cannot be allocated
+ */
+int image_resize(const struct planar_image* in, struct planar_image* out, int threads) {
+    size_t rows = (size_t)3 * out->height;
+    int shares = shares_of(rows, threads);
+    int* x0 = malloc((out->width > 0 ? out->width : 1) * sizeof(int));
+    uint16_t* fx = malloc((out->width > 0 ? out->width : 1) * sizeof(uint16_t));
+    uint16_t* blended = malloc((size_t)shares * (in->width > 0 ? in->width : 1) * sizeof(uint16_t));
+    if (!x0 || !fx || !blended) {
+        free(x0);
+        free(fx);
+        free(blended);
+        return -1;
+    }
+    for (int x = 0; x < out->width; x++) {
+        fx[x] = source_of(x, out->width, in->width, &x0[x]);
+    }
+
+    struct resize_job job = {in, out, x0, fx, blended};
+    parallel_for(rows, threads, resize_rows, &job);
+    free(x0);
+    free(fx);
+    free(blended);
+    return 0;
+}
+
+/**
+ * Fills a lookup table with the gamma correction v^(1 / gamma).
+ *
+ * @param gamma The gamma, above 0
+ * @param lut Returns the table
+ */
+void image_gamma_lut(double gamma, unsigned char lut[256]) {
+    for (int i = 0; i < 256; i++) {
+        lut[i] = (unsigned char)(255.0 * pow(i / 255.0, 1.0 / gamma) + 0.5);
+    }
+}
+
+// Pixels and the tables to map them through
+struct lut_job {
+    struct ppm_pixel* pixels;
+    const unsigned char (*lut)[256];
+};
+
+static void lut_range(void* ctx, int share, size_t first, size_t end) {
+    struct lut_job* job = ctx;
+    const unsigned char* red = job->lut[0];
+    const unsigned char* green = job->lut[1];
+    const unsigned char* blue = job->lut[2];
+    for (size_t i = first; i < end; i++) {
+        struct ppm_pixel* px = &job->pixels[i];
+        px->red = red[px->red];
+        px->green = green[px->green];
+        px->blue = blue[px->blue];
+    }
+}
+
+/**
+ * Maps each sample through the table of its channel.
+ *
+ * @param pixels The pixels, changed in place
+ * @param count The number of pixels
+ * @param lut A table for each of red, green and blue
+ * @param threads The number of threads to use
+ */
+void image_apply_lut(struct ppm_pixel* pixels, size_t count, const unsigned char lut[3][256], int threads) {
+    struct lut_job job = {pixels, lut};
+    parallel_for(count, threads, lut_range, &job);
+}
+
+// Pixels and where each new channel comes from
+struct swizzle_job {
+    struct ppm_pixel* pixels;
+    int from[3];
+};
+
+/**
+ * Swizzles 10 pixels a step with AVX2: each lane shuffles 15 bytes (5
+ * pixels) and passes the 16th through, so the lanes can be stored over
+ * each other in place.
+ * @return The number of pixels done
+ */
+__attribute__((target("avx2")))
+static size_t swizzle_avx2(unsigned char* bytes, const int* from, size_t n) {
+    unsigned char mask[32];
+    for (int k = 0; k < 16; k++) {
+        mask[k] = mask[k + 16] = k < 15 ? (k / 3) * 3 + from[k % 3] : 15;
+    }
+    const __m256i shuffle = _mm256_loadu_si256((const __m256i*)mask);
+    size_t i = 0;
+    // A step reads 31 bytes, so stop 11 pixels short
+    for (; i + 11 <= n; i += 10) {
+        unsigned char* p = bytes + 3 * i;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                            _mm_loadu_si128((const __m128i*)(p + 15)), 1);
+        v = _mm256_shuffle_epi8(v, shuffle);
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(p + 15), _mm256_extracti128_si256(v, 1));
+    }
+    return i;
+}
+
+static void swizzle_range(void* ctx, int share, size_t first, size_t end) {
+    struct swizzle_job* job = ctx;
+    unsigned char* bytes = (unsigned char*)(job->pixels + first);
+    size_t n = end - first;
+    size_t i = __builtin_cpu_supports("avx2") ? swizzle_avx2(bytes, job->from, n) : 0;
+    for (; i < n; i++) {
+        unsigned char* p = bytes + 3 * i;
+        unsigned char old[3] = {p[0], p[1], p[2]};
+        p[0] = old[job->from[0]];
+        p[1] = old[job->from[1]];
+        p[2] = old[job->from[2]];
+    }
+}
+
+/**
+ * Reorders or copies the channels of pixels in place.
+ *
+ * @param pixels The pixels
+ * @param count The number of pixels
+ * @param order The source of the new red, green and blue, e.g. "bgr"
+ * @param threads The number of threads to use
+ * @return 0 on success, or -1 if order is not three of r, g and b
+ */
+int image_swizzle(struct ppm_pixel* pixels, size_t count, const char* order, int threads) {
+    struct swizzle_job job = {pixels, {0, 0, 0}};
+    if (strlen(order) != 3) return -1;
+    static const char channels[] = "rgb";
+    for (int c = 0; c < 3; c++) {
+        const char* channel = strchr(channels, order[c]);
+        if (!channel || !*channel) return -1;
+        job.from[c] = channel - channels;
+    }
+    parallel_for(count, threads, swizzle_range, &job);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef imageops_H_
+#define imageops_H_
+
+#include <stddef.h>
+#include "read_ppm.h"
+
+// Image operations on ppm_pixel arrays: channel swizzles and lookup tables
+// work on the interleaved pixels, while blur and resize work on planar
+// images, where each channel is its own array, so that a SIMD register
+// holds 16 or 32 samples of one channel instead of a mix of channels.
+// Every operation shares its rows out between threads and uses AVX2 or
+// SSSE3 when the CPU has them; the results do not depend on either.
+
+// An image stored as three planes, red, green and blue, each width x height
+// samples; the planes share one allocation starting at planes[0]
+struct planar_image {
+  int width;
+  int height;
+  unsigned char* planes[3];
+};
+
+// allocate the planes of an image
+// returns 0 on success, or -1 if the memory cannot be allocated
+extern int planar_alloc(struct planar_image* image, int w, int h);
+
+// free the planes of an image
+extern void planar_free(struct planar_image* image);
+
+// split interleaved pixels into the planes of an image of the same size
+extern void planar_from_pixels(const struct ppm_pixel* pixels, struct planar_image* image, int threads);
+
+// join the planes of an image back into interleaved pixels
+extern void planar_to_pixels(const struct planar_image* image, struct ppm_pixel* pixels, int threads);
+
+// blur an image in place with a Gaussian of standard deviation sigma,
+// applied across and then down, with edge samples repeated
+// returns 0 on success, or -1 if sigma is out of range (0 to 20) or the
+// memory cannot be allocated
+extern int image_blur(struct planar_image* image, double sigma, int threads);
+
+// resize an image to the size of out, which must be allocated, by bilinear
+// interpolation; for large reductions, halve first with pyramid_downsample
+// returns 0 on success, or -1 if the memory cannot be allocated
+extern int image_resize(const struct planar_image* in, struct planar_image* out, int threads);
+
+// fill a lookup table that applies a gamma correction v^(1 / gamma)
+extern void image_gamma_lut(double gamma, unsigned char lut[256]);
+
+// replace each sample of count pixels by its entry in the table of its
+// channel
+extern void image_apply_lut(struct ppm_pixel* pixels, size_t count, const unsigned char lut[3][256],
+                            int threads);
+
+// reorder or copy the channels of count pixels in place; order names the
+// source of the new red, green and blue, e.g. "bgr" swaps red and blue and
+// "ggg" makes grey from green
+// returns 0 on success, or -1 if order is not three of r, g and b
+extern int image_swizzle(struct ppm_pixel* pixels, size_t count, const char* order, int threads);
+
+#endif
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "read_ppm.h"
+
+/**
+ * Memory-Mapped PPM Reader
+ *
+ * Maps P6 files into memory and hands out the pixels in place, so reading
+ * an image costs neither a copy nor memory beyond the page cache.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+/**
+ * Maps a PPM file (P6 format, 8-bit samples) into memory and parses its
+ * header.
+ * @param filename The name of the PPM file to map
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @param map Returns the mapping, to be released with unmap_ppm
+ * @param writable 1 for a private copy-on-write mapping, 0 for read-only
+ * @return The first pixel of the image inside the mapping, or NULL if the
+ *         file could not be mapped or is not an 8-bit P6 image
+ */
+static struct ppm_pixel* map_ppm_file(const char* filename, int* w, int* h,
+                                      struct ppm_map* map, int writable) {
+    map->base = NULL;
+    map->length = 0;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 2) {
+        fprintf(stderr, "Unable to map file %s\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = st.st_size;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(NULL, length, prot, writable ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Unable to map file %s\n", filename);
+        return NULL;
+    }
+
+    struct ppm_header header;
+    if (ppm_parse_header(base, length, &header) != 0 || header.channels != 3 || header.maxval > 255) {
+        fprintf(stderr, "Unsupported PPM format (only 8-bit P6 can be mapped)\n");
+        munmap(base, length);
+        return NULL;
+    }
+    if (ppm_data_bytes(&header) > length - header.offset) {
+        fprintf(stderr, "File %s is shorter than its header says\n", filename);
+        munmap(base, length);
+        return NULL;
+    }
+
+    // Pixels are usually visited front to back, so read ahead aggressively
+    madvise(base, length, MADV_SEQUENTIAL);
+    map->base = base;
+    map->length = length;
+    *w = header.width;
+    *h = header.height;
+    return (struct ppm_pixel*)((unsigned char*)base + header.offset);
+}
+
+/**
+ * Maps a PPM file (P6 format) into memory without copying its pixels.
+ * @param filename The name of the PPM file to map
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @param map Returns the mapping, to be released with unmap_ppm
+ * @return A read-only flat array of the pixels inside the mapping, or NULL
+ *         if the file could not be mapped
+ */
+const struct ppm_pixel* map_ppm(const char* filename, int* w, int* h, struct ppm_map* map) {
+    return map_ppm_file(filename, w, h, map, 0);
+}
+
+/**
+ * Maps a PPM file (P6 format) into memory copy-on-write. Only the pages
+ * that are modified are copied, and the file itself never changes.
+ * @param filename The name of the PPM file to map
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @param map Returns the mapping, to be released with unmap_ppm
+ * @return A writable flat array of the pixels inside the mapping, or NULL
+ *         if the file could not be mapped
+ */
+struct ppm_pixel* map_ppm_private(const char* filename, int* w, int* h, struct ppm_map* map) {
+    return map_ppm_file(filename, w, h, map, 1);
+}
+
+/**
+ * Releases a mapping made by map_ppm or map_ppm_private.
+ * @param map The mapping to release; releasing an empty mapping does nothing
+ */
+void unmap_ppm(struct ppm_map* map) {
+    if (map->base) munmap(map->base, map->length);
+    map->base = NULL;
+    map->length = 0;
+}
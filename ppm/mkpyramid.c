@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "pyramid.h"
+
+/**
+ * Pyramid Builder
+ *
+ * Writes the mipmap pyramid of a P5 or P6 file, each level half the size
+ * of the one before, down to a thumbnail, so viewers can open a small
+ * level instead of the full render. The input is streamed, so memory
+ * stays at a band of rows per level however large the image is.
+ *
+ * Usage: ./mkpyramid -p <numThreads> -m <minSize> -o <prefix> <input.ppm>
+ *
+ * Output: level n is written to <prefix>-<n>.ppm; the default prefix is the
+ *         input name without its extension.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+int main(int argc, char* argv[]) {
+    int threads = 4;
+    int minSize = 64;
+    const char* prefix = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":p:m:o:")) != -1) {
+        switch (opt) {
+        case 'p': threads = atoi(optarg); break;
+        case 'm': minSize = atoi(optarg); break;
+        case 'o': prefix = optarg; break;
+        case '?': printf("usage: %s -p <numThreads> -m <minSize> -o <prefix> <input.ppm>\n", argv[0]); break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s -p <numThreads> -m <minSize> -o <prefix> <input.ppm>\n", argv[0]);
+        return 1;
+    }
+    const char* input = argv[optind];
+
+    char name[1024];
+    if (!prefix) {
+        snprintf(name, sizeof(name), "%s", input);
+        char* dot = strrchr(name, '.');
+        if (dot && !strchr(dot, '/')) *dot = '\0';
+        prefix = name;
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    int levels = pyramid_build(input, prefix, minSize, threads);
+    if (levels < 0) return 1;
+    gettimeofday(&end, NULL);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("Built %d levels of %s in %f seconds\n", levels, input, elapsed);
+    if (levels > 0) {
+        printf("Writing files: %s-1.ppm to %s-%d.ppm\n", prefix, prefix, levels);
+    }
+    return 0;
+}
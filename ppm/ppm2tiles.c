@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tiled.h"
+
+/**
+ * PPM to Tiled Image Converter
+ *
+ * Converts a P5 or P6 file into a tiled image file (see tiled.h), whose
+ * regions can then be read without reading the whole image. The input is
+ * streamed a band of tiles at a time, so files larger than memory convert.
+ *
+ * Usage: ./ppm2tiles -t <tileSize> -c raw|qoi <input.ppm> <output.tiles>
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+int main(int argc, char* argv[]) {
+    int tileSize = 256;
+    const char* compressionName = "qoi";
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":t:c:")) != -1) {
+        switch (opt) {
+        case 't': tileSize = atoi(optarg); break;
+        case 'c': compressionName = optarg; break;
+        case '?': printf("usage: %s -t <tileSize> -c raw|qoi <input.ppm> <output.tiles>\n", argv[0]); break;
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "usage: %s -t <tileSize> -c raw|qoi <input.ppm> <output.tiles>\n", argv[0]);
+        return 1;
+    }
+
+    enum tile_compression compression;
+    if (strcmp(compressionName, "raw") == 0) {
+        compression = TILE_RAW;
+    } else if (strcmp(compressionName, "qoi") == 0) {
+        compression = TILE_QOI;
+    } else {
+        fprintf(stderr, "Unknown compression %s\n", compressionName);
+        return 1;
+    }
+
+    if (tiled_convert(argv[optind], argv[optind + 1], tileSize, compression) != 0) {
+        return 1;
+    }
+    printf("Writing file: %s\n", argv[optind + 1]);
+    return 0;
+}
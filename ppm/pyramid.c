@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include "pyramid.h"
+
+/**
+ * Image Pyramids
+ *
+ * Halves images with a 2x2 box filter. Each output row reads two input
+ * rows of interleaved RGB; a byte shuffle brings the matching channels of
+ * neighbouring pixels side by side, one multiply-add sums each pair into
+ * 16 bits, and the two rows are added, rounded and packed back to bytes.
+ * AVX2 does 8 output pixels a step and SSSE3 4, chosen when the CPU has
+ * them, with plain C for the last few pixels of a row and for other CPUs;
+ * all three give identical results.
+ *
+ * Pyramids are built by streaming: the input is read a band of rows at a
+ * time, and each level downsamples and writes a band as soon as the level
+ * above has produced the rows for it.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define BAND_ROWS 64   // rows each level produces at a time
+
+// averages the pixel pairs [from, to) of two rows into out
+typedef void (*row_kernel)(const unsigned char* a, const unsigned char* b, unsigned char* out,
+                           int from, int to);
+
+/**
+ * Averages pixel pairs [from, to) of two rows in plain C.
+ * @param a The upper row, as bytes
+ * @param b The lower row
+ * @param out The output row
+ * @param from The first pair
+ * @param to The end of the pairs
+ */
+static void downsample_scalar(const unsigned char* a, const unsigned char* b, unsigned char* out,
+                              int from, int to) {
+    for (int x = from; x < to; x++) {
+        for (int c = 0; c < 3; c++) {
+            out[3 * x + c] = (a[6 * x + c] + a[6 * x + 3 + c] + b[6 * x + c] + b[6 * x + 3 + c] + 2) >> 2;
+        }
+    }
+}
+
+/**
+ * Sums the pixel pairs of 12 bytes (4 pixels) of a row into the first six
+ * 16-bit lanes: r0+r1, g0+g1, b0+b1, r2+r3, g2+g3, b2+b3.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i pair_sums(__m128i bytes) {
+    const __m128i pairs = _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1);
+    return _mm_maddubs_epi16(_mm_shuffle_epi8(bytes, pairs), _mm_set1_epi8(1));
+}
+
+/**
+ * Averages pixel pairs with SSSE3, 4 output pixels a step.
+ */
+__attribute__((target("ssse3")))
+static void downsample_ssse3(const unsigned char* a, const unsigned char* b, unsigned char* out,
+                             int from, int to) {
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i compact = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+    int x = from;
+    // A step reads 28 bytes of each row and stores 16, so stop 6 pairs short
+    for (; x + 6 <= to; x += 4) {
+        const unsigned char* pa = a + 6 * x;
+        const unsigned char* pb = b + 6 * x;
+        __m128i lo = _mm_add_epi16(pair_sums(_mm_loadu_si128((const __m128i*)pa)),
+                                   pair_sums(_mm_loadu_si128((const __m128i*)pb)));
+        __m128i hi = _mm_add_epi16(pair_sums(_mm_loadu_si128((const __m128i*)(pa + 12))),
+                                   pair_sums(_mm_loadu_si128((const __m128i*)(pb + 12))));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        __m128i packed = _mm_shuffle_epi8(_mm_packus_epi16(lo, hi), compact);
+        _mm_storeu_si128((__m128i*)(out + 3 * x), packed);
+    }
+    downsample_scalar(a, b, out, x, to);
+}
+
+/**
+ * Loads 12 bytes at p into the low lane and 12 bytes at p + 24 into the
+ * high lane.
+ */
+__attribute__((target("avx2")))
+static inline __m256i load_lanes(const unsigned char* p) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                   _mm_loadu_si128((const __m128i*)(p + 24)), 1);
+}
+
+/**
+ * Averages pixel pairs with AVX2, 8 output pixels a step: each 128-bit
+ * lane does what one SSSE3 step does.
+ */
+__attribute__((target("avx2")))
+static void downsample_avx2(const unsigned char* a, const unsigned char* b, unsigned char* out,
+                            int from, int to) {
+    const __m256i pairs = _mm256_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1,
+                                           0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+                                             0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = from;
+    // A step reads 52 bytes of each row and stores 28, so stop 10 pairs short
+    for (; x + 10 <= to; x += 8) {
+        const unsigned char* pa = a + 6 * x;
+        const unsigned char* pb = b + 6 * x;
+        // Lanes hold 12-byte chunks 0 and 2, then 1 and 3, so that after
+        // packing the low lane has output pixels 0-3 and the high lane 4-7
+        __m256i first = _mm256_add_epi16(
+            _mm256_maddubs_epi16(_mm256_shuffle_epi8(load_lanes(pa), pairs), ones),
+            _mm256_maddubs_epi16(_mm256_shuffle_epi8(load_lanes(pb), pairs), ones));
+        __m256i second = _mm256_add_epi16(
+            _mm256_maddubs_epi16(_mm256_shuffle_epi8(load_lanes(pa + 12), pairs), ones),
+            _mm256_maddubs_epi16(_mm256_shuffle_epi8(load_lanes(pb + 12), pairs), ones));
+        first = _mm256_srli_epi16(_mm256_add_epi16(first, two), 2);
+        second = _mm256_srli_epi16(_mm256_add_epi16(second, two), 2);
+        __m256i packed = _mm256_shuffle_epi8(_mm256_packus_epi16(first, second), compact);
+        _mm_storeu_si128((__m128i*)(out + 3 * x), _mm256_castsi256_si128(packed));
+        _mm_storeu_si128((__m128i*)(out + 3 * x + 12), _mm256_extracti128_si256(packed, 1));
+    }
+    downsample_ssse3(a, b, out, x, to);
+}
+
+/**
+ * Returns the widest row kernel the CPU supports.
+ */
+static row_kernel select_kernel() {
+    if (__builtin_cpu_supports("avx2")) return downsample_avx2;
+    if (__builtin_cpu_supports("ssse3")) return downsample_ssse3;
+    return downsample_scalar;
+}
+
+/**
+ * Returns the size of the next level down.
+ * @param length A width or height
+ */
+int pyramid_half(int length) {
+    return (length + 1) / 2;
+}
+
+// One thread's share of the output rows of pyramid_downsample
+struct downsample_job {
+    const struct ppm_pixel* in;
+    int w;
+    int h;
+    struct ppm_pixel* out;
+    int firstRow;
+    int endRow;
+    row_kernel kernel;
+};
+
+/**
+ * Downsamples a job's output rows. A last odd row or column is averaged
+ * with itself.
+ * @param arg The downsample_job
+ */
+static void* downsample_rows(void* arg) {
+    struct downsample_job* job = arg;
+    int ow = pyramid_half(job->w);
+    int pairs = job->w / 2;
+    for (int y = job->firstRow; y < job->endRow; y++) {
+        const unsigned char* a = (const unsigned char*)(job->in + (size_t)2 * y * job->w);
+        const unsigned char* b = 2 * y + 1 < job->h ? a + (size_t)job->w * 3 : a;
+        unsigned char* out = (unsigned char*)(job->out + (size_t)y * ow);
+        job->kernel(a, b, out, 0, pairs);
+        if (job->w % 2) {
+            for (int c = 0; c < 3; c++) {
+                out[3 * pairs + c] = (2 * a[6 * pairs + c] + 2 * b[6 * pairs + c] + 2) >> 2;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Halves an image with a 2x2 box filter, sharing the output rows between
+ * threads.
+ *
+ * @param in The image
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param out Returns pyramid_half(w) x pyramid_half(h) pixels
+ * @param threads The number of threads to use
+ */
+void pyramid_downsample(const struct ppm_pixel* in, int w, int h, struct ppm_pixel* out, int threads) {
+    int oh = pyramid_half(h);
+    if (threads > oh) threads = oh;
+    if (threads < 1) threads = 1;
+
+    struct downsample_job* jobs = malloc(threads * sizeof(struct downsample_job));
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    if (!jobs || !ids) {
+        // Fall back to doing every row on the calling thread
+        free(jobs);
+        free(ids);
+        struct downsample_job job = {in, w, h, out, 0, oh, select_kernel()};
+        downsample_rows(&job);
+        return;
+    }
+    row_kernel kernel = select_kernel();
+    for (int i = 0; i < threads; i++) {
+        jobs[i] = (struct downsample_job){in, w, h, out, (long)oh * i / threads,
+                                          (long)oh * (i + 1) / threads, kernel};
+    }
+    // The calling thread takes the first share
+    int started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, downsample_rows, &jobs[started]) != 0) break;
+    }
+    downsample_rows(&jobs[0]);
+    for (int i = started; i < threads; i++) {
+        downsample_rows(&jobs[i]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(jobs);
+    free(ids);
+}
+
+// One level of a pyramid being streamed
+struct pyramid_level {
+    int inWidth;               // the size of the level above
+    int inHeight;
+    int width;                 // the size of this level
+    int height;
+    int received;              // rows of the level above taken so far
+    int pending;               // of which are waiting in band
+    struct ppm_pixel* band;    // 2 * BAND_ROWS rows of the level above
+    struct ppm_pixel* out;     // BAND_ROWS rows of this level
+    struct ppm_writer writer;
+};
+
+static int add_rows(struct pyramid_level* levels, int count, int level,
+                    const struct ppm_pixel* rows, int n, int threads);
+
+/**
+ * Downsamples the rows waiting at a level, writes them, and passes them on
+ * to the level below.
+ * @return 0 on success, or -1 if a file cannot be written
+ */
+static int flush_level(struct pyramid_level* levels, int count, int level, int threads) {
+    struct pyramid_level* current = &levels[level];
+    int rows = pyramid_half(current->pending);
+    pyramid_downsample(current->band, current->inWidth, current->pending, current->out, threads);
+    current->pending = 0;
+    if (ppm_write_rows(&current->writer, current->out, rows) != 0) return -1;
+    if (level + 1 < count) {
+        return add_rows(levels, count, level + 1, current->out, rows, threads);
+    }
+    return 0;
+}
+
+/**
+ * Gives rows of the level above to a level, flushing it whenever a band
+ * is complete or the last row has arrived.
+ * @return 0 on success, or -1 if a file cannot be written
+ */
+static int add_rows(struct pyramid_level* levels, int count, int level,
+                    const struct ppm_pixel* rows, int n, int threads) {
+    struct pyramid_level* current = &levels[level];
+    while (n > 0) {
+        int take = 2 * BAND_ROWS - current->pending;
+        if (take > n) take = n;
+        memcpy(current->band + (size_t)current->pending * current->inWidth, rows,
+               (size_t)take * current->inWidth * sizeof(struct ppm_pixel));
+        current->pending += take;
+        current->received += take;
+        rows += (size_t)take * current->inWidth;
+        n -= take;
+        if (current->pending == 2 * BAND_ROWS || current->received == current->inHeight) {
+            if (flush_level(levels, count, level, threads) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Builds the pyramid of a P5 or P6 file in one pass over it.
+ *
+ * @param input The image
+ * @param prefix Level n is written to <prefix>-<n>.ppm
+ * @param minSize Levels stop once neither side is above this
+ * @param threads The number of threads for each band
+ * @return The number of levels written, or -1 if a file cannot be used
+ */
+int pyramid_build(const char* input, const char* prefix, int minSize, int threads) {
+    struct ppm_reader reader;
+    if (ppm_reader_open(&reader, input) != 0) return -1;
+    if (minSize < 1) minSize = 1;
+
+    int count = 0;
+    for (int w = reader.header.width, h = reader.header.height; w > minSize || h > minSize; count++) {
+        w = pyramid_half(w);
+        h = pyramid_half(h);
+    }
+    struct pyramid_level* levels = calloc(count > 0 ? count : 1, sizeof(struct pyramid_level));
+    if (!levels) {
+        ppm_reader_close(&reader);
+        return -1;
+    }
+
+    int status = 0;
+    int opened = 0;
+    for (; opened < count && status == 0; opened++) {
+        struct pyramid_level* level = &levels[opened];
+        level->inWidth = opened == 0 ? reader.header.width : levels[opened - 1].width;
+        level->inHeight = opened == 0 ? reader.header.height : levels[opened - 1].height;
+        level->width = pyramid_half(level->inWidth);
+        level->height = pyramid_half(level->inHeight);
+        level->band = malloc((size_t)2 * BAND_ROWS * level->inWidth * sizeof(struct ppm_pixel));
+        level->out = malloc((size_t)BAND_ROWS * level->width * sizeof(struct ppm_pixel));
+
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s-%d.ppm", prefix, opened + 1);
+        struct ppm_header header = ppm_rgb_header(level->width, level->height);
+        if (!level->band || !level->out) {
+            fprintf(stderr, "Failed to allocate memory for pyramid level %d\n", opened + 1);
+            status = -1;
+        } else if (ppm_writer_open(&level->writer, filename, &header) != 0) {
+            status = -1;
+        }
+    }
+
+    // The top level reads straight into its band
+    int rows = 0;
+    while (status == 0 && count > 0 &&
+           (rows = ppm_read_pixels(&reader, levels[0].band, 2 * BAND_ROWS)) > 0) {
+        levels[0].pending = rows;
+        levels[0].received += rows;
+        status = flush_level(levels, count, 0, threads);
+    }
+    if (rows < 0) status = -1;
+    ppm_reader_close(&reader);
+
+    for (int i = 0; i < opened; i++) {
+        if (levels[i].writer.fp && ppm_writer_close(&levels[i].writer) != 0) status = -1;
+        free(levels[i].band);
+        free(levels[i].out);
+    }
+    free(levels);
+    if (status != 0) {
+        fprintf(stderr, "Failed to build the pyramid of %s\n", input);
+        return -1;
+    }
+    return count;
+}
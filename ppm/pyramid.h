@@ -0,0 +1,28 @@
+#ifndef pyramid_H_
+#define pyramid_H_
+
+#include "read_ppm.h"
+#include "write_ppm.h"
+
+// Image pyramids: each level halves the one before it with a 2x2 box
+// filter, down to a thumbnail. Odd widths and heights keep their last
+// column or row, averaged with itself, so level n + 1 of a w x h image is
+// (w + 1) / 2 x (h + 1) / 2.
+
+// the size of the next level down
+extern int pyramid_half(int length);
+
+// halve an image: out receives pyramid_half(w) x pyramid_half(h) pixels,
+// each the rounded mean of a 2x2 block of in; the rows are shared out
+// between threads and each row uses the widest SIMD the CPU has
+extern void pyramid_downsample(const struct ppm_pixel* in, int w, int h, struct ppm_pixel* out, int threads);
+
+// build the pyramid of a P5 or P6 file, writing level 1, 2, ... to
+// <prefix>-<level>.ppm until neither side is above minSize
+// the input is read once, a band of rows at a time, and every level is
+// downsampled and written as soon as a band of its rows is ready, so only
+// a band of rows per level is held in memory at once
+// returns the number of levels written, or -1 if a file cannot be used
+extern int pyramid_build(const char* input, const char* prefix, int minSize, int threads);
+
+#endif
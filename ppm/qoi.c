@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "qoi.h"
+
+/**
+ * QOI Codec
+ *
+ * Encodes and decodes the QOI format. Each pixel is written as the shortest
+ * of: a run of the previous pixel, an index into a 64-entry table of
+ * recently seen colours, a small difference from the previous pixel (1 or
+ * 2 bytes), or the full colour. Encoding and decoding are one pass each with
+ * a few comparisons per pixel, so the codec runs at memory speed while the
+ * files shrink severalfold on renders with flat or smooth regions.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define QOI_OP_INDEX 0x00   // 00xxxxxx: the colour at index x
+#define QOI_OP_DIFF 0x40    // 01rrggbb: each channel differs by -2..1
+#define QOI_OP_LUMA 0x80    // 10gggggg rrrrbbbb: green by -32..31, red and blue relative to it
+#define QOI_OP_RUN 0xc0     // 11xxxxxx: the previous pixel x + 1 more times
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK 0xc0
+
+#define QOI_HEADER 14       // "qoif", width, height, channels, colorspace
+#define QOI_PADDING 8       // the end marker
+#define QOI_MAX_RUN 62
+#define QOI_MAX_PIXELS 400000000
+
+static const unsigned char END_MARKER[QOI_PADDING] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+/**
+ * Packs a colour into one word, so table entries compare in one step.
+ */
+static inline uint32_t pack(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    return r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+}
+
+/**
+ * The slot of a colour in the table of recently seen colours.
+ */
+static inline int hash(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+static void put32(unsigned char* out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static uint32_t get32(const unsigned char* in) {
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+/**
+ * Returns the most bytes qoi_encode can write: every pixel as a full
+ * colour, plus the header and the end marker.
+ * @param w The width of the image
+ * @param h The height of the image
+ */
+size_t qoi_max_size(int w, int h) {
+    return (size_t)w * h * 4 + QOI_HEADER + QOI_PADDING;
+}
+
+/**
+ * Encodes a 1D array of pixels as a QOI image.
+ *
+ * @param pixels The pixels of the image
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param out Room for qoi_max_size(w, h) bytes
+ * @return The number of bytes written
+ */
+size_t qoi_encode(const struct ppm_pixel* pixels, int w, int h, unsigned char* out) {
+    memcpy(out, "qoif", 4);
+    put32(out + 4, w);
+    put32(out + 8, h);
+    out[12] = 3;   // RGB
+    out[13] = 0;   // sRGB with linear alpha
+
+    uint32_t index[64] = {0};
+    struct ppm_pixel prev = {0, 0, 0};
+    size_t count = (size_t)w * h;
+    size_t p = QOI_HEADER;
+    int run = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct ppm_pixel px = pixels[i];
+        if (px.red == prev.red && px.green == prev.green && px.blue == prev.blue) {
+            if (++run == QOI_MAX_RUN) {
+                out[p++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out[p++] = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        int slot = hash(px.red, px.green, px.blue, 255);
+        uint32_t packed = pack(px.red, px.green, px.blue, 255);
+        if (index[slot] == packed) {
+            out[p++] = QOI_OP_INDEX | slot;
+        } else {
+            index[slot] = packed;
+            signed char vr = px.red - prev.red;
+            signed char vg = px.green - prev.green;
+            signed char vb = px.blue - prev.blue;
+            signed char vgr = vr - vg;
+            signed char vgb = vb - vg;
+            if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+                out[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+            } else if (vgr >= -8 && vgr <= 7 && vg >= -32 && vg <= 31 && vgb >= -8 && vgb <= 7) {
+                out[p++] = QOI_OP_LUMA | (vg + 32);
+                out[p++] = (vgr + 8) << 4 | (vgb + 8);
+            } else {
+                out[p++] = QOI_OP_RGB;
+                out[p++] = px.red;
+                out[p++] = px.green;
+                out[p++] = px.blue;
+            }
+        }
+        prev = px;
+    }
+    if (run > 0) {
+        out[p++] = QOI_OP_RUN | (run - 1);
+    }
+
+    memcpy(out + p, END_MARKER, QOI_PADDING);
+    return p + QOI_PADDING;
+}
+
+/**
+ * Decodes a QOI image held in memory. Images with an alpha channel are
+ * accepted and the alpha is dropped.
+ *
+ * @param data The file contents
+ * @param length The number of bytes
+ * @param w Returns the width of the image
+ * @param h Returns the height of the image
+ * @return The pixels, or NULL if the data is not a valid image
+ */
+struct ppm_pixel* qoi_decode(const unsigned char* data, size_t length, int* w, int* h) {
+    if (length < QOI_HEADER + QOI_PADDING || memcmp(data, "qoif", 4) != 0) return NULL;
+    uint32_t width = get32(data + 4);
+    uint32_t height = get32(data + 8);
+    if (width == 0 || height == 0 || data[12] < 3 || data[12] > 4 || data[13] > 1 ||
+        width > QOI_MAX_PIXELS / height) {
+        return NULL;
+    }
+
+    size_t count = (size_t)width * height;
+    struct ppm_pixel* pixels = malloc(count * sizeof(struct ppm_pixel));
+    if (!pixels) {
+        fprintf(stderr, "Failed to allocate memory for pixels\n");
+        return NULL;
+    }
+
+    uint32_t index[64] = {0};
+    unsigned char r = 0, g = 0, b = 0, a = 255;
+    size_t end = length - QOI_PADDING;
+    size_t p = QOI_HEADER;
+    int run = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (p >= end) goto truncated;
+            int op = data[p++];
+            if (op == QOI_OP_RGB) {
+                if (end - p < 3) goto truncated;
+                r = data[p];
+                g = data[p + 1];
+                b = data[p + 2];
+                p += 3;
+            } else if (op == QOI_OP_RGBA) {
+                if (end - p < 4) goto truncated;
+                r = data[p];
+                g = data[p + 1];
+                b = data[p + 2];
+                a = data[p + 3];
+                p += 4;
+            } else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+                uint32_t packed = index[op];
+                r = packed;
+                g = packed >> 8;
+                b = packed >> 16;
+                a = packed >> 24;
+            } else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+                r += ((op >> 4) & 3) - 2;
+                g += ((op >> 2) & 3) - 2;
+                b += (op & 3) - 2;
+            } else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+                if (p >= end) goto truncated;
+                int next = data[p++];
+                int vg = (op & 0x3f) - 32;
+                r += vg - 8 + (next >> 4);
+                g += vg;
+                b += vg - 8 + (next & 0x0f);
+            } else {
+                run = op & 0x3f;
+            }
+            index[hash(r, g, b, a)] = pack(r, g, b, a);
+        }
+        pixels[i].red = r;
+        pixels[i].green = g;
+        pixels[i].blue = b;
+    }
+
+    *w = width;
+    *h = height;
+    return pixels;
+
+truncated:
+    free(pixels);
+    return NULL;
+}
+
+/**
+ * Writes a QOI image file from a flat array of pixels.
+ *
+ * @param filename The name of the file to write
+ * @param pixels The pixels of the image
+ * @param w The width of the image
+ * @param h The height of the image
+ * @return 0 on success, or -1 if the file cannot be written
+ */
+int write_qoi(const char* filename, const struct ppm_pixel* pixels, int w, int h) {
+    unsigned char* encoded = malloc(qoi_max_size(w, h));
+    if (!encoded) {
+        fprintf(stderr, "Failed to allocate memory for %s\n", filename);
+        return -1;
+    }
+    size_t length = qoi_encode(pixels, w, h, encoded);
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        free(encoded);
+        return -1;
+    }
+    int status = fwrite(encoded, 1, length, file) == length ? 0 : -1;
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+    }
+    free(encoded);
+    return status;
+}
+
+/**
+ * Reads a QOI image file into a flat array of pixels.
+ *
+ * @param filename The name of the file to read
+ * @param w Returns the width of the image
+ * @param h Returns the height of the image
+ * @return The pixels, or NULL if the file cannot be loaded
+ */
+struct ppm_pixel* read_qoi(const char* filename, int* w, int* h) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return NULL;
+    }
+
+    unsigned char* data = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc(length > 0 ? length : 1);
+    }
+    if (!data || fread(data, 1, length, file) != (size_t)length) {
+        fprintf(stderr, "File read error in %s\n", filename);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    struct ppm_pixel* pixels = qoi_decode(data, length, w, h);
+    if (!pixels) {
+        fprintf(stderr, "Invalid QOI image in %s\n", filename);
+    }
+    free(data);
+    return pixels;
+}
@@ -0,0 +1,36 @@
+#ifndef qoi_H_
+#define qoi_H_
+
+#include <stddef.h>
+#include "read_ppm.h"
+
+// Images in the QOI format ("Quite OK Image"): lossless, compressed in a
+// single pass over the pixels with no dependencies, and typically several
+// times smaller than P6 for rendered images with flat or smooth regions.
+// Files follow the published format, so other QOI tools can open them.
+
+// the most bytes qoi_encode can write for a w x h image
+extern size_t qoi_max_size(int w, int h);
+
+// encode a 1D array of pixels
+// out: room for qoi_max_size(w, h) bytes
+// returns the number of bytes written, header and end marker included
+extern size_t qoi_encode(const struct ppm_pixel* pixels, int w, int h, unsigned char* out);
+
+// decode a QOI image held in memory; an alpha channel is dropped
+// w: pointer argument for returning the width of the image
+// h: pointer argument for returning the height of the image
+// returns a 1D array of ppm_pixel, or NULL if the data is not a valid image
+// NOTE: Caller is responsible for freeing the returned array
+extern struct ppm_pixel* qoi_decode(const unsigned char* data, size_t length, int* w, int* h);
+
+// write a 1D array of pixels as a QOI file
+// returns 0 on success, or -1 if the file cannot be written
+extern int write_qoi(const char* filename, const struct ppm_pixel* pxs, int w, int h);
+
+// read in a QOI file
+// returns a 1D array of ppm_pixel, or NULL, if the file cannot be loaded
+// NOTE: Caller is responsible for freeing the returned array
+extern struct ppm_pixel* read_qoi(const char* filename, int* w, int* h);
+
+#endif
@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include "read_ppm.h"
+
+/**
+ * PPM Reader Implementation
+ *
+ * The one reader shared by every program. Headers are parsed from a single
+ * buffered read rather than character by character, samples are read with
+ * one fread when they already have the layout the caller wants, and only
+ * other formats (P5 grey, maxval other than 255, 16-bit samples) are
+ * converted, a row at a time. All byte counts are size_t, so images over
+ * 2 GB load correctly. A reader can also stream an image a band of rows at
+ * a time, for images too large to hold in memory.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define HEADER_CHUNK 4096          // bytes read at a time while parsing a header
+#define MAX_HEADER (1 << 20)       // longest header accepted, comments included
+
+/**
+ * Skips whitespace and comment lines in a header.
+ * @param data The start of the file
+ * @param length The number of bytes available
+ * @param pos The offset to start from
+ * @return The offset of the next header token, or length if the buffer ends
+ *         first
+ */
+static size_t skip_header_space(const unsigned char* data, size_t length, size_t pos) {
+    while (pos < length) {
+        if (data[pos] == '#') {
+            while (pos < length && data[pos] != '\n') pos++;
+        } else if (isspace(data[pos])) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+/**
+ * Parses a decimal header field.
+ * @param data The start of the file
+ * @param length The number of bytes available
+ * @param pos The offset of the field; returns the offset just past it
+ * @param value Returns the value of the field
+ * @return 0 on success, 1 if the buffer ends first, or -1 if there is no
+ *         valid field
+ */
+static int parse_header_field(const unsigned char* data, size_t length, size_t* pos, long* value) {
+    size_t i = skip_header_space(data, length, *pos);
+    if (i >= length) return 1;
+    if (!isdigit(data[i])) return -1;
+
+    *value = 0;
+    while (i < length && isdigit(data[i])) {
+        *value = *value * 10 + (data[i++] - '0');
+        if (*value > 1000000000) return -1;
+    }
+    // The digits may continue past the end of the buffer
+    if (i >= length) return 1;
+    *pos = i;
+    return 0;
+}
+
+/**
+ * Parses the header at the start of a buffer.
+ * @param data The first bytes of the file
+ * @param length The number of bytes available
+ * @param header Returns the parsed header
+ * @return 0 on success, 1 if the buffer ends before the header does, or -1
+ *         if the header is not valid
+ */
+int ppm_parse_header(const unsigned char* data, size_t length, struct ppm_header* header) {
+    if (length < 2) return 1;
+    if (data[0] != 'P' || (data[1] != '5' && data[1] != '6')) return -1;
+
+    size_t pos = 2;
+    long fields[3];
+    for (int i = 0; i < 3; i++) {
+        int status = parse_header_field(data, length, &pos, &fields[i]);
+        if (status != 0) return status;
+    }
+    if (fields[0] <= 0 || fields[1] <= 0 || fields[2] <= 0 || fields[2] > 65535) return -1;
+
+    // A single whitespace character separates the header from the samples
+    if (!isspace(data[pos])) return -1;
+
+    header->channels = data[1] == '6' ? 3 : 1;
+    header->width = fields[0];
+    header->height = fields[1];
+    header->maxval = fields[2];
+    header->offset = pos + 1;
+    return 0;
+}
+
+/**
+ * Returns the header of a P6 image of 8-bit samples.
+ * @param w The width of the image
+ * @param h The height of the image
+ */
+struct ppm_header ppm_rgb_header(int w, int h) {
+    struct ppm_header header = {3, w, h, 255, 0};
+    return header;
+}
+
+/**
+ * Returns the size of one sample, 1 or 2 bytes.
+ * @param header The image header
+ */
+size_t ppm_sample_bytes(const struct ppm_header* header) {
+    return header->maxval > 255 ? 2 : 1;
+}
+
+/**
+ * Returns the size of one row of samples, in bytes.
+ * @param header The image header
+ */
+size_t ppm_row_bytes(const struct ppm_header* header) {
+    return (size_t)header->width * header->channels * ppm_sample_bytes(header);
+}
+
+/**
+ * Returns the size of all samples, in bytes.
+ * @param header The image header
+ */
+size_t ppm_data_bytes(const struct ppm_header* header) {
+    return ppm_row_bytes(header) * header->height;
+}
+
+/**
+ * Opens a PPM or PGM file and parses its header from as few reads as
+ * possible.
+ * @param filename The name of the file to open
+ * @param header Returns the parsed header
+ * @return The file, positioned at the first sample, or NULL if it cannot be
+ *         opened or its header is not valid
+ */
+static FILE* open_ppm(const char* filename, struct ppm_header* header) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return NULL;
+    }
+
+    // Headers are nearly always a few dozen bytes, so one read suffices;
+    // only very long comments make the buffer grow
+    unsigned char* buffer = NULL;
+    size_t length = 0;
+    int status = 1;
+    while (status == 1 && length < MAX_HEADER) {
+        unsigned char* grown = realloc(buffer, length + HEADER_CHUNK);
+        if (!grown) break;
+        buffer = grown;
+        size_t n = fread(buffer + length, 1, HEADER_CHUNK, fp);
+        length += n;
+        status = ppm_parse_header(buffer, length, header);
+        if (n < HEADER_CHUNK) break;
+    }
+    free(buffer);
+
+    if (status != 0) {
+        fprintf(stderr, "Unsupported PPM format in %s (only P5 and P6 are supported)\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+    if (fseek(fp, header->offset, SEEK_SET) != 0) {
+        fprintf(stderr, "File read error in %s\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+/**
+ * Reads rows of samples, converting 16-bit samples from the big-endian
+ * order of the file to host order.
+ * @param fp The file, positioned at the first sample of a row
+ * @param header The image header
+ * @param data Returns the samples; rows * ppm_row_bytes(header) long
+ * @param rows The number of rows to read
+ * @return 0 on success, or -1 if the file is too short
+ */
+static int read_samples(FILE* fp, const struct ppm_header* header, void* data, int rows) {
+    size_t bytes = ppm_row_bytes(header) * rows;
+    if (fread(data, 1, bytes, fp) != bytes) return -1;
+
+    if (ppm_sample_bytes(header) == 2) {
+        unsigned char* raw = data;
+        uint16_t* samples = data;
+        for (size_t i = 0; i < bytes / 2; i++) {
+            samples[i] = (raw[2 * i] << 8) | raw[2 * i + 1];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads rows of an image into 8-bit RGB pixels. P6 files with a maxval of
+ * 255 are read straight into the pixels; any other format is read and
+ * converted a row at a time.
+ * @param fp The file, positioned at the first sample of a row
+ * @param header The image header
+ * @param pixels Returns rows * width pixels
+ * @param rows The number of rows to read
+ * @return 0 on success, or -1 if the file is too short or memory runs out
+ */
+static int read_pixels(FILE* fp, const struct ppm_header* header, struct ppm_pixel* pixels, int rows) {
+    size_t width = header->width;
+    if (header->channels == 3 && header->maxval == 255) {
+        return fread(pixels, sizeof(struct ppm_pixel), width * rows, fp) == width * rows ? 0 : -1;
+    }
+
+    size_t rowBytes = ppm_row_bytes(header);
+    unsigned char* row = malloc(rowBytes);
+    if (!row) return -1;
+
+    int wide = ppm_sample_bytes(header) == 2;
+    int maxval = header->maxval;
+    for (int y = 0; y < rows; y++) {
+        if (fread(row, 1, rowBytes, fp) != rowBytes) {
+            free(row);
+            return -1;
+        }
+        struct ppm_pixel* out = pixels + y * width;
+        unsigned char* samples = (unsigned char*)out;
+        for (size_t i = 0; i < width * header->channels; i++) {
+            unsigned int v = wide ? (row[2 * i] << 8) | row[2 * i + 1] : row[i];
+            // Scale to 0..255 with rounding; a sample above maxval clamps
+            unsigned char scaled = v >= (unsigned int)maxval ? 255 : (v * 255 + maxval / 2) / maxval;
+            if (header->channels == 3) {
+                samples[i] = scaled;
+            } else {
+                out[i].red = out[i].green = out[i].blue = scaled;
+            }
+        }
+    }
+    free(row);
+    return 0;
+}
+
+/**
+ * Reads a P5 or P6 image without converting its samples.
+ * @param filename The name of the file to read
+ * @param image Returns the header and the samples
+ * @return 0 on success, or -1 if the file could not be read
+ */
+int ppm_load(const char* filename, struct ppm_image* image) {
+    image->data = NULL;
+    FILE* fp = open_ppm(filename, &image->header);
+    if (!fp) return -1;
+
+    image->data = malloc(ppm_data_bytes(&image->header));
+    if (!image->data) {
+        fprintf(stderr, "Failed to allocate memory for pixels\n");
+        fclose(fp);
+        return -1;
+    }
+    if (read_samples(fp, &image->header, image->data, image->header.height) != 0) {
+        fprintf(stderr, "File read error in %s\n", filename);
+        ppm_image_free(image);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Frees the samples of an image loaded with ppm_load.
+ * @param image The image to free
+ */
+void ppm_image_free(struct ppm_image* image) {
+    free(image->data);
+    image->data = NULL;
+}
+
+/**
+ * Reads a PPM image file and returns a flat array of 8-bit RGB pixels.
+ * Grey (P5) images are expanded to colour and samples of any maxval are
+ * scaled to 0..255.
+ *
+ * @param filename The name of the PPM file to read
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @return A flat array of ppm_pixel structures containing the image data,
+ *         or NULL if the file could not be read
+ */
+struct ppm_pixel* read_ppm(const char* filename, int* w, int* h) {
+    struct ppm_header header;
+    FILE* fp = open_ppm(filename, &header);
+    if (!fp) return NULL;
+
+    struct ppm_pixel* pixels = malloc((size_t)header.width * header.height * sizeof(struct ppm_pixel));
+    if (!pixels) {
+        fprintf(stderr, "Failed to allocate memory for pixels\n");
+        fclose(fp);
+        return NULL;
+    }
+    if (read_pixels(fp, &header, pixels, header.height) != 0) {
+        fprintf(stderr, "File read error in %s\n", filename);
+        free(pixels);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *w = header.width;
+    *h = header.height;
+    return pixels;
+}
+
+/**
+ * Allocates a contiguous 2D array of pixels: the row pointers and the rows
+ * share one block, so the whole image is also the 1D array pixels[0].
+ * @param w The width of the image
+ * @param h The height of the image
+ * @return The 2D array, or NULL if memory allocation fails
+ */
+struct ppm_pixel** alloc_ppm_2d(int w, int h) {
+    struct ppm_pixel** rows = malloc(h * sizeof(struct ppm_pixel*) +
+                                     (size_t)w * h * sizeof(struct ppm_pixel));
+    if (!rows) return NULL;
+
+    struct ppm_pixel* pixels = (struct ppm_pixel*)(rows + h);
+    for (int i = 0; i < h; i++) {
+        rows[i] = pixels + (size_t)i * w;
+    }
+    return rows;
+}
+
+/**
+ * Frees a 2D array returned by read_ppm_2d or alloc_ppm_2d.
+ * @param pixels The array to free
+ */
+void free_ppm_2d(struct ppm_pixel** pixels) {
+    free(pixels);
+}
+
+/**
+ * Reads a PPM image file and returns a contiguous 2D array of 8-bit RGB
+ * pixels, converted as by read_ppm.
+ *
+ * @param filename The name of the PPM file to read
+ * @param w Pointer to store the width of the image
+ * @param h Pointer to store the height of the image
+ * @return A 2D array of ppm_pixel structures containing the image data,
+ *         or NULL if the file could not be read
+ */
+struct ppm_pixel** read_ppm_2d(const char* filename, int* w, int* h) {
+    struct ppm_header header;
+    FILE* fp = open_ppm(filename, &header);
+    if (!fp) return NULL;
+
+    struct ppm_pixel** pixels = alloc_ppm_2d(header.width, header.height);
+    if (!pixels) {
+        fprintf(stderr, "Failed to allocate memory for pixels\n");
+        fclose(fp);
+        return NULL;
+    }
+    if (read_pixels(fp, &header, pixels[0], header.height) != 0) {
+        fprintf(stderr, "File read error in %s\n", filename);
+        free_ppm_2d(pixels);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *w = header.width;
+    *h = header.height;
+    return pixels;
+}
+
+/**
+ * Opens a PPM or PGM file for reading a band of rows at a time.
+ * @param reader The reader to open
+ * @param filename The name of the file to read
+ * @return 0 on success, or -1 if the file cannot be opened or its header
+ *         is not valid
+ */
+int ppm_reader_open(struct ppm_reader* reader, const char* filename) {
+    reader->fp = open_ppm(filename, &reader->header);
+    reader->row = 0;
+    if (!reader->fp) return -1;
+    reader->prefetched = reader->header.offset;
+
+    posix_fadvise(fileno(reader->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+}
+
+/**
+ * Asks the kernel to start reading the band after the one just read, so
+ * the disk works while the caller processes the current band.
+ * @param reader The reader
+ * @param rows The number of rows in a band
+ */
+static void prefetch_rows(struct ppm_reader* reader, int rows) {
+    size_t rowBytes = ppm_row_bytes(&reader->header);
+    off_t end = reader->header.offset + rowBytes * (size_t)reader->header.height;
+    off_t next = reader->header.offset + rowBytes * (size_t)(reader->row + 2 * rows);
+    if (next > end) next = end;
+    if (next > reader->prefetched) {
+        posix_fadvise(fileno(reader->fp), reader->prefetched, next - reader->prefetched, POSIX_FADV_WILLNEED);
+        reader->prefetched = next;
+    }
+}
+
+/**
+ * Reads the next band of rows without converting the samples.
+ * @param reader The reader
+ * @param data Returns the samples; rows * ppm_row_bytes(&reader->header) long
+ * @param rows The most rows to read
+ * @return The number of rows read, 0 at the end of the image, or -1 if the
+ *         file is too short
+ */
+int ppm_read_rows(struct ppm_reader* reader, void* data, int rows) {
+    if (rows > reader->header.height - reader->row) rows = reader->header.height - reader->row;
+    if (rows <= 0) return 0;
+
+    prefetch_rows(reader, rows);
+    if (read_samples(reader->fp, &reader->header, data, rows) != 0) return -1;
+    reader->row += rows;
+    return rows;
+}
+
+/**
+ * Reads the next band of rows as 8-bit RGB pixels, converted as by
+ * read_ppm.
+ * @param reader The reader
+ * @param pixels Returns rows * width pixels
+ * @param rows The most rows to read
+ * @return The number of rows read, 0 at the end of the image, or -1 if the
+ *         file is too short
+ */
+int ppm_read_pixels(struct ppm_reader* reader, struct ppm_pixel* pixels, int rows) {
+    if (rows > reader->header.height - reader->row) rows = reader->header.height - reader->row;
+    if (rows <= 0) return 0;
+
+    prefetch_rows(reader, rows);
+    if (read_pixels(reader->fp, &reader->header, pixels, rows) != 0) return -1;
+    reader->row += rows;
+    return rows;
+}
+
+/**
+ * Closes a reader.
+ * @param reader The reader to close; closing a reader that failed to open
+ *               does nothing
+ */
+void ppm_reader_close(struct ppm_reader* reader) {
+    if (reader->fp) fclose(reader->fp);
+    reader->fp = NULL;
+}
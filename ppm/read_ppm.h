@@ -0,0 +1,140 @@
+#ifndef PPM_READ_H_
+#define PPM_READ_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+struct ppm_pixel {
+  unsigned char red;
+  unsigned char green;
+  unsigned char blue;
+};
+
+// The header of a binary PPM (P6, colour) or PGM (P5, grey) file
+struct ppm_header {
+  int channels;    // 3 for P6, 1 for P5
+  int width;
+  int height;
+  int maxval;      // 1 to 65535; above 255 every sample takes two bytes
+  size_t offset;   // where the samples start in the file
+};
+
+// An image of any format the library reads. Samples are interleaved by
+// channel, row by row; 16-bit samples are held as uint16_t in host order.
+struct ppm_image {
+  struct ppm_header header;
+  void* data;
+};
+
+// the header of a P6 image of 8-bit samples, the format of ppm_pixel arrays
+extern struct ppm_header ppm_rgb_header(int w, int h);
+
+// parse the header at the start of a buffer
+// data: the first bytes of the file
+// length: the number of bytes available
+// header: returns the parsed header
+// returns 0 on success, 1 if the buffer ends before the header does, or -1
+// if the header is not valid
+extern int ppm_parse_header(const unsigned char* data, size_t length, struct ppm_header* header);
+
+// the size of one sample, 1 or 2 bytes
+extern size_t ppm_sample_bytes(const struct ppm_header* header);
+
+// the size of one row of samples, in bytes
+extern size_t ppm_row_bytes(const struct ppm_header* header);
+
+// the size of all samples, in bytes
+extern size_t ppm_data_bytes(const struct ppm_header* header);
+
+// read in a P5 or P6 file of 8- or 16-bit samples without converting it
+// filename: the image to load
+// image: returns the header and the samples
+// returns 0 on success, or -1 if the file cannot be loaded
+// NOTE: Caller is responsible for freeing the samples with ppm_image_free
+extern int ppm_load(const char* filename, struct ppm_image* image);
+
+// free the samples of an image loaded with ppm_load
+extern void ppm_image_free(struct ppm_image* image);
+
+// read in a PPM file in binary format
+// filename: the image to load
+// w: pointer argument for returning the width of the image
+// h: pointer argument for returning the height of the image
+// returns a 1D array of ppm_pixel, or NULL, if the file cannot be loaded;
+// grey images are expanded to colour and samples are scaled to 0..255
+// NOTE: Caller is responsible for freeing the returned array
+extern struct ppm_pixel* read_ppm(const char* filename, int* w, int* h);
+
+// read in a PPM file in binary format
+// filename: the image to load
+// w: pointer argument for returning the width of the image
+// h: pointer argument for returning the height of the image
+// returns a 2D array of ppm_pixel, or NULL, if the file cannot be loaded;
+// the rows are contiguous, so pixels[0] is also the whole image as a 1D array
+// NOTE: Caller is responsible for freeing the returned array with free_ppm_2d
+extern struct ppm_pixel** read_ppm_2d(const char* filename, int* w, int* h);
+
+// allocate a contiguous 2D array of ppm_pixel: one block holding the row
+// pointers followed by the rows, so pixels[0] is the whole image as a 1D array
+// returns the array, or NULL if the memory cannot be allocated
+// NOTE: Caller is responsible for freeing the returned array with free_ppm_2d
+extern struct ppm_pixel** alloc_ppm_2d(int w, int h);
+
+// free a 2D array returned by read_ppm_2d or alloc_ppm_2d
+extern void free_ppm_2d(struct ppm_pixel** pixels);
+
+// A PPM or PGM file open for reading a band of rows at a time, so images
+// larger than memory can be processed in constant space. The kernel is
+// asked to read ahead of each band while the caller works on it.
+struct ppm_reader {
+  FILE* fp;
+  struct ppm_header header;
+  int row;             // the next row to read
+  off_t prefetched;    // the file offset read ahead up to
+};
+
+// open a P5 or P6 file of 8- or 16-bit samples for streaming
+// returns 0 on success, or -1 if the file cannot be opened
+extern int ppm_reader_open(struct ppm_reader* reader, const char* filename);
+
+// read the next band of at most rows rows into data, which must hold
+// rows * ppm_row_bytes(&reader->header) bytes; samples are left in the
+// format of the file, with 16-bit samples in host order
+// returns the number of rows read, 0 at the end of the image, or -1 if the
+// file is too short
+extern int ppm_read_rows(struct ppm_reader* reader, void* data, int rows);
+
+// like ppm_read_rows, but returns rows * width 8-bit RGB pixels converted
+// as by read_ppm
+extern int ppm_read_pixels(struct ppm_reader* reader, struct ppm_pixel* pixels, int rows);
+
+// close a reader
+extern void ppm_reader_close(struct ppm_reader* reader);
+
+// A PPM file mapped into memory, whose pixels are used in place
+struct ppm_map {
+  void* base;      // start of the mapping
+  size_t length;   // length of the mapping in bytes
+};
+
+// map a PPM file in binary format into memory without copying its pixels
+// filename: the image to map; it must be P6 with 8-bit samples
+// w: pointer argument for returning the width of the image
+// h: pointer argument for returning the height of the image
+// map: returns the mapping that holds the pixels
+// returns a read-only 1D array of ppm_pixel inside the mapping, or NULL, if
+// the file cannot be mapped
+// NOTE: Caller must release the mapping with unmap_ppm, not free
+extern const struct ppm_pixel* map_ppm(const char* filename, int* w, int* h, struct ppm_map* map);
+
+// like map_ppm, but the pixels may be modified: the mapping is private and
+// copy-on-write, so only the pages that are written are copied and the file
+// itself never changes
+// NOTE: Caller must release the mapping with unmap_ppm, not free
+extern struct ppm_pixel* map_ppm_private(const char* filename, int* w, int* h, struct ppm_map* map);
+
+// release a mapping made by map_ppm or map_ppm_private
+extern void unmap_ppm(struct ppm_map* map);
+
+#endif
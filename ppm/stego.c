@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include "read_ppm.h"
+#include "write_ppm.h"
+#include "stego.h"
+
+/**
+ * LSB Steganography
+ *
+ * Packs and unpacks one bit per sample without a loop per bit. With AVX2,
+ * extracting shifts each LSB to the top of its byte and gathers 32 of them
+ * with one movemask, and embedding broadcasts 4 bytes of data, spreads
+ * each byte over 8 lanes with a shuffle and tests one bit per lane. With
+ * only BMI2, pext and pdep move the 8 bits of a byte to and from the LSBs
+ * of a 64-bit word. The byte order within each group of 8 samples is
+ * reversed first, since the first sample carries the most significant bit.
+ * The plain C loops handle the rest and other CPUs, with the same result.
+ *
+ * Whole files are hidden as a stream of header, payload and checksum that
+ * is produced a band of carrier rows at a time, so neither the carrier nor
+ * the payload is ever held in memory. Reading data back reads only the
+ * samples that hold it, at their offsets, so it costs time in proportion to
+ * the data rather than the image.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define LSBS 0x0101010101010101ULL
+
+// Reverses the bytes within each group of 8, in each 128-bit lane
+static const unsigned char REVERSE_GROUPS[32] = {
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+};
+
+// Spreads byte j of each lane over lanes 8j to 8j + 7, for j in 0..1
+static const unsigned char SPREAD[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+
+// The bit of its byte that each lane carries, most significant first
+static const unsigned char BITS[32] = {
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+};
+
+/**
+ * Returns the number of bytes that fit in the LSBs of an image.
+ *
+ * @param w The width of the image
+ * @param h The height of the image
+ * @return The capacity in bytes
+ */
+size_t stego_capacity(int w, int h) {
+    return (size_t)w * h * 3 / 8;
+}
+
+/**
+ * Embeds bytes [from, length) one bit at a time.
+ */
+static void embed_scalar(unsigned char* samples, const unsigned char* data, size_t from, size_t length) {
+    for (size_t i = from; i < length; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            unsigned char* sample = &samples[8 * i + bit];
+            *sample = (*sample & ~1) | ((data[i] >> (7 - bit)) & 1);
+        }
+    }
+}
+
+/**
+ * Extracts bytes [from, length) one bit at a time.
+ */
+static void extract_scalar(const unsigned char* samples, unsigned char* data, size_t from, size_t length) {
+    for (size_t i = from; i < length; i++) {
+        unsigned char byte = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            byte = (byte << 1) | (samples[8 * i + bit] & 1);
+        }
+        data[i] = byte;
+    }
+}
+
+/**
+ * Embeds 4 bytes a step into 32 samples.
+ * @return The number of bytes done
+ */
+__attribute__((target("avx2")))
+static size_t embed_avx2(unsigned char* samples, const unsigned char* data, size_t length) {
+    const __m256i spread = _mm256_loadu_si256((const __m256i*)SPREAD);
+    const __m256i bits = _mm256_loadu_si256((const __m256i*)BITS);
+    const __m256i keep = _mm256_set1_epi8((char)0xfe);
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+        __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+        __m256i* out = (__m256i*)(samples + 8 * i);
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256(out), keep);
+        _mm256_storeu_si256(out, _mm256_or_si256(v, _mm256_and_si256(set, one)));
+    }
+    return i;
+}
+
+/**
+ * Extracts 4 bytes a step from 32 samples.
+ * @return The number of bytes done
+ */
+__attribute__((target("avx2")))
+static size_t extract_avx2(const unsigned char* samples, unsigned char* data, size_t length) {
+    const __m256i reverse = _mm256_loadu_si256((const __m256i*)REVERSE_GROUPS);
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(samples + 8 * i));
+        v = _mm256_slli_epi16(_mm256_shuffle_epi8(v, reverse), 7);
+        uint32_t word = _mm256_movemask_epi8(v);
+        memcpy(data + i, &word, 4);
+    }
+    return i;
+}
+
+/**
+ * Embeds a byte a step into 8 samples with pdep.
+ * @return The number of bytes done
+ */
+__attribute__((target("bmi2")))
+static size_t embed_bmi2(unsigned char* samples, const unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint64_t word;
+        memcpy(&word, samples + 8 * i, 8);
+        word = (word & ~LSBS) | __builtin_bswap64(_pdep_u64(data[i], LSBS));
+        memcpy(samples + 8 * i, &word, 8);
+    }
+    return length;
+}
+
+/**
+ * Extracts a byte a step from 8 samples with pext.
+ * @return The number of bytes done
+ */
+__attribute__((target("bmi2")))
+static size_t extract_bmi2(const unsigned char* samples, unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint64_t word;
+        memcpy(&word, samples + 8 * i, 8);
+        data[i] = _pext_u64(__builtin_bswap64(word), LSBS);
+    }
+    return length;
+}
+
+/**
+ * Hides bytes in the LSBs of samples, most significant bit first.
+ *
+ * @param samples The samples, 8 per byte of data, changed in place
+ * @param data The data
+ * @param length The number of bytes of data
+ */
+void stego_embed(unsigned char* samples, const void* data, size_t length) {
+    size_t done = 0;
+    if (__builtin_cpu_supports("avx2")) {
+        done = embed_avx2(samples, data, length);
+    } else if (__builtin_cpu_supports("bmi2")) {
+        done = embed_bmi2(samples, data, length);
+    }
+    embed_scalar(samples, data, done, length);
+}
+
+/**
+ * Gathers bytes from the LSBs of samples, most significant bit first.
+ *
+ * @param samples The samples, 8 per byte of data
+ * @param data Returns the data
+ * @param length The number of bytes of data
+ */
+void stego_extract(const unsigned char* samples, void* data, size_t length) {
+    size_t done = 0;
+    if (__builtin_cpu_supports("avx2")) {
+        done = extract_avx2(samples, data, length);
+    } else if (__builtin_cpu_supports("bmi2")) {
+        done = extract_bmi2(samples, data, length);
+    }
+    extract_scalar(samples, data, done, length);
+}
+
+#define STEGO_MAGIC "LSB1"
+#define BAND_BYTES (1 << 20)   // carrier samples read and written at a time
+#define MAX_HEADER (1 << 20)   // the longest image header read, comments and all
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void make_crc_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        crcTable[i] = c;
+    }
+}
+
+/**
+ * Updates a CRC-32 (the zlib checksum) with more data, a byte at a time
+ * from a table.
+ *
+ * @param crc The CRC so far, 0 to start
+ * @param data The data
+ * @param length The number of bytes of data
+ * @return The updated CRC
+ */
+uint32_t stego_crc32(uint32_t crc, const void* data, size_t length) {
+    pthread_once(&crcOnce, make_crc_table);
+    const unsigned char* bytes = data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * Returns the largest payload that fits in an image.
+ *
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param channels The samples per pixel
+ * @return The capacity in bytes, or 0 if not even the header fits
+ */
+uint64_t stego_payload_capacity(int w, int h, int channels) {
+    uint64_t bytes = (uint64_t)w * h * channels / 8;
+    return bytes > STEGO_HEADER + STEGO_TRAILER ? bytes - STEGO_HEADER - STEGO_TRAILER : 0;
+}
+
+static void put_be(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--, value >>= 8) {
+        out[i] = value & 0xff;
+    }
+}
+
+static uint64_t get_be(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = value << 8 | in[i];
+    }
+    return value;
+}
+
+// The bytes hidden in a carrier: header, payload and checksum in turn
+struct payload_stream {
+    unsigned char header[STEGO_HEADER];
+    unsigned char trailer[STEGO_TRAILER];
+    uint64_t length;     // bytes of payload
+    uint64_t position;   // bytes of the stream so far
+    uint32_t crc;        // of the payload so far
+    FILE* fp;            // the payload being read or written
+};
+
+static uint64_t stream_total(const struct payload_stream* stream) {
+    return STEGO_HEADER + stream->length + STEGO_TRAILER;
+}
+
+/**
+ * Produces the next bytes of a stream to embed, reading the payload as it
+ * goes.
+ * @return The number of bytes produced, less than count only at the end of
+ *         the stream, or -1 if the payload cannot be read
+ */
+static long produce(struct payload_stream* stream, unsigned char* out, size_t count) {
+    size_t n = 0;
+    uint64_t end = STEGO_HEADER + stream->length;
+    while (n < count && stream->position < stream_total(stream)) {
+        uint64_t pos = stream->position;
+        size_t take;
+        if (pos < STEGO_HEADER) {
+            take = STEGO_HEADER - pos < count - n ? STEGO_HEADER - pos : count - n;
+            memcpy(out + n, stream->header + pos, take);
+        } else if (pos < end) {
+            take = end - pos < count - n ? end - pos : count - n;
+            if (fread(out + n, 1, take, stream->fp) != take) return -1;
+            stream->crc = stego_crc32(stream->crc, out + n, take);
+        } else {
+            put_be(stream->trailer, stream->crc, STEGO_TRAILER);
+            take = stream_total(stream) - pos < count - n ? stream_total(stream) - pos : count - n;
+            memcpy(out + n, stream->trailer + (pos - end), take);
+        }
+        n += take;
+        stream->position += take;
+    }
+    return n;
+}
+
+/**
+ * Consumes the next bytes extracted from a carrier, checking the header
+ * and checksum and writing the payload as it goes.
+ * @param capacity The largest payload the carrier can hold
+ * @return 1 once the stream is complete and valid, 0 if more is needed,
+ *         or -1 if the stream is not valid or the payload cannot be written
+ */
+static int consume(struct payload_stream* stream, const unsigned char* in, size_t count,
+                   uint64_t capacity) {
+    size_t n = 0;
+    while (n < count) {
+        uint64_t pos = stream->position;
+        uint64_t end = STEGO_HEADER + stream->length;
+        size_t take;
+        if (pos < STEGO_HEADER) {
+            take = STEGO_HEADER - pos < count - n ? STEGO_HEADER - pos : count - n;
+            memcpy(stream->header + pos, in + n, take);
+            if (pos + take == STEGO_HEADER) {
+                stream->length = get_be(stream->header + 4, 8);
+                if (memcmp(stream->header, STEGO_MAGIC, 4) != 0 || stream->length > capacity) {
+                    fprintf(stderr, "No payload found\n");
+                    return -1;
+                }
+            }
+        } else if (pos < end) {
+            take = end - pos < count - n ? end - pos : count - n;
+            if (fwrite(in + n, 1, take, stream->fp) != take) {
+                fprintf(stderr, "Unable to write the payload\n");
+                return -1;
+            }
+            stream->crc = stego_crc32(stream->crc, in + n, take);
+        } else {
+            take = stream_total(stream) - pos < count - n ? stream_total(stream) - pos : count - n;
+            memcpy(stream->trailer + (pos - end), in + n, take);
+            if (pos + take == stream_total(stream)) {
+                if (get_be(stream->trailer, STEGO_TRAILER) != stream->crc) {
+                    fprintf(stderr, "Payload checksum does not match\n");
+                    return -1;
+                }
+                return 1;
+            }
+        }
+        n += take;
+        stream->position += take;
+    }
+    return 0;
+}
+
+/**
+ * Opens a carrier for streaming, allocating a band of rows and room for
+ * the data it holds; every band but the last holds a multiple of 8
+ * samples, so no byte of data spans bands.
+ * @param rows Returns the rows in a band
+ * @param data Returns room for the data of a band
+ * @return The band, or NULL if the carrier cannot be used
+ */
+static unsigned char* open_carrier(struct ppm_reader* reader, const char* filename, int* rows,
+                                   unsigned char** data) {
+    if (ppm_reader_open(reader, filename) != 0) return NULL;
+    if (ppm_sample_bytes(&reader->header) != 1) {
+        fprintf(stderr, "Only 8-bit samples can carry a payload in %s\n", filename);
+        ppm_reader_close(reader);
+        return NULL;
+    }
+    // Wide rows make a band of 8 rows larger than BAND_BYTES
+    size_t rowBytes = ppm_row_bytes(&reader->header);
+    *rows = (BAND_BYTES / rowBytes) & ~7;
+    if (*rows < 8) *rows = 8;
+    unsigned char* band = malloc((size_t)*rows * rowBytes);
+    *data = malloc((size_t)*rows * rowBytes / 8 + 1);
+    if (!band || !*data) {
+        fprintf(stderr, "Failed to allocate memory for %s\n", filename);
+        ppm_reader_close(reader);
+        free(band);
+        free(*data);
+        return NULL;
+    }
+    return band;
+}
+
+/**
+ * Hides a file in a copy of a carrier, one band of rows at a time.
+ *
+ * @param carrier The image to hide the file in
+ * @param payload The file to hide
+ * @param output The image written with the file hidden in it
+ * @return 0 on success, or -1 if a file cannot be used or the payload
+ *         does not fit
+ */
+int stego_embed_file(const char* carrier, const char* payload, const char* output) {
+    struct payload_stream stream = {{0}};
+    stream.fp = fopen(payload, "rb");
+    if (!stream.fp) {
+        fprintf(stderr, "Unable to open file %s\n", payload);
+        return -1;
+    }
+    if (fseeko(stream.fp, 0, SEEK_END) != 0 || (stream.length = ftello(stream.fp)) == (uint64_t)-1 ||
+        fseeko(stream.fp, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "Unable to find the size of %s\n", payload);
+        fclose(stream.fp);
+        return -1;
+    }
+    memcpy(stream.header, STEGO_MAGIC, 4);
+    put_be(stream.header + 4, stream.length, 8);
+
+    struct ppm_reader reader;
+    int bandRows;
+    unsigned char* data;
+    unsigned char* band = open_carrier(&reader, carrier, &bandRows, &data);
+    if (!band) {
+        fclose(stream.fp);
+        return -1;
+    }
+    const struct ppm_header* header = &reader.header;
+    uint64_t capacity = stego_payload_capacity(header->width, header->height, header->channels);
+    struct ppm_writer writer = {NULL};
+    int status = 0;
+    if (stream.length > capacity) {
+        fprintf(stderr, "Payload of %llu bytes does not fit in %s, which holds %llu\n",
+                (unsigned long long)stream.length, carrier, (unsigned long long)capacity);
+        status = -1;
+    } else if (ppm_writer_open(&writer, output, header) != 0) {
+        status = -1;
+    }
+
+    int rows;
+    while (status == 0 && (rows = ppm_read_rows(&reader, band, bandRows)) > 0) {
+        size_t bytes = (size_t)rows * ppm_row_bytes(header) / 8;
+        long produced = produce(&stream, data, bytes);
+        if (produced < 0) {
+            fprintf(stderr, "File read error in %s\n", payload);
+            status = -1;
+        } else {
+            stego_embed(band, data, produced);
+            status = ppm_write_rows(&writer, band, rows);
+        }
+    }
+    if (status == 0 && rows < 0) status = -1;
+    if (writer.fp && ppm_writer_close(&writer) != 0) status = -1;
+    if (status != 0 && writer.fp) remove(output);
+
+    ppm_reader_close(&reader);
+    fclose(stream.fp);
+    free(band);
+    free(data);
+    return status;
+}
+
+/**
+ * Recovers a file hidden by stego_embed_file. The header is read first;
+ * once it gives the length, the kernel is asked to read just the samples
+ * that hold the rest, so nothing past the checksum is ever read.
+ *
+ * @param carrier The image holding the file
+ * @param output Where the file is written, or "-" for stdout
+ * @return 0 on success, or -1 if a file cannot be used, there is no
+ *         payload or the checksum does not match
+ */
+int stego_extract_file(const char* carrier, const char* output) {
+    struct stego_reader reader;
+    if (stego_reader_open(&reader, carrier) != 0) return -1;
+    uint64_t capacity = reader.capacity > STEGO_HEADER + STEGO_TRAILER ?
+                        reader.capacity - STEGO_HEADER - STEGO_TRAILER : 0;
+
+    int toStdout = strcmp(output, "-") == 0;
+    struct payload_stream stream = {{0}};
+    stream.fp = toStdout ? stdout : fopen(output, "wb");
+    unsigned char* data = malloc(BAND_BYTES / 8);
+    if (!stream.fp || !data) {
+        if (!stream.fp) fprintf(stderr, "Unable to open file %s for writing\n", output);
+        if (stream.fp && !toStdout) fclose(stream.fp);
+        stego_reader_close(&reader);
+        free(data);
+        return -1;
+    }
+
+    int status = 0;
+    while (status == 0) {
+        uint64_t position = stream.position;
+        uint64_t left = position < STEGO_HEADER ? STEGO_HEADER - position : stream_total(&stream) - position;
+        long got = stego_read(&reader, position, data, left < BAND_BYTES / 8 ? left : BAND_BYTES / 8);
+        if (got <= 0) {
+            if (got == 0) fprintf(stderr, "No payload found in %s\n", carrier);
+            status = -1;
+            break;
+        }
+        status = consume(&stream, data, got, capacity);
+        if (status == 0 && position < STEGO_HEADER && stream.position >= STEGO_HEADER) {
+            off_t start = reader.header.offset + 8 * stream.position;
+            posix_fadvise(reader.fd, start, 8 * (stream_total(&stream) - stream.position), POSIX_FADV_WILLNEED);
+        }
+    }
+    status = status == 1 ? 0 : -1;
+
+    if (toStdout) {
+        if (fflush(stdout) != 0) status = -1;
+    } else {
+        if (fclose(stream.fp) != 0) status = -1;
+        if (status != 0) remove(output);
+    }
+    stego_reader_close(&reader);
+    free(data);
+    return status;
+}
+
+/**
+ * Opens a carrier for reading data from its LSBs, reading only its header.
+ * Read-ahead is turned off, since the samples wanted are usually a small
+ * prefix of the image.
+ *
+ * @param reader The reader
+ * @param filename The image
+ * @return 0 on success, or -1 if the file cannot be used
+ */
+int stego_reader_open(struct stego_reader* reader, const char* filename) {
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return -1;
+    }
+    posix_fadvise(reader->fd, 0, 0, POSIX_FADV_RANDOM);
+
+    // Headers are a few dozen bytes unless they hold long comments
+    unsigned char* buffer = NULL;
+    int parsed = 1;
+    for (size_t size = 256; parsed == 1 && size <= MAX_HEADER; size *= 4) {
+        unsigned char* larger = realloc(buffer, size);
+        if (!larger) break;
+        buffer = larger;
+        ssize_t got = pread(reader->fd, buffer, size, 0);
+        if (got < 0) break;
+        parsed = ppm_parse_header(buffer, got, &reader->header);
+        if ((size_t)got < size) break;
+    }
+    free(buffer);
+
+    if (parsed != 0 || ppm_sample_bytes(&reader->header) != 1) {
+        fprintf(stderr, "Unsupported PPM format in %s (only 8-bit P5 and P6 can carry data)\n", filename);
+        close(reader->fd);
+        return -1;
+    }
+    reader->capacity = ppm_data_bytes(&reader->header) / 8;
+    return 0;
+}
+
+/**
+ * Gathers bytes of the data in the LSBs of a carrier, reading their
+ * samples a band at a time.
+ *
+ * @param reader The reader
+ * @param offset The first byte of data
+ * @param data Returns the bytes
+ * @param length The number of bytes
+ * @return The number of bytes read, fewer than length only at the end of
+ *         the capacity, or -1 if the file is too short
+ */
+long stego_read(struct stego_reader* reader, size_t offset, void* data, size_t length) {
+    if (offset >= reader->capacity) return 0;
+    if (length > reader->capacity - offset) length = reader->capacity - offset;
+    size_t chunk = length < BAND_BYTES / 8 ? length : BAND_BYTES / 8;
+    unsigned char* samples = malloc(8 * chunk > 0 ? 8 * chunk : 1);
+    if (!samples) {
+        fprintf(stderr, "Failed to allocate memory for samples\n");
+        return -1;
+    }
+
+    for (size_t done = 0; done < length; done += chunk) {
+        if (chunk > length - done) chunk = length - done;
+        off_t start = reader->header.offset + 8 * (offset + done);
+        if (pread(reader->fd, samples, 8 * chunk, start) != (ssize_t)(8 * chunk)) {
+            fprintf(stderr, "File is shorter than its header says\n");
+            free(samples);
+            return -1;
+        }
+        stego_extract(samples, (unsigned char*)data + done, chunk);
+    }
+    free(samples);
+    return length;
+}
+
+/**
+ * Closes a reader.
+ * @param reader The reader
+ */
+void stego_reader_close(struct stego_reader* reader) {
+    close(reader->fd);
+    reader->fd = -1;
+}
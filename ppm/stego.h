@@ -0,0 +1,74 @@
+#ifndef stego_H_
+#define stego_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "read_ppm.h"
+
+// Steganography in the least significant bits (LSBs) of image samples:
+// each byte of data is spread over eight samples, one bit in each, most
+// significant bit first, and the upper seven bits of every sample are kept.
+
+// the number of bytes that fit in the LSBs of a w x h image
+extern size_t stego_capacity(int w, int h);
+
+// hide length bytes of data in the LSBs of the first 8 * length samples
+extern void stego_embed(unsigned char* samples, const void* data, size_t length);
+
+// gather length bytes from the LSBs of the first 8 * length samples
+extern void stego_extract(const unsigned char* samples, void* data, size_t length);
+
+// A carrier opened for reading only the samples that hold the data asked
+// for, so short messages cost a few reads however large the image is
+struct stego_reader {
+  int fd;
+  struct ppm_header header;
+  size_t capacity;   // the bytes of data the samples can hold
+};
+
+// open a P5 or P6 file of 8-bit samples, reading only its header
+// returns 0 on success, or -1 if the file cannot be used
+extern int stego_reader_open(struct stego_reader* reader, const char* filename);
+
+// gather bytes [offset, offset + length) of the data in the LSBs, reading
+// only their 8 * length samples
+// returns the number of bytes read, fewer than length only at the end of
+// the capacity, or -1 if the file is shorter than its header says
+extern long stego_read(struct stego_reader* reader, size_t offset, void* data, size_t length);
+
+// close a reader
+extern void stego_reader_close(struct stego_reader* reader);
+
+// Payloads: any file, hidden as a header of the magic "LSB1" and the
+// payload length (8 bytes, big-endian), then the payload, then its CRC-32
+// (4 bytes, big-endian; the zlib checksum), so the payload may hold any
+// bytes and is checked when it is extracted. Carriers are P5 or P6 files of
+// 8-bit samples and are streamed a band of rows at a time, as is the
+// payload, so files of any size take a few megabytes of memory.
+#define STEGO_HEADER 12
+#define STEGO_TRAILER 4
+
+// update a CRC-32 with more data; start from 0
+extern uint32_t stego_crc32(uint32_t crc, const void* data, size_t length);
+
+// the largest payload that fits in the LSBs of a w x h image of channels
+// samples per pixel, or 0 if not even the header fits
+extern uint64_t stego_payload_capacity(int w, int h, int channels);
+
+// hide a file in a copy of a carrier image
+// carrier: the image; it is not changed
+// payload: the file to hide
+// output: the image with the payload, written in the format of the carrier
+// returns 0 on success, or -1 if a file cannot be used or the payload does
+// not fit, with the reason printed
+extern int stego_embed_file(const char* carrier, const char* payload, const char* output);
+
+// recover a file hidden by stego_embed_file; only the samples holding the
+// header are read before the length is known, then only those holding the
+// rest
+// output: where the payload is written, or "-" for stdout
+// returns 0 on success, or -1 if a file cannot be used, the carrier holds no
+// payload or the checksum does not match, with the reason printed
+extern int stego_extract_file(const char* carrier, const char* output);
+
+#endif
@@ -0,0 +1,636 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "read_ppm.h"
+#include "write_ppm.h"
+#include "async_ppm.h"
+#include "qoi.h"
+#include "tiled.h"
+#include "pyramid.h"
+#include "imageops.h"
+#include "stego.h"
+
+#define TEST_FILE "test_ppm.tmp"
+
+void check(int expr, const char* message) {
+  if (!expr) {
+    printf("%s: FAILED\n", message);
+    exit(1);
+  }
+  else {
+    printf("%s: PASSED\n", message);
+  }
+}
+
+// write raw bytes to the test file
+void write_bytes(const void* bytes, size_t length) {
+  FILE* fp = fopen(TEST_FILE, "wb");
+  fwrite(bytes, 1, length, fp);
+  fclose(fp);
+}
+
+int main(int argc, char* argv[])
+{
+  printf("Running tests...\n");
+  int w, h;
+
+  // Header parsing
+  struct ppm_header header;
+  const char* text = "P6\n# a comment\n3 2\n# another\n255\nxyz";
+  check(ppm_parse_header((const unsigned char*)text, strlen(text), &header) == 0, "test 1: header with comments");
+  check(header.width == 3 && header.height == 2 && header.maxval == 255 && header.channels == 3,
+        "test 2: header fields");
+  check(header.offset == strlen(text) - 3, "test 3: samples start after one whitespace");
+  check(ppm_parse_header((const unsigned char*)text, 18, &header) == 1, "test 4: partial header needs more bytes");
+  check(ppm_parse_header((const unsigned char*)"P3\n1 1\n255\n", 11, &header) == -1, "test 5: ASCII format rejected");
+  check(ppm_parse_header((const unsigned char*)"P6\n1 1\n70000\n", 13, &header) == -1, "test 6: maxval above 65535 rejected");
+
+  // 8-bit P6 through the flat reader and writer
+  struct ppm_pixel pixels[6];
+  for (int i = 0; i < 6; i++) {
+    pixels[i].red = i * 40;
+    pixels[i].green = 255 - i;
+    pixels[i].blue = i;
+  }
+  write_ppm(TEST_FILE, pixels, 3, 2);
+  struct ppm_pixel* flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && w == 3 && h == 2, "test 7: read_ppm size");
+  check(memcmp(flat, pixels, sizeof(pixels)) == 0, "test 8: read_ppm pixels round trip");
+  free(flat);
+
+  // Contiguous 2D arrays
+  struct ppm_pixel** rows = read_ppm_2d(TEST_FILE, &w, &h);
+  check(rows != NULL && w == 3 && h == 2, "test 9: read_ppm_2d size");
+  check(rows[1] == rows[0] + 3, "test 10: rows are contiguous");
+  check(memcmp(rows[0], pixels, sizeof(pixels)) == 0, "test 11: read_ppm_2d pixels");
+  rows[1][2].red = 7;
+  write_ppm_2d(TEST_FILE, rows, w, h);
+  free_ppm_2d(rows);
+  rows = read_ppm_2d(TEST_FILE, &w, &h);
+  check(rows != NULL && rows[1][2].red == 7 && rows[0][1].green == 254, "test 12: write_ppm_2d round trip");
+
+  struct ppm_pixel* scattered[2] = {pixels + 3, pixels};
+  write_ppm_2d(TEST_FILE, scattered, 3, 2);
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && flat[0].red == 120 && flat[3].red == 0, "test 13: write_ppm_2d with scattered rows");
+  free(flat);
+  write_ppm_2d(TEST_FILE, rows, w, h);
+  free_ppm_2d(rows);
+
+  // Memory-mapped views
+  struct ppm_map map;
+  const struct ppm_pixel* mapped = map_ppm(TEST_FILE, &w, &h, &map);
+  check(mapped != NULL && w == 3 && h == 2 && mapped[5].red == 7, "test 14: map_ppm pixels");
+  unmap_ppm(&map);
+  struct ppm_pixel* patched = map_ppm_private(TEST_FILE, &w, &h, &map);
+  patched[0].red = 99;
+  unmap_ppm(&map);
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && flat[0].red == 0, "test 15: copy-on-write leaves the file unchanged");
+  free(flat);
+
+  // P5 grey images are expanded to colour
+  const unsigned char grey[] = "P5\n2 1\n255\n\x10\xf0";
+  write_bytes(grey, sizeof(grey) - 1);
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && w == 2 && h == 1, "test 16: P5 size");
+  check(flat[0].red == 0x10 && flat[0].green == 0x10 && flat[1].blue == 0xf0, "test 17: P5 expanded to colour");
+  free(flat);
+  check(map_ppm(TEST_FILE, &w, &h, &map) == NULL, "test 18: P5 cannot be mapped");
+
+  // Samples of other maxvals are scaled
+  const unsigned char low[] = "P6\n1 1\n15\n\x00\x0f\x08";
+  write_bytes(low, sizeof(low) - 1);
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && flat[0].red == 0 && flat[0].green == 255 && flat[0].blue == 136, "test 19: maxval 15 scaled");
+  free(flat);
+
+  // 16-bit samples keep their full precision through ppm_load and ppm_save
+  uint16_t deep[6] = {0, 1, 300, 65535, 32768, 12345};
+  struct ppm_image image;
+  image.header.channels = 3;
+  image.header.width = 2;
+  image.header.height = 1;
+  image.header.maxval = 65535;
+  image.data = deep;
+  check(ppm_save(TEST_FILE, &image) == 0, "test 20: 16-bit save");
+  struct ppm_image loaded;
+  check(ppm_load(TEST_FILE, &loaded) == 0, "test 21: 16-bit load");
+  check(loaded.header.maxval == 65535 && ppm_data_bytes(&loaded.header) == sizeof(deep), "test 22: 16-bit header");
+  check(memcmp(loaded.data, deep, sizeof(deep)) == 0, "test 23: 16-bit samples round trip");
+  ppm_image_free(&loaded);
+
+  FILE* fp = fopen(TEST_FILE, "rb");
+  unsigned char raw[32];
+  size_t n = fread(raw, 1, sizeof(raw), fp);
+  fclose(fp);
+  check(n == 13 + 12 && raw[13 + 4] == 0x01 && raw[13 + 5] == 0x2c, "test 24: 16-bit samples stored big-endian");
+
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && flat[0].blue == 1 && flat[1].red == 255 && flat[1].green == 128, "test 25: 16-bit scaled to 8-bit");
+  free(flat);
+
+  // 8-bit P5 through ppm_load and ppm_save
+  unsigned char bytes[4] = {1, 2, 3, 4};
+  image.header.channels = 1;
+  image.header.maxval = 255;
+  image.header.height = 2;
+  image.data = bytes;
+  check(ppm_save(TEST_FILE, &image) == 0 && ppm_load(TEST_FILE, &loaded) == 0, "test 26: P5 save and load");
+  check(loaded.header.channels == 1 && memcmp(loaded.data, bytes, 4) == 0, "test 27: P5 samples round trip");
+  ppm_image_free(&loaded);
+
+  // Streaming a band of rows at a time
+  uint16_t band[2 * 3 * 3];
+  image.header.channels = 3;
+  image.header.width = 3;
+  image.header.height = 5;
+  image.header.maxval = 1000;
+  struct ppm_writer writer;
+  check(ppm_writer_open(&writer, TEST_FILE, &image.header) == 0, "test 28: writer open");
+  for (int y = 0; y < 5; y += 2) {
+    int rows = y + 2 <= 5 ? 2 : 1;
+    for (int i = 0; i < rows * 9; i++) {
+      band[i] = y * 100 + i;
+    }
+    check(ppm_write_rows(&writer, band, rows) == 0, "test 29: write a band");
+  }
+  check(ppm_write_rows(&writer, band, 1) == -1, "test 30: no rows past the end");
+  check(ppm_writer_close(&writer) == 0, "test 31: writer close");
+
+  struct ppm_reader reader;
+  check(ppm_reader_open(&reader, TEST_FILE) == 0 && reader.header.height == 5, "test 32: reader open");
+  int total = 0, ok = 1, got;
+  while ((got = ppm_read_rows(&reader, band, 2)) > 0) {
+    for (int i = 0; i < got * 9; i++) {
+      ok = ok && band[i] == total * 100 + i;
+    }
+    total += got;
+  }
+  check(got == 0 && total == 5 && ok, "test 33: read every band back");
+  ppm_reader_close(&reader);
+
+  struct ppm_pixel line[3];
+  check(ppm_reader_open(&reader, TEST_FILE) == 0 && ppm_read_pixels(&reader, line, 1) == 1, "test 34: read pixels");
+  check(line[0].red == 0 && line[2].blue == 2, "test 35: streamed pixels scaled");
+  ppm_reader_close(&reader);
+
+  check(ppm_writer_open(&writer, TEST_FILE, &image.header) == 0 && ppm_write_rows(&writer, band, 2) == 0 &&
+        ppm_writer_close(&writer) == -1, "test 36: closing a short image fails");
+
+  // Bands written out of order at their own offsets
+  struct ppm_band_writer bands;
+  struct ppm_header rgb = ppm_rgb_header(3, 2);
+  check(ppm_band_writer_open(&bands, TEST_FILE, &rgb) == 0, "test 37: band writer open");
+  check(ppm_write_band(&bands, 1, pixels + 3, 1) == 0 && ppm_write_band(&bands, 0, pixels, 1) == 0,
+        "test 38: write bands out of order");
+  check(ppm_write_band(&bands, 2, pixels, 1) == -1, "test 39: no band past the end");
+  check(ppm_band_writer_close(&bands) == 0, "test 40: band writer close");
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && w == 3 && h == 2 && memcmp(flat, pixels, sizeof(pixels)) == 0, "test 41: bands read back");
+  free(flat);
+
+  image.header.channels = 1;
+  image.header.width = 3;
+  image.header.height = 2;
+  image.header.maxval = 4095;
+  check(ppm_band_writer_open(&bands, TEST_FILE, &image.header) == 0 &&
+        ppm_write_band(&bands, 1, deep + 3, 1) == 0 && ppm_write_band(&bands, 0, deep, 1) == 0 &&
+        ppm_band_writer_close(&bands) == 0 && ppm_load(TEST_FILE, &loaded) == 0, "test 42: 16-bit bands");
+  check(memcmp(loaded.data, deep, sizeof(deep)) == 0, "test 43: 16-bit bands read back");
+  ppm_image_free(&loaded);
+
+  // Malformed files are rejected
+  const unsigned char shortFile[] = "P6\n4 4\n255\nabc";
+  write_bytes(shortFile, sizeof(shortFile) - 1);
+  check(read_ppm(TEST_FILE, &w, &h) == NULL, "test 44: truncated file rejected");
+  check(map_ppm(TEST_FILE, &w, &h, &map) == NULL, "test 45: truncated file not mapped");
+  check(read_ppm("no-such-file.ppm", &w, &h) == NULL, "test 46: missing file");
+
+  // Images saved and loaded in the background, in order
+  struct ppm_saver saver;
+  struct ppm_async_image queued = {malloc(sizeof(pixels)), 3, 2, {NULL, 0}};
+  memcpy(queued.pixels, pixels, sizeof(pixels));
+  check(ppm_saver_open(&saver, 1) == 0 && ppm_saver_submit(&saver, TEST_FILE, &queued) == 0 &&
+        queued.pixels == NULL, "test 47: saver takes the image");
+  check(ppm_saver_submit(&saver, TEST_FILE, &queued) == -1, "test 48: no image without pixels");
+  check(ppm_saver_close(&saver) == 0, "test 49: saver writes every image");
+
+  char* names[] = {TEST_FILE, "no-such-file.ppm", TEST_FILE};
+  struct ppm_loader loader;
+  struct ppm_async_image next;
+  check(ppm_loader_open(&loader, names, 3, 1, 0) == 0, "test 50: loader open");
+  check(ppm_loader_next(&loader, &next) == 1 && next.pixels != NULL && next.width == 3 && next.height == 2 &&
+        memcmp(next.pixels, pixels, sizeof(pixels)) == 0, "test 51: first image read");
+  ppm_async_release(&next);
+  check(ppm_loader_next(&loader, &next) == 1 && next.pixels == NULL, "test 52: missing image in its place");
+  check(ppm_loader_next(&loader, &next) == 1 && next.pixels != NULL && next.map.base == NULL,
+        "test 53: last image read");
+  ppm_async_release(&next);
+  check(ppm_loader_next(&loader, &next) == 0, "test 54: no more images");
+  ppm_loader_close(&loader);
+
+  check(ppm_loader_open(&loader, names, 3, 2, 1) == 0 && ppm_loader_next(&loader, &next) == 1 &&
+        next.map.base != NULL && memcmp(next.pixels, pixels, sizeof(pixels)) == 0, "test 55: image mapped");
+  next.pixels[0].red ^= 1;
+  ppm_async_release(&next);
+  ppm_loader_close(&loader);
+  flat = read_ppm(TEST_FILE, &w, &h);
+  check(flat != NULL && memcmp(flat, pixels, sizeof(pixels)) == 0, "test 56: mapped image left unchanged");
+  free(flat);
+
+  // QOI: the ops of the published format, and a round trip through each
+  struct ppm_pixel small[3] = {{0, 0, 0}, {0, 0, 0}, {1, 0, 0}};
+  unsigned char encoded[64];
+  size_t length = qoi_encode(small, 3, 1, encoded);
+  const unsigned char expected[] = {'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 3, 0,
+                                    0xc1, 0x7a, 0, 0, 0, 0, 0, 0, 0, 1};
+  check(length == sizeof(expected) && memcmp(encoded, expected, length) == 0, "test 57: QOI run and diff");
+
+  int count = 200 * 150;
+  struct ppm_pixel* varied = malloc(count * sizeof(struct ppm_pixel));
+  for (int i = 0; i < count; i++) {
+    int x = i % 200, y = i / 200;
+    varied[i].red = y < 50 ? 10 : x * 7 + y;        // runs, then gradients
+    varied[i].green = y < 50 ? 20 : (x * x) ^ y;    // and noise
+    varied[i].blue = y < 50 ? 30 : (x / 8) * 40;    // and repeated colours
+  }
+  unsigned char* buffer = malloc(qoi_max_size(200, 150));
+  length = qoi_encode(varied, 200, 150, buffer);
+  struct ppm_pixel* decoded = qoi_decode(buffer, length, &w, &h);
+  check(decoded != NULL && w == 200 && h == 150 && memcmp(decoded, varied, count * sizeof(struct ppm_pixel)) == 0,
+        "test 58: QOI round trip");
+  free(decoded);
+  check(qoi_decode(buffer, length / 2, &w, &h) == NULL, "test 59: truncated QOI rejected");
+  check(qoi_decode(shortFile, sizeof(shortFile), &w, &h) == NULL, "test 60: not a QOI image");
+  free(buffer);
+
+  check(write_image(TEST_FILE, varied, 200, 150, IMAGE_QOI) == 0, "test 61: write QOI file");
+  decoded = read_qoi(TEST_FILE, &w, &h);
+  check(decoded != NULL && memcmp(decoded, varied, count * sizeof(struct ppm_pixel)) == 0, "test 62: read QOI file");
+  free(decoded);
+  check(write_image(TEST_FILE, varied, 200, 150, IMAGE_PPM) == 0, "test 63: write PPM file");
+  decoded = read_ppm(TEST_FILE, &w, &h);
+  check(decoded != NULL && memcmp(decoded, varied, count * sizeof(struct ppm_pixel)) == 0, "test 64: read PPM file");
+  free(decoded);
+
+  // Tiled images: regions across tile edges, in both storage formats
+  const char* tiledFile = "test_ppm.tiles";
+  struct ppm_pixel* region = malloc(count * sizeof(struct ppm_pixel));
+  for (int c = TILE_RAW; c <= TILE_QOI; c++) {
+    const char* kind = c == TILE_RAW ? "raw" : "qoi";
+    char message[128];
+    snprintf(message, sizeof(message), "test %d: convert to %s tiles", c == TILE_RAW ? 65 : 70, kind);
+    check(tiled_convert(TEST_FILE, tiledFile, 64, c) == 0, message);
+
+    struct tiled_image tiled;
+    snprintf(message, sizeof(message), "test %d: open %s tiles", c == TILE_RAW ? 66 : 71, kind);
+    check(tiled_open(&tiled, tiledFile) == 0 && tiled.width == 200 && tiled.height == 150 &&
+          tiled.tilesAcross == 4 && tiled.tilesDown == 3 && tiled.compression == c, message);
+
+    int whole = tiled_read_region(&tiled, 0, 0, 200, 150, region) == 0 &&
+                memcmp(region, varied, count * sizeof(struct ppm_pixel)) == 0;
+    snprintf(message, sizeof(message), "test %d: whole %s image", c == TILE_RAW ? 67 : 72, kind);
+    check(whole, message);
+
+    // A crop straddling four tiles, including the cropped edge tiles
+    int cropped = tiled_read_region(&tiled, 150, 100, 50, 50, region) == 0;
+    for (int row = 0; row < 50 && cropped; row++) {
+      cropped = memcmp(region + row * 50, varied + (100 + row) * 200 + 150, 50 * sizeof(struct ppm_pixel)) == 0;
+    }
+    cropped = cropped && tiled_read_region(&tiled, 60, 60, 10, 10, region) == 0 &&
+              memcmp(region + 3 * 10 + 4, varied + 63 * 200 + 64, sizeof(struct ppm_pixel)) == 0;
+    snprintf(message, sizeof(message), "test %d: %s regions across tiles", c == TILE_RAW ? 68 : 73, kind);
+    check(cropped, message);
+
+    snprintf(message, sizeof(message), "test %d: %s region outside the image", c == TILE_RAW ? 69 : 74, kind);
+    check(tiled_read_region(&tiled, 190, 0, 20, 10, region) == -1 &&
+          tiled_read_region(&tiled, -1, 0, 10, 10, region) == -1, message);
+    tiled_close(&tiled);
+  }
+  free(region);
+  free(varied);
+
+  struct tiled_image tiled;
+  check(tiled_open(&tiled, TEST_FILE) == -1, "test 75: a PPM is not a tiled image");
+  remove(tiledFile);
+
+  // Pyramids: SIMD and threaded downsampling against a plain 2x2 mean,
+  // for widths that end each kernel at a different place
+  int exact = 1;
+  for (int width = 1; width <= 67 && exact; width += 3) {
+    int height = width % 5 + 1;
+    struct ppm_pixel* in = malloc(width * height * sizeof(struct ppm_pixel));
+    struct ppm_pixel* out = malloc(pyramid_half(width) * pyramid_half(height) * sizeof(struct ppm_pixel));
+    for (int i = 0; i < width * height * 3; i++) {
+      ((unsigned char*)in)[i] = rand() % 256;
+    }
+    pyramid_downsample(in, width, height, out, 3);
+    for (int y = 0; y < pyramid_half(height) && exact; y++) {
+      for (int x = 0; x < pyramid_half(width) && exact; x++) {
+        int x1 = 2 * x + 1 < width ? 2 * x + 1 : 2 * x;
+        int y1 = 2 * y + 1 < height ? 2 * y + 1 : 2 * y;
+        const unsigned char* p00 = (unsigned char*)&in[2 * y * width + 2 * x];
+        const unsigned char* p01 = (unsigned char*)&in[2 * y * width + x1];
+        const unsigned char* p10 = (unsigned char*)&in[y1 * width + 2 * x];
+        const unsigned char* p11 = (unsigned char*)&in[y1 * width + x1];
+        const unsigned char* got = (unsigned char*)&out[y * pyramid_half(width) + x];
+        for (int c = 0; c < 3; c++) {
+          exact = exact && got[c] == (p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4;
+        }
+      }
+    }
+    free(in);
+    free(out);
+  }
+  check(exact, "test 76: downsampling matches the 2x2 mean");
+
+  check(pyramid_build(TEST_FILE, "test_ppm", 16, 2) == 4, "test 77: pyramid levels");
+  struct ppm_pixel* level1 = read_ppm("test_ppm-1.ppm", &w, &h);
+  check(level1 != NULL && w == 100 && h == 75, "test 78: first level size");
+  struct ppm_pixel* level2 = malloc(50 * 38 * sizeof(struct ppm_pixel));
+  pyramid_downsample(level1, 100, 75, level2, 1);
+  decoded = read_ppm("test_ppm-2.ppm", &w, &h);
+  check(decoded != NULL && w == 50 && h == 38 && memcmp(decoded, level2, 50 * 38 * sizeof(struct ppm_pixel)) == 0,
+        "test 79: streamed level matches");
+  free(decoded);
+  free(level1);
+  free(level2);
+  decoded = read_ppm("test_ppm-4.ppm", &w, &h);
+  check(decoded != NULL && w == 13 && h == 10, "test 80: smallest level");
+  free(decoded);
+  for (int level = 1; level <= 4; level++) {
+    char name[32];
+    snprintf(name, sizeof(name), "test_ppm-%d.ppm", level);
+    remove(name);
+  }
+
+  enum image_format format;
+  check(image_format_parse("qoi", &format) == 0 && format == IMAGE_QOI &&
+        strcmp(image_format_extension(format), "qoi") == 0, "test 81: format by name");
+  check(image_format_parse("png", &format) == -1, "test 82: unknown format");
+
+  exact = 1;
+  for (int width = 1; width <= 70 && exact; width += 3) {
+    struct ppm_pixel* in = malloc(width * 2 * sizeof(struct ppm_pixel));
+    struct ppm_pixel* out = malloc(width * 2 * sizeof(struct ppm_pixel));
+    struct planar_image planar;
+    for (int i = 0; i < width * 2 * 3; i++) {
+      ((unsigned char*)in)[i] = rand() % 256;
+    }
+    planar_alloc(&planar, width, 2);
+    planar_from_pixels(in, &planar, 3);
+    for (int i = 0; i < width * 2 && exact; i++) {
+      exact = planar.planes[0][i] == in[i].red && planar.planes[1][i] == in[i].green &&
+              planar.planes[2][i] == in[i].blue;
+    }
+    planar_to_pixels(&planar, out, 2);
+    exact = exact && memcmp(in, out, width * 2 * sizeof(struct ppm_pixel)) == 0;
+    planar_free(&planar);
+    free(in);
+    free(out);
+  }
+  check(exact, "test 83: planar round trip");
+
+  exact = 1;
+  for (int length = 1; length <= 70 && exact; length += 3) {
+    struct ppm_pixel* in = malloc(length * sizeof(struct ppm_pixel));
+    struct ppm_pixel* out = malloc(length * sizeof(struct ppm_pixel));
+    for (int i = 0; i < length * 3; i++) {
+      ((unsigned char*)in)[i] = rand() % 256;
+    }
+    memcpy(out, in, length * sizeof(struct ppm_pixel));
+    image_swizzle(out, length, "brg", 2);
+    for (int i = 0; i < length && exact; i++) {
+      exact = out[i].red == in[i].blue && out[i].green == in[i].red && out[i].blue == in[i].green;
+    }
+    memcpy(out, in, length * sizeof(struct ppm_pixel));
+    image_swizzle(out, length, "ggg", 1);
+    for (int i = 0; i < length && exact; i++) {
+      exact = out[i].red == in[i].green && out[i].green == in[i].green && out[i].blue == in[i].green;
+    }
+    free(in);
+    free(out);
+  }
+  check(exact, "test 84: swizzle");
+  check(image_swizzle(pixels, 2, "rgx", 1) == -1 && image_swizzle(pixels, 2, "rg", 1) == -1,
+        "test 85: invalid swizzle order");
+
+  unsigned char lut[3][256];
+  image_gamma_lut(1.0, lut[0]);
+  image_gamma_lut(2.2, lut[1]);
+  for (int i = 0; i < 256; i++) {
+    lut[2][i] = 255 - i;
+  }
+  exact = lut[0][0] == 0 && lut[0][77] == 77 && lut[1][0] == 0 && lut[1][255] == 255 && lut[1][64] > 64;
+  struct ppm_pixel looked[2] = {{10, 64, 200}, {0, 255, 255}};
+  image_apply_lut(looked, 2, (const unsigned char (*)[256])lut, 2);
+  exact = exact && looked[0].red == 10 && looked[0].green == lut[1][64] && looked[0].blue == 55 &&
+          looked[1].red == 0 && looked[1].green == 255 && looked[1].blue == 0;
+  check(exact, "test 86: gamma lookup tables");
+
+  struct planar_image planar;
+  planar_alloc(&planar, 41, 41);
+  memset(planar.planes[0], 90, 41 * 41);
+  memset(planar.planes[1], 0, 41 * 41);
+  memset(planar.planes[2], 0, 41 * 41);
+  planar.planes[2][20 * 41 + 20] = 255;
+  check(image_blur(&planar, 2.5, 3) == 0, "test 87: blur");
+  exact = 1;
+  total = 0;
+  for (int i = 0; i < 41 * 41 && exact; i++) {
+    int x = i % 41, y = i / 41;
+    exact = planar.planes[0][i] == 90 && planar.planes[1][i] == 0 &&
+            planar.planes[2][i] == planar.planes[2][x * 41 + y] &&
+            planar.planes[2][i] == planar.planes[2][y * 41 + 40 - x];
+    total += planar.planes[2][i];
+  }
+  check(exact && planar.planes[2][20 * 41 + 20] > planar.planes[2][20 * 41 + 24] && total > 200 && total < 300,
+        "test 88: blur keeps flat areas and spreads a point evenly");
+  check(image_blur(&planar, 21, 1) == -1, "test 89: blur rejects a large sigma");
+
+  struct planar_image resized;
+  planar_alloc(&resized, 41, 41);
+  image_resize(&planar, &resized, 2);
+  check(memcmp(planar.planes[0], resized.planes[0], 41 * 41 * 3) == 0, "test 90: resize to the same size");
+  planar_free(&resized);
+  planar_free(&planar);
+
+  struct ppm_pixel block[4] = {{0, 10, 255}, {1, 20, 255}, {2, 30, 255}, {4, 41, 254}};
+  struct ppm_pixel mean;
+  planar_alloc(&planar, 2, 2);
+  planar_alloc(&resized, 1, 1);
+  planar_from_pixels(block, &planar, 1);
+  image_resize(&planar, &resized, 1);
+  planar_to_pixels(&resized, &mean, 1);
+  check(mean.red == 2 && mean.green == 25 && mean.blue == 255, "test 91: halving takes the mean");
+  planar_free(&planar);
+  planar_free(&resized);
+
+  // Each thread's share of the rows has its own scratch space
+  struct planar_image shared[2], scaled[2];
+  exact = 1;
+  for (int t = 0; t < 2; t++) {
+    planar_alloc(&shared[t], 37, 23);
+    planar_alloc(&scaled[t], 19, 29);
+    for (int i = 0; i < 37 * 23 * 3; i++) {
+      shared[t].planes[0][i] = (i * 37) % 251;
+    }
+    exact = exact && image_blur(&shared[t], 3, t ? 7 : 1) == 0 &&
+            image_resize(&shared[t], &scaled[t], t ? 7 : 1) == 0;
+  }
+  check(exact && memcmp(shared[0].planes[0], shared[1].planes[0], 37 * 23 * 3) == 0 &&
+        memcmp(scaled[0].planes[0], scaled[1].planes[0], 19 * 29 * 3) == 0,
+        "test 106: blur and resize match on 1 and 7 threads");
+  for (int t = 0; t < 2; t++) {
+    planar_free(&shared[t]);
+    planar_free(&scaled[t]);
+  }
+
+  unsigned char carrier[8 * 70], before[8 * 70], payload[70], extracted[70];
+  exact = 1;
+  for (int length = 0; length <= 70 && exact; length++) {
+    for (int i = 0; i < 8 * 70; i++) {
+      carrier[i] = before[i] = rand();
+    }
+    for (int i = 0; i < length; i++) {
+      payload[i] = rand();
+    }
+    stego_embed(carrier, payload, length);
+    for (int i = 0; i < 8 * 70 && exact; i++) {
+      int bit = i < 8 * length ? (payload[i / 8] >> (7 - i % 8)) & 1 : before[i] & 1;
+      exact = carrier[i] == ((before[i] & ~1) | bit);
+    }
+    stego_extract(carrier, extracted, length);
+    exact = exact && memcmp(extracted, payload, length) == 0;
+  }
+  check(exact, "test 92: stego bits match the bit-at-a-time layout");
+  unsigned char letter[8] = {255, 255, 255, 255, 255, 255, 255, 255};
+  stego_embed(letter, "A", 1);
+  check(memcmp(letter, "\xfe\xff\xfe\xfe\xfe\xfe\xfe\xff", 8) == 0 && stego_capacity(4, 4) == 6,
+        "test 93: most significant bit first");
+
+  check(stego_crc32(0, "123456789", 9) == 0xcbf43926 &&
+        stego_crc32(stego_crc32(0, "1234", 4), "56789", 5) == 0xcbf43926, "test 94: crc32");
+  check(stego_payload_capacity(200, 150, 3) == 200 * 150 * 3 / 8 - 16 && stego_payload_capacity(2, 2, 3) == 0,
+        "test 95: payload capacity");
+  unsigned char* secret = malloc(5000);
+  for (int i = 0; i < 5000; i++) {
+    secret[i] = rand();
+  }
+  fp = fopen("test_ppm.bin", "wb");
+  fwrite(secret, 1, 5000, fp);
+  fclose(fp);
+  struct ppm_pixel* plain = read_ppm(TEST_FILE, &w, &h);
+  check(stego_extract_file(TEST_FILE, "test_ppm.out") == -1, "test 96: no payload in a plain image");
+  check(stego_embed_file(TEST_FILE, "test_ppm.bin", "test_ppm-stego.ppm") == 0 &&
+        stego_extract_file("test_ppm-stego.ppm", "test_ppm.out") == 0, "test 97: hide and recover a file");
+  fp = fopen("test_ppm.out", "rb");
+  unsigned char* recovered = malloc(5001);
+  size_t recoveredLength = fp ? fread(recovered, 1, 5001, fp) : 0;
+  if (fp) fclose(fp);
+  decoded = read_ppm("test_ppm-stego.ppm", &w, &h);
+  exact = plain != NULL && decoded != NULL && w == 200 && h == 150;
+  for (int i = 0; i < 200 * 150 && exact; i++) {
+    exact = (decoded[i].red | 1) == (plain[i].red | 1) && (decoded[i].green | 1) == (plain[i].green | 1) &&
+            (decoded[i].blue | 1) == (plain[i].blue | 1);
+  }
+  check(recoveredLength == 5000 && memcmp(recovered, secret, 5000) == 0 && exact, "test 98: payload intact, carrier LSBs only");
+  free(decoded);
+  free(plain);
+  free(recovered);
+  free(secret);
+
+  fp = fopen("test_ppm.bin", "wb");
+  for (int i = 0; i < 12000; i++) {
+    fputc(i, fp);
+  }
+  fclose(fp);
+  check(stego_embed_file(TEST_FILE, "test_ppm.bin", "test_ppm-stego.ppm") == -1, "test 99: payload too large");
+
+  struct stego_reader stegoReader;
+  unsigned char* samples = malloc(200 * 150 * 3);
+  unsigned char* prefix = malloc(200 * 150 * 3 / 8);
+  unsigned char readBack[40];
+  decoded = read_ppm(TEST_FILE, &w, &h);
+  memcpy(samples, decoded, 200 * 150 * 3);
+  stego_extract(samples, prefix, 200 * 150 * 3 / 8);
+  check(stego_reader_open(&stegoReader, TEST_FILE) == 0 && stegoReader.capacity == 200 * 150 * 3 / 8 &&
+        stego_read(&stegoReader, 1000, readBack, 40) == 40 && memcmp(readBack, prefix + 1000, 40) == 0,
+        "test 100: read data from the middle of a carrier");
+  check(stego_read(&stegoReader, stegoReader.capacity - 10, readBack, 40) == 10 &&
+        memcmp(readBack, prefix + stegoReader.capacity - 10, 10) == 0 &&
+        stego_read(&stegoReader, stegoReader.capacity, readBack, 40) == 0, "test 101: reads stop at the capacity");
+  stego_reader_close(&stegoReader);
+  free(decoded);
+  free(samples);
+  free(prefix);
+
+  // A band of 8 rows of a carrier this wide holds more data than a band of
+  // ordinary rows
+  struct ppm_pixel* wide = malloc(50000 * 8 * sizeof(struct ppm_pixel));
+  for (int i = 0; i < 50000 * 8 * 3; i++) {
+    ((unsigned char*)wide)[i] = rand();
+  }
+  write_ppm("test_ppm-wide.ppm", wide, 50000, 8);
+  secret = malloc(140000);
+  for (int i = 0; i < 140000; i++) {
+    secret[i] = rand();
+  }
+  fp = fopen("test_ppm.bin", "wb");
+  fwrite(secret, 1, 140000, fp);
+  fclose(fp);
+  recovered = malloc(140001);
+  recoveredLength = 0;
+  if (stego_embed_file("test_ppm-wide.ppm", "test_ppm.bin", "test_ppm-stego.ppm") == 0 &&
+      stego_extract_file("test_ppm-stego.ppm", "test_ppm.out") == 0 && (fp = fopen("test_ppm.out", "rb"))) {
+    recoveredLength = fread(recovered, 1, 140001, fp);
+    fclose(fp);
+  }
+  check(recoveredLength == 140000 && memcmp(recovered, secret, 140000) == 0, "test 102: payload in a wide carrier");
+  free(wide);
+  free(secret);
+  free(recovered);
+  remove("test_ppm-wide.ppm");
+  remove("test_ppm.bin");
+  remove("test_ppm.out");
+  remove("test_ppm-stego.ppm");
+
+  // Outputs that are not regular files: no room can be reserved, and a
+  // pipe cannot seek, so its bands come out in row order
+  check(ppm_band_writer_open(&bands, "/dev/null", &rgb) == 0 && ppm_write_band(&bands, 1, pixels + 3, 1) == 0 &&
+        ppm_write_band(&bands, 0, pixels, 1) == 0 && ppm_band_writer_close(&bands) == 0,
+        "test 103: bands to /dev/null");
+  int ends[2];
+  char pipeName[64];
+  unsigned char piped[64];
+  ssize_t pipedLength = -1;
+  if (pipe(ends) == 0) {
+    snprintf(pipeName, sizeof(pipeName), "/dev/fd/%d", ends[1]);
+    if (ppm_band_writer_open(&bands, pipeName, &rgb) == 0 && ppm_write_band(&bands, 1, pixels + 3, 1) == 0 &&
+        ppm_write_band(&bands, 0, pixels, 1) == 0 && ppm_band_writer_close(&bands) == 0) {
+      close(ends[1]);
+      pipedLength = read(ends[0], piped, sizeof(piped));
+    } else {
+      close(ends[1]);
+    }
+    close(ends[0]);
+  }
+  check(pipedLength == 11 + (ssize_t)sizeof(pixels) && memcmp(piped, "P6\n3 2\n255\n", 11) == 0 &&
+        memcmp(piped + 11, pixels, sizeof(pixels)) == 0, "test 104: bands to a pipe, in order");
+  if (pipe(ends) == 0) {
+    snprintf(pipeName, sizeof(pipeName), "/dev/fd/%d", ends[1]);
+    check(ppm_band_writer_open(&bands, pipeName, &rgb) == 0 && ppm_write_band(&bands, 1, pixels + 3, 1) == 0 &&
+          ppm_band_writer_close(&bands) == -1, "test 105: a pipe missing a band fails");
+    close(ends[1]);
+    close(ends[0]);
+  }
+  remove("test_ppm.bin");
+  remove("test_ppm.out");
+  remove("test_ppm-stego.ppm");
+
+  remove(TEST_FILE);
+  return 0;
+}
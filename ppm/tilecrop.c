@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "tiled.h"
+#include "write_ppm.h"
+
+/**
+ * Tiled Image Crop
+ *
+ * Reads one region of a tiled image file and writes it as PPM or QOI. Only
+ * the tiles the region overlaps are read, so the time depends on the size
+ * of the crop, not of the image.
+ *
+ * Usage: ./tilecrop -x <left> -y <top> -w <width> -h <height>
+ *                   -o <output.ppm> -f ppm|qoi <input.tiles>
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+int main(int argc, char* argv[]) {
+    int x = 0, y = 0, w = 0, h = 0;
+    const char* output = "crop.ppm";
+    const char* formatName = "ppm";
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":x:y:w:h:o:f:")) != -1) {
+        switch (opt) {
+        case 'x': x = atoi(optarg); break;
+        case 'y': y = atoi(optarg); break;
+        case 'w': w = atoi(optarg); break;
+        case 'h': h = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'f': formatName = optarg; break;
+        case '?': printf("usage: %s -x <left> -y <top> -w <width> -h <height> "
+            "-o <output.ppm> -f ppm|qoi <input.tiles>\n", argv[0]); break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s -x <left> -y <top> -w <width> -h <height> "
+                "-o <output.ppm> -f ppm|qoi <input.tiles>\n", argv[0]);
+        return 1;
+    }
+    enum image_format format;
+    if (image_format_parse(formatName, &format) != 0) {
+        fprintf(stderr, "Unknown output format %s\n", formatName);
+        return 1;
+    }
+
+    struct tiled_image image;
+    if (tiled_open(&image, argv[optind]) != 0) return 1;
+    // Without -w or -h the crop runs to the edge of the image
+    if (w <= 0) w = image.width - x;
+    if (h <= 0) h = image.height - y;
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    struct ppm_pixel* pixels = malloc((size_t)w * h * sizeof(struct ppm_pixel));
+    if (!pixels || tiled_read_region(&image, x, y, w, h, pixels) != 0) {
+        fprintf(stderr, "Cannot read region %dx%d at (%d, %d) of %dx%d image %s\n",
+                w, h, x, y, image.width, image.height, argv[optind]);
+        free(pixels);
+        tiled_close(&image);
+        return 1;
+    }
+    gettimeofday(&end, NULL);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("Read %dx%d region of %dx%d image in %f seconds\n", w, h, image.width, image.height, elapsed);
+
+    int status = write_image(output, pixels, w, h, format);
+    if (status == 0) printf("Writing file: %s\n", output);
+    free(pixels);
+    tiled_close(&image);
+    return status == 0 ? 0 : 1;
+}
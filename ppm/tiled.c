@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tiled.h"
+#include "qoi.h"
+
+/**
+ * Tiled Image Files
+ *
+ * Writes images as independently stored square tiles behind an index, and
+ * reads back any region by loading only the tiles it overlaps. Writing goes
+ * a band of tiles at a time, so a PPM of any size converts in the memory of
+ * one band; reading uses pread, so one open file serves many threads.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+#define TILED_HEADER 20       // magic, width, height, tile size, compression
+#define TILED_ENTRY 12        // offset and length of one tile
+#define MAX_TILE_SIZE 8192
+#define MAX_TILES (1 << 24)
+
+static void put32(unsigned char* out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static uint32_t get32(const unsigned char* in) {
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+/**
+ * Returns the number of tiles needed to cover a length.
+ */
+static int tiles_for(int length, int tileSize) {
+    return (length + tileSize - 1) / tileSize;
+}
+
+/**
+ * Returns the width or height of the tile at an index along one axis,
+ * cropped to the image.
+ */
+static int tile_extent(int length, int tileSize, int t) {
+    int start = t * tileSize;
+    return length - start < tileSize ? length - start : tileSize;
+}
+
+/**
+ * Creates a tiled image file and writes its header. Room is left for the
+ * index, which is filled in when the writer is closed.
+ *
+ * @param writer The writer to open
+ * @param filename The name of the file to create
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param tileSize The width and height of the tiles
+ * @param compression How the tiles are stored
+ * @return 0 on success, or -1 if the file cannot be created
+ */
+int tiled_writer_open(struct tiled_writer* writer, const char* filename, int w, int h,
+                      int tileSize, enum tile_compression compression) {
+    memset(writer, 0, sizeof(*writer));
+    if (w <= 0 || h <= 0 || tileSize <= 0 || tileSize > MAX_TILE_SIZE ||
+        (long)tiles_for(w, tileSize) * tiles_for(h, tileSize) > MAX_TILES) {
+        fprintf(stderr, "Unsupported tiled image size %dx%d with tiles of %d\n", w, h, tileSize);
+        return -1;
+    }
+    writer->width = w;
+    writer->height = h;
+    writer->tileSize = tileSize;
+    writer->compression = compression;
+    writer->tilesAcross = tiles_for(w, tileSize);
+    writer->tilesDown = tiles_for(h, tileSize);
+    size_t tiles = (size_t)writer->tilesAcross * writer->tilesDown;
+    writer->next = TILED_HEADER + tiles * TILED_ENTRY;
+
+    writer->index = calloc(tiles, sizeof(struct tile_entry));
+    writer->tile = malloc((size_t)tileSize * tileSize * sizeof(struct ppm_pixel));
+    writer->encoded = compression == TILE_QOI ? malloc(qoi_max_size(tileSize, tileSize)) : NULL;
+    if (!writer->index || !writer->tile || (compression == TILE_QOI && !writer->encoded)) {
+        fprintf(stderr, "Failed to allocate memory for tiles\n");
+        tiled_writer_close(writer);
+        return -1;
+    }
+
+    writer->fp = fopen(filename, "wb");
+    if (!writer->fp) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        tiled_writer_close(writer);
+        return -1;
+    }
+    unsigned char header[TILED_HEADER] = {'P', 'T', 'I', 'L'};
+    put32(header + 4, w);
+    put32(header + 8, h);
+    put32(header + 12, tileSize);
+    header[16] = compression;
+    if (fwrite(header, 1, TILED_HEADER, writer->fp) != TILED_HEADER ||
+        fseek(writer->fp, writer->next, SEEK_SET) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        tiled_writer_close(writer);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes the next band of tiles.
+ *
+ * @param writer The writer
+ * @param rows The rows of the band, each the full width of the image
+ * @return 0 on success, or -1 if the tiles cannot be written
+ */
+int tiled_write_band(struct tiled_writer* writer, const struct ppm_pixel* rows) {
+    if (!writer->fp || writer->band >= writer->tilesDown) return -1;
+
+    int th = tile_extent(writer->height, writer->tileSize, writer->band);
+    for (int tx = 0; tx < writer->tilesAcross; tx++) {
+        int tw = tile_extent(writer->width, writer->tileSize, tx);
+        const struct ppm_pixel* start = rows + (size_t)tx * writer->tileSize;
+        for (int r = 0; r < th; r++) {
+            memcpy(writer->tile + (size_t)r * tw, start + (size_t)r * writer->width,
+                   tw * sizeof(struct ppm_pixel));
+        }
+
+        const void* data = writer->tile;
+        size_t length = (size_t)tw * th * sizeof(struct ppm_pixel);
+        if (writer->compression == TILE_QOI) {
+            length = qoi_encode(writer->tile, tw, th, writer->encoded);
+            data = writer->encoded;
+        }
+        if (fwrite(data, 1, length, writer->fp) != length) return -1;
+
+        struct tile_entry* entry = &writer->index[(size_t)writer->band * writer->tilesAcross + tx];
+        entry->offset = writer->next;
+        entry->length = length;
+        writer->next += length;
+    }
+    writer->band++;
+    return 0;
+}
+
+/**
+ * Writes the index of a tiled image file and closes it.
+ *
+ * @param writer The writer to close
+ * @return 0 if every band was written, or -1 otherwise
+ */
+int tiled_writer_close(struct tiled_writer* writer) {
+    int ok = writer->fp != NULL && writer->band == writer->tilesDown;
+    if (ok) {
+        size_t tiles = (size_t)writer->tilesAcross * writer->tilesDown;
+        unsigned char* index = malloc(tiles * TILED_ENTRY);
+        if (index) {
+            for (size_t i = 0; i < tiles; i++) {
+                put32(index + i * TILED_ENTRY, writer->index[i].offset >> 32);
+                put32(index + i * TILED_ENTRY + 4, writer->index[i].offset);
+                put32(index + i * TILED_ENTRY + 8, writer->index[i].length);
+            }
+        }
+        ok = index && fseek(writer->fp, TILED_HEADER, SEEK_SET) == 0 &&
+             fwrite(index, TILED_ENTRY, tiles, writer->fp) == tiles;
+        free(index);
+    }
+    if (writer->fp && fclose(writer->fp) != 0) ok = 0;
+    free(writer->index);
+    free(writer->tile);
+    free(writer->encoded);
+    writer->fp = NULL;
+    writer->index = NULL;
+    writer->tile = NULL;
+    writer->encoded = NULL;
+    return ok ? 0 : -1;
+}
+
+/**
+ * Reads exactly length bytes at an offset, resuming after partial reads.
+ * @return 0 on success, or -1 if the file is too short or the read fails
+ */
+static int pread_all(int fd, void* data, size_t length, off_t offset) {
+    unsigned char* bytes = data;
+    while (length > 0) {
+        ssize_t n = pread(fd, bytes, length, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        bytes += n;
+        length -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * Opens a tiled image file and loads and checks its index.
+ *
+ * @param image The image to open
+ * @param filename The name of the file
+ * @return 0 on success, or -1 if the file cannot be opened or is not valid
+ */
+int tiled_open(struct tiled_image* image, const char* filename) {
+    image->index = NULL;
+    image->fd = open(filename, O_RDONLY);
+    if (image->fd < 0) {
+        fprintf(stderr, "Unable to open file %s\n", filename);
+        return -1;
+    }
+
+    unsigned char header[TILED_HEADER];
+    struct stat info;
+    if (fstat(image->fd, &info) != 0 || pread_all(image->fd, header, TILED_HEADER, 0) != 0 ||
+        memcmp(header, "PTIL", 4) != 0) {
+        goto invalid;
+    }
+    uint32_t width = get32(header + 4);
+    uint32_t height = get32(header + 8);
+    uint32_t tileSize = get32(header + 12);
+    if (width == 0 || width > INT32_MAX || height == 0 || height > INT32_MAX ||
+        tileSize == 0 || tileSize > MAX_TILE_SIZE || header[16] > TILE_QOI) {
+        goto invalid;
+    }
+    image->width = width;
+    image->height = height;
+    image->tileSize = tileSize;
+    image->compression = header[16];
+    image->tilesAcross = tiles_for(width, tileSize);
+    image->tilesDown = tiles_for(height, tileSize);
+    if ((long)image->tilesAcross * image->tilesDown > MAX_TILES) goto invalid;
+
+    size_t tiles = (size_t)image->tilesAcross * image->tilesDown;
+    unsigned char* raw = malloc(tiles * TILED_ENTRY);
+    image->index = malloc(tiles * sizeof(struct tile_entry));
+    if (!raw || !image->index || pread_all(image->fd, raw, tiles * TILED_ENTRY, TILED_HEADER) != 0) {
+        free(raw);
+        goto invalid;
+    }
+    for (size_t i = 0; i < tiles; i++) {
+        struct tile_entry* entry = &image->index[i];
+        entry->offset = (uint64_t)get32(raw + i * TILED_ENTRY) << 32 | get32(raw + i * TILED_ENTRY + 4);
+        entry->length = get32(raw + i * TILED_ENTRY + 8);
+        size_t pixels = (size_t)tile_extent(width, tileSize, i % image->tilesAcross) *
+                        tile_extent(height, tileSize, i / image->tilesAcross);
+        if (entry->offset > (uint64_t)info.st_size || entry->length > info.st_size - entry->offset ||
+            (image->compression == TILE_RAW && entry->length != pixels * sizeof(struct ppm_pixel))) {
+            free(raw);
+            goto invalid;
+        }
+    }
+    free(raw);
+    return 0;
+
+invalid:
+    fprintf(stderr, "Invalid tiled image in %s\n", filename);
+    tiled_close(image);
+    return -1;
+}
+
+/**
+ * Reads a region of a tiled image. Each tile the region overlaps is read
+ * once; of a raw tile only the overlapped rows are read, while a QOI tile
+ * is decoded whole.
+ *
+ * @param image The image
+ * @param x The left column of the region
+ * @param y The top row of the region
+ * @param w The width of the region
+ * @param h The height of the region
+ * @param pixels Returns the w * h pixels of the region
+ * @return 0 on success, or -1 if the region is outside the image or the
+ *         tiles cannot be read
+ */
+int tiled_read_region(const struct tiled_image* image, int x, int y, int w, int h,
+                      struct ppm_pixel* pixels) {
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || w > image->width - x || h > image->height - y) return -1;
+
+    int ts = image->tileSize;
+    struct ppm_pixel* tile = malloc((size_t)ts * ts * sizeof(struct ppm_pixel));
+    if (!tile) return -1;
+    int status = 0;
+    for (int ty = y / ts; ty <= (y + h - 1) / ts && status == 0; ty++) {
+        int th = tile_extent(image->height, ts, ty);
+        int top = y > ty * ts ? y : ty * ts;
+        int bottom = y + h < ty * ts + th ? y + h : ty * ts + th;
+        for (int tx = x / ts; tx <= (x + w - 1) / ts && status == 0; tx++) {
+            int tw = tile_extent(image->width, ts, tx);
+            int left = x > tx * ts ? x : tx * ts;
+            int right = x + w < tx * ts + tw ? x + w : tx * ts + tw;
+            const struct tile_entry* entry = &image->index[(size_t)ty * image->tilesAcross + tx];
+
+            // first holds the tile's row top; rows run tw pixels apart
+            const struct ppm_pixel* first = tile;
+            if (image->compression == TILE_RAW) {
+                size_t rowBytes = (size_t)tw * sizeof(struct ppm_pixel);
+                status = pread_all(image->fd, tile, rowBytes * (bottom - top),
+                                   entry->offset + rowBytes * (top - ty * ts));
+            } else {
+                unsigned char* encoded = malloc(entry->length);
+                int dw = 0, dh = 0;
+                struct ppm_pixel* decoded = NULL;
+                if (encoded && pread_all(image->fd, encoded, entry->length, entry->offset) == 0) {
+                    decoded = qoi_decode(encoded, entry->length, &dw, &dh);
+                }
+                free(encoded);
+                if (decoded && dw == tw && dh == th) {
+                    memcpy(tile, decoded + (size_t)(top - ty * ts) * tw,
+                           (size_t)(bottom - top) * tw * sizeof(struct ppm_pixel));
+                } else {
+                    status = -1;
+                }
+                free(decoded);
+            }
+            if (status != 0) break;
+
+            for (int row = top; row < bottom; row++) {
+                memcpy(pixels + (size_t)(row - y) * w + (left - x),
+                       first + (size_t)(row - top) * tw + (left - tx * ts),
+                       (right - left) * sizeof(struct ppm_pixel));
+            }
+        }
+    }
+    free(tile);
+    return status;
+}
+
+/**
+ * Closes a tiled image file.
+ * @param image The image to close
+ */
+void tiled_close(struct tiled_image* image) {
+    if (image->fd >= 0) close(image->fd);
+    free(image->index);
+    image->fd = -1;
+    image->index = NULL;
+}
+
+/**
+ * Converts a P5 or P6 file to a tiled image, reading it a band of tiles at
+ * a time.
+ *
+ * @param input The PPM or PGM file to convert
+ * @param output The tiled image file to create
+ * @param tileSize The width and height of the tiles
+ * @param compression How the tiles are stored
+ * @return 0 on success, or -1 if either file cannot be used
+ */
+int tiled_convert(const char* input, const char* output, int tileSize,
+                  enum tile_compression compression) {
+    struct ppm_reader reader;
+    if (ppm_reader_open(&reader, input) != 0) return -1;
+
+    struct tiled_writer writer;
+    if (tiled_writer_open(&writer, output, reader.header.width, reader.header.height,
+                          tileSize, compression) != 0) {
+        ppm_reader_close(&reader);
+        return -1;
+    }
+
+    struct ppm_pixel* band = malloc((size_t)reader.header.width * tileSize * sizeof(struct ppm_pixel));
+    int rows = band ? 1 : -1;
+    while (rows > 0) {
+        rows = ppm_read_pixels(&reader, band, tileSize);
+        if (rows > 0 && tiled_write_band(&writer, band) != 0) rows = -1;
+    }
+    free(band);
+    ppm_reader_close(&reader);
+
+    if (tiled_writer_close(&writer) != 0 || rows < 0) {
+        fprintf(stderr, "Failed to convert %s to %s\n", input, output);
+        remove(output);
+        return -1;
+    }
+    return 0;
+}
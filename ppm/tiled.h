@@ -0,0 +1,95 @@
+#ifndef tiled_H_
+#define tiled_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "read_ppm.h"
+
+// A tiled image file: the image is cut into square tiles, each stored on
+// its own, raw or QOI-compressed, and an index of where every tile starts
+// follows the header. A region can then be read by loading just the tiles
+// it overlaps, so a crop of a huge render costs a few tiles, not the file.
+//
+// Layout, all integers big-endian:
+//   "PTIL", width (u32), height (u32), tile size (u32), compression (u8),
+//   3 zero bytes, then for every tile in row-major order its offset (u64)
+//   and length (u32), then the tiles. Tiles on the right and bottom edges
+//   are cropped to the image. A raw tile is its rows of RGB pixels; a QOI
+//   tile is a complete QOI image (see qoi.h).
+
+enum tile_compression {
+  TILE_RAW,
+  TILE_QOI
+};
+
+// Where one tile is stored
+struct tile_entry {
+  uint64_t offset;
+  uint32_t length;
+};
+
+// A tiled image file open for writing a band of tiles at a time
+struct tiled_writer {
+  FILE* fp;
+  int width;
+  int height;
+  int tileSize;
+  enum tile_compression compression;
+  int tilesAcross;
+  int tilesDown;
+  int band;                    // the next band of tiles to write
+  uint64_t next;               // the file offset of the next tile
+  struct tile_entry* index;
+  struct ppm_pixel* tile;      // one tile's pixels
+  unsigned char* encoded;      // one compressed tile
+};
+
+// create a tiled image file; the index is filled in by tiled_writer_close
+// returns 0 on success, or -1 if the file cannot be created
+extern int tiled_writer_open(struct tiled_writer* writer, const char* filename, int w, int h,
+                             int tileSize, enum tile_compression compression);
+
+// write the next band of tiles from tileSize rows of pixels (fewer for the
+// last band), each row w pixels wide
+// returns 0 on success, or -1 if the tiles cannot be written
+extern int tiled_write_band(struct tiled_writer* writer, const struct ppm_pixel* rows);
+
+// write the index and close the file
+// returns 0 if every band was written, or -1 otherwise
+extern int tiled_writer_close(struct tiled_writer* writer);
+
+// A tiled image file open for reading regions
+struct tiled_image {
+  int fd;
+  int width;
+  int height;
+  int tileSize;
+  enum tile_compression compression;
+  int tilesAcross;
+  int tilesDown;
+  struct tile_entry* index;
+};
+
+// open a tiled image file and load its index
+// returns 0 on success, or -1 if the file cannot be opened or is not valid
+extern int tiled_open(struct tiled_image* image, const char* filename);
+
+// read the w x h region with its top-left corner at (x, y) into pixels,
+// which must hold w * h pixels; only the tiles the region overlaps are
+// read, and of raw tiles only the rows it overlaps; safe to call from
+// several threads at once
+// returns 0 on success, or -1 if the region is outside the image or the
+// tiles cannot be read
+extern int tiled_read_region(const struct tiled_image* image, int x, int y, int w, int h,
+                             struct ppm_pixel* pixels);
+
+// close a tiled image file
+extern void tiled_close(struct tiled_image* image);
+
+// convert a P5 or P6 file to a tiled image, streaming a band of tiles at a
+// time, so images larger than memory can be converted
+// returns 0 on success, or -1 if either file cannot be used
+extern int tiled_convert(const char* input, const char* output, int tileSize,
+                         enum tile_compression compression);
+
+#endif
@@ -0,0 +1,419 @@
+#define _GNU_SOURCE   // for fallocate
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "write_ppm.h"
+#include "qoi.h"
+
+/**
+ * PPM Writer Implementation
+ *
+ * Writes P6 images from a flat or 2D array of pixels, and P5/P6 images of
+ * 8- or 16-bit samples from a ppm_image or a band of rows at a time, in
+ * order or, from several threads, at their own offsets. Renderers pick
+ * between P6 and QOI output with write_image.
+ *
+ * @author: Tianyun Song
+ * @version: November 28, 2024
+ */
+
+/**
+ * Writes a PPM image file (P6 format) from a flat array of pixels.
+ *
+ * @param filename The name of the PPM file to write
+ * @param pixels A flat array of ppm_pixel structures containing the image data
+ * @param w The width of the image
+ * @param h The height of the image
+ */
+void write_ppm(const char* filename, struct ppm_pixel* pixels, int w, int h) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        return;
+    }
+
+    size_t count = (size_t)w * h;
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+    if (fwrite(pixels, sizeof(struct ppm_pixel), count, file) != count) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+    }
+}
+
+/**
+ * Returns 1 if the rows of a 2D array follow each other in memory, as they
+ * do in arrays from alloc_ppm_2d and read_ppm_2d.
+ * @param pixels The 2D array
+ * @param w The width of the image
+ * @param h The height of the image
+ */
+static int is_contiguous(struct ppm_pixel** pixels, int w, int h) {
+    for (int i = 1; i < h; i++) {
+        if (pixels[i] != pixels[0] + (size_t)i * w) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Writes a PPM image file (P6 format) from a 2D array of pixels. Contiguous
+ * rows are written with one fwrite.
+ *
+ * @param filename The name of the PPM file to write
+ * @param pixels A 2D array of ppm_pixel structures containing the image data
+ * @param w The width of the image
+ * @param h The height of the image
+ */
+void write_ppm_2d(const char* filename, struct ppm_pixel** pixels, int w, int h) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+    if (is_contiguous(pixels, w, h)) {
+        size_t count = (size_t)w * h;
+        if (fwrite(pixels[0], sizeof(struct ppm_pixel), count, file) != count) {
+            fprintf(stderr, "Failed to write file %s\n", filename);
+        }
+    } else {
+        for (int i = 0; i < h; i++) {
+            if (fwrite(pixels[i], sizeof(struct ppm_pixel), w, file) != (size_t)w) {
+                fprintf(stderr, "Failed to write file %s\n", filename);
+                break;
+            }
+        }
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+    }
+}
+
+/**
+ * Looks up an output format by name.
+ *
+ * @param name "ppm" or "qoi"
+ * @param format Returns the format
+ * @return 0 on success, or -1 if the name is unknown
+ */
+int image_format_parse(const char* name, enum image_format* format) {
+    if (strcmp(name, "ppm") == 0) {
+        *format = IMAGE_PPM;
+    } else if (strcmp(name, "qoi") == 0) {
+        *format = IMAGE_QOI;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns the file extension of a format, without the dot.
+ * @param format The format
+ */
+const char* image_format_extension(enum image_format format) {
+    return format == IMAGE_QOI ? "qoi" : "ppm";
+}
+
+/**
+ * Writes a flat array of pixels as P6 or QOI.
+ *
+ * @param filename The name of the file to write
+ * @param pixels The pixels of the image
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param format The format of the file
+ * @return 0 on success, or -1 if the file cannot be written
+ */
+int write_image(const char* filename, const struct ppm_pixel* pixels, int w, int h, enum image_format format) {
+    if (format == IMAGE_QOI) {
+        return write_qoi(filename, pixels, w, h);
+    }
+    struct ppm_image image = {ppm_rgb_header(w, h), (void*)pixels};
+    return ppm_save(filename, &image);
+}
+
+/**
+ * Creates a PPM or PGM file and writes its header.
+ *
+ * @param writer The writer to open
+ * @param filename The name of the file to create
+ * @param header The format of the image
+ * @return 0 on success, or -1 if the file cannot be created
+ */
+int ppm_writer_open(struct ppm_writer* writer, const char* filename, const struct ppm_header* header) {
+    writer->header = *header;
+    writer->row = 0;
+    writer->swap = NULL;
+    writer->fp = fopen(filename, "wb");
+    if (!writer->fp) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        return -1;
+    }
+    if (ppm_sample_bytes(header) == 2) {
+        writer->swap = malloc(ppm_row_bytes(header));
+        if (!writer->swap) {
+            fclose(writer->fp);
+            writer->fp = NULL;
+            return -1;
+        }
+    }
+
+    fprintf(writer->fp, "P%c\n%d %d\n%d\n", header->channels == 3 ? '6' : '5',
+            header->width, header->height, header->maxval);
+    return 0;
+}
+
+/**
+ * Appends rows to an image. 8-bit samples are written in one block; 16-bit
+ * samples are converted to big-endian a row at a time.
+ *
+ * @param writer The writer
+ * @param data The samples of the rows, laid out as by ppm_read_rows
+ * @param rows The number of rows
+ * @return 0 on success, or -1 if the rows cannot be written
+ */
+int ppm_write_rows(struct ppm_writer* writer, const void* data, int rows) {
+    if (!writer->fp || rows > writer->header.height - writer->row) return -1;
+
+    size_t rowBytes = ppm_row_bytes(&writer->header);
+    if (!writer->swap) {
+        size_t bytes = rowBytes * rows;
+        if (fwrite(data, 1, bytes, writer->fp) != bytes) return -1;
+    } else {
+        const uint16_t* samples = data;
+        for (int y = 0; y < rows; y++) {
+            const uint16_t* in = samples + y * (rowBytes / 2);
+            for (size_t i = 0; i < rowBytes / 2; i++) {
+                writer->swap[2 * i] = in[i] >> 8;
+                writer->swap[2 * i + 1] = in[i] & 0xff;
+            }
+            if (fwrite(writer->swap, 1, rowBytes, writer->fp) != rowBytes) return -1;
+        }
+    }
+    writer->row += rows;
+    return 0;
+}
+
+/**
+ * Closes a writer.
+ *
+ * @param writer The writer to close
+ * @return 0 if every row of the image was written, or -1 otherwise
+ */
+int ppm_writer_close(struct ppm_writer* writer) {
+    int ok = writer->fp != NULL && writer->row == writer->header.height;
+    if (writer->fp && fclose(writer->fp) != 0) ok = 0;
+    free(writer->swap);
+    writer->fp = NULL;
+    writer->swap = NULL;
+    return ok ? 0 : -1;
+}
+
+/**
+ * Writes an image as P5 or P6 with the maxval of its header.
+ *
+ * @param filename The name of the file to write
+ * @param image The image to write
+ * @return 0 on success, or -1 if the file cannot be written
+ */
+int ppm_save(const char* filename, const struct ppm_image* image) {
+    struct ppm_writer writer;
+    if (ppm_writer_open(&writer, filename, &image->header) != 0) return -1;
+
+    int status = ppm_write_rows(&writer, image->data, image->header.height);
+    if (ppm_writer_close(&writer) != 0 || status != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes a whole buffer at an offset, resuming after partial writes.
+ * @param fd The file
+ * @param data The bytes to write
+ * @param length The number of bytes
+ * @param offset Where in the file to write them
+ * @return 0 on success, or -1 if the write fails
+ */
+static int pwrite_all(int fd, const void* data, size_t length, off_t offset) {
+    const unsigned char* bytes = data;
+    while (length > 0) {
+        ssize_t n = pwrite(fd, bytes, length, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        bytes += n;
+        length -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * Writes all of a buffer at the current position, retrying short writes.
+ * @return 0 on success, or -1 if the data cannot be written
+ */
+static int write_all(int fd, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        bytes += n;
+        length -= n;
+    }
+    return 0;
+}
+
+/**
+ * Creates a PPM or PGM file and writes its header, so that bands of rows
+ * can then be written at their offsets in any order. Regular files are
+ * created at their full size; outputs that cannot seek, such as pipes,
+ * hold bands that arrive early until the rows before them are written.
+ *
+ * @param writer The writer to open
+ * @param filename The name of the file to create
+ * @param header The format of the image
+ * @return 0 on success, or -1 if the file cannot be created
+ */
+int ppm_band_writer_open(struct ppm_band_writer* writer, const char* filename, const struct ppm_header* header) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "P%c\n%d %d\n%d\n", header->channels == 3 ? '6' : '5',
+                          header->width, header->height, header->maxval);
+    writer->header = *header;
+    writer->header.offset = length;
+    writer->nextRow = 0;
+    writer->held = NULL;
+    writer->arrived = NULL;
+
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        fprintf(stderr, "Unable to open file %s for writing\n", filename);
+        return -1;
+    }
+    struct stat info;
+    int regular = fstat(writer->fd, &info) == 0 && S_ISREG(info.st_mode);
+    writer->seekable = regular || lseek(writer->fd, 0, SEEK_CUR) >= 0;
+
+    int status = 0;
+    if (regular) {
+        // Reserve every block up front, so the bands never extend the file
+        // concurrently and a full disk is found before any rendering is done
+        off_t total = length + ppm_data_bytes(header);
+        int reserved = fallocate(writer->fd, 0, 0, total) == 0;
+        status = !reserved && ftruncate(writer->fd, total) != 0 ? -1 : 0;
+    }
+    if (status == 0 && writer->seekable) {
+        status = pwrite_all(writer->fd, text, length, 0);
+    } else if (status == 0) {
+        writer->held = malloc(ppm_data_bytes(header) > 0 ? ppm_data_bytes(header) : 1);
+        writer->arrived = calloc(header->height > 0 ? header->height : 1, 1);
+        status = writer->held && writer->arrived ? write_all(writer->fd, text, length) : -1;
+        if (status == 0) pthread_mutex_init(&writer->lock, NULL);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        free(writer->held);
+        free(writer->arrived);
+        writer->held = writer->arrived = NULL;
+        close(writer->fd);
+        writer->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Holds a band for an output that cannot seek, then writes every row that
+ * is now next in order.
+ * @return 0 on success, or -1 if the rows cannot be written
+ */
+static int hold_band(struct ppm_band_writer* writer, int startRow, const void* data, int rows) {
+    size_t rowBytes = ppm_row_bytes(&writer->header);
+    unsigned char* out = writer->held + rowBytes * startRow;
+    if (ppm_sample_bytes(&writer->header) == 1) {
+        memcpy(out, data, rowBytes * rows);
+    } else {
+        const uint16_t* samples = data;
+        for (size_t i = 0; i < rowBytes * rows / 2; i++) {
+            out[2 * i] = samples[i] >> 8;
+            out[2 * i + 1] = samples[i] & 0xff;
+        }
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    memset(writer->arrived + startRow, 1, rows);
+    int first = writer->nextRow;
+    while (writer->nextRow < writer->header.height && writer->arrived[writer->nextRow]) {
+        writer->nextRow++;
+    }
+    int status = write_all(writer->fd, writer->held + rowBytes * first, rowBytes * (writer->nextRow - first));
+    pthread_mutex_unlock(&writer->lock);
+    return status;
+}
+
+/**
+ * Writes a band of rows at its offset in the file. 16-bit samples are
+ * converted to big-endian in a buffer of the calling thread's own.
+ *
+ * @param writer The writer
+ * @param startRow The first row of the band
+ * @param data The samples of the band, laid out as by ppm_read_rows
+ * @param rows The number of rows in the band
+ * @return 0 on success, or -1 if the rows cannot be written
+ */
+int ppm_write_band(struct ppm_band_writer* writer, int startRow, const void* data, int rows) {
+    if (writer->fd < 0 || startRow < 0 || rows < 0 || startRow + rows > writer->header.height) return -1;
+    if (!writer->seekable) return hold_band(writer, startRow, data, rows);
+
+    size_t rowBytes = ppm_row_bytes(&writer->header);
+    off_t offset = writer->header.offset + rowBytes * (size_t)startRow;
+    if (ppm_sample_bytes(&writer->header) == 1) {
+        return pwrite_all(writer->fd, data, rowBytes * rows, offset);
+    }
+
+    unsigned char* swap = malloc(rowBytes);
+    if (!swap) return -1;
+    const uint16_t* samples = data;
+    int status = 0;
+    for (int y = 0; y < rows && status == 0; y++) {
+        const uint16_t* in = samples + y * (rowBytes / 2);
+        for (size_t i = 0; i < rowBytes / 2; i++) {
+            swap[2 * i] = in[i] >> 8;
+            swap[2 * i + 1] = in[i] & 0xff;
+        }
+        status = pwrite_all(writer->fd, swap, rowBytes, offset + rowBytes * y);
+    }
+    free(swap);
+    return status;
+}
+
+/**
+ * Closes a band writer.
+ *
+ * @param writer The writer to close
+ * @return 0 on success, or -1 if the file could not be closed or, for an
+ *         output that cannot seek, some rows were never written
+ */
+int ppm_band_writer_close(struct ppm_band_writer* writer) {
+    if (writer->fd < 0) return -1;
+    int status = close(writer->fd) == 0 ? 0 : -1;
+    if (!writer->seekable) {
+        // Rows still held were never written, because an earlier row is missing
+        if (writer->nextRow != writer->header.height) status = -1;
+        pthread_mutex_destroy(&writer->lock);
+        free(writer->held);
+        free(writer->arrived);
+        writer->held = writer->arrived = NULL;
+    }
+    writer->fd = -1;
+    return status;
+}
@@ -0,0 +1,88 @@
+#ifndef write_ppm_H_
+#define write_ppm_H_
+
+#include <pthread.h>
+#include "read_ppm.h"
+
+// write a 1D array of pixels as a P6 file with 8-bit samples
+extern void write_ppm(const char* filename, struct ppm_pixel* pxs, int w, int h);
+
+// write a 2D array of pixels as a P6 file with 8-bit samples
+extern void write_ppm_2d(const char* filename, struct ppm_pixel** pxs, int w, int h);
+
+// The file formats renderers can write their images in
+enum image_format {
+  IMAGE_PPM,   // uncompressed P6
+  IMAGE_QOI    // lossless QOI, see qoi.h
+};
+
+// look up a format by its name, "ppm" or "qoi"
+// returns 0 on success, or -1 if the name is unknown
+extern int image_format_parse(const char* name, enum image_format* format);
+
+// the file extension of a format, without the dot
+extern const char* image_format_extension(enum image_format format);
+
+// write a 1D array of pixels in the given format
+// returns 0 on success, or -1 if the file cannot be written
+extern int write_image(const char* filename, const struct ppm_pixel* pxs, int w, int h, enum image_format format);
+
+// write an image of any format the library reads: P5 or P6, with 8- or
+// 16-bit samples as given by its header
+// returns 0 on success, or -1 if the file cannot be written
+extern int ppm_save(const char* filename, const struct ppm_image* image);
+
+// A PPM or PGM file open for writing a band of rows at a time
+struct ppm_writer {
+  FILE* fp;
+  struct ppm_header header;
+  int row;             // the next row to write
+  unsigned char* swap; // one row of big-endian samples, for 16-bit images
+};
+
+// create a file and write the header for an image of the given format;
+// the offset of the header is ignored
+// returns 0 on success, or -1 if the file cannot be created
+extern int ppm_writer_open(struct ppm_writer* writer, const char* filename, const struct ppm_header* header);
+
+// append the next band of rows, laid out as by ppm_read_rows
+// returns 0 on success, or -1 if the rows cannot be written or would run
+// past the last row of the image
+extern int ppm_write_rows(struct ppm_writer* writer, const void* data, int rows);
+
+// close a writer
+// returns 0 if every row of the image was written, or -1 otherwise
+extern int ppm_writer_close(struct ppm_writer* writer);
+
+// A PPM or PGM file preallocated at its full size, whose bands of rows may
+// be written in any order, by any number of threads at once: each band goes
+// straight to its own offset with pwrite, so renderers can write rows as
+// soon as they are final instead of in one serial pass at the end
+// Outputs that cannot seek, such as pipes, take the rows in order instead:
+// bands that arrive early are held until the rows before them are written.
+struct ppm_band_writer {
+  int fd;
+  struct ppm_header header;   // offset is where the samples start
+  int seekable;               // 0 if bands must be written in order
+  int nextRow;                // the next row to write, if not seekable
+  unsigned char* held;        // every row, as written to the file, if not seekable
+  unsigned char* arrived;     // 1 for each row held, if not seekable
+  pthread_mutex_t lock;       // guards the rows held, if not seekable
+};
+
+// create a file, write the header and, for regular files, preallocate room
+// for every row
+// returns 0 on success, or -1 if the file cannot be created
+extern int ppm_band_writer_open(struct ppm_band_writer* writer, const char* filename, const struct ppm_header* header);
+
+// write rows [startRow, startRow + rows), laid out as by ppm_read_rows;
+// safe to call from several threads for different rows
+// returns 0 on success, or -1 if the rows cannot be written
+extern int ppm_write_band(struct ppm_band_writer* writer, int startRow, const void* data, int rows);
+
+// close a band writer
+// returns 0 on success, or -1 if the file could not be closed or, for an
+// output that cannot seek, some rows were never written
+extern int ppm_band_writer_close(struct ppm_band_writer* writer);
+
+#endif